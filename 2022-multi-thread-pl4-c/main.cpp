@@ -8,6 +8,7 @@
 #include <math.h>
 #include <pthread.h>
 #include <CImg.h>
+#include "worker_pool.h"
 
 using namespace cimg_library;
 
@@ -111,13 +112,12 @@ void* FilterThread(void* args){
 	return NULL;
 }
 
-void filterProcess(filter_args_t filter_args, filter_image filter_components){
+void filterProcess(worker_pool_t *pool, filter_args_t filter_args, filter_image filter_components){
 
-	// Array with all the threads and its corresponding params
-	pthread_t threads[NUMBER_OF_THREADS];
+	// Params of every job. They must outlive the pass, poolWait below guarantees it
 	thread_args params[NUMBER_OF_THREADS];
 
-	// Create threads
+	// Submit one job per thread
 	for (uint i = 0; i < NUMBER_OF_THREADS; i++){
 
 		// Set the data for each thread. Each thread will process a specific part of the array
@@ -142,18 +142,12 @@ void filterProcess(filter_args_t filter_args, filter_image filter_components){
 			perror("Pixels out of bounds!!");
 		}
 
-		// Create thread and work
-		if (pthread_create(&threads[i], NULL, FilterThread, &(params[i])) != 0){
-
-			printf("ERROR creating thread: %d.\n", i);
-			exit(EXIT_FAILURE);
-		}
+		// Wake up a worker of the pool
+		poolSubmit(pool, FilterThread, &(params[i]));
 	}
 
-	// Wait untill all threads are done
-	for (uint i = 0; i < NUMBER_OF_THREADS; i++){
-		pthread_join(threads[i], NULL);
-	}
+	// Wait untill all jobs are done
+	poolWait(pool);
 }
 
 int main(){
@@ -231,6 +225,13 @@ int main(){
 	filter_args.pGdst = filter_args.pRdst + filter_args.pixelCount;
 	filter_args.pBdst = filter_args.pGdst + filter_args.pixelCount;
 
+	// Threads are created once and reused by every pass
+	worker_pool_t pool;
+	if (poolCreate(&pool, NUMBER_OF_THREADS, NUMBER_OF_THREADS) != 0){
+		printf("ERROR creating the worker pool.\n");
+		exit(EXIT_FAILURE);
+	}
+
 	// Measuring start time
 	if(clock_gettime(CLOCK_REALTIME, &tStart) == -1){
 		perror("Clock_gettime Error!!");
@@ -240,7 +241,7 @@ int main(){
 	// ALGORITHM --> Repeated N times
 	uint i;
 	for(i = 0; i < REPEAT_ALGORITHM; i++){
-		filterProcess(filter_args, filter_components);
+		filterProcess(&pool, filter_args, filter_components);
 	}
 
 	// Measuring end time
@@ -257,6 +258,9 @@ int main(){
 	printf("Elapsed time: %.4f", dElapsedTime);
 	printf("\n");
 
+	// Stop the workers
+	poolDestroy(&pool);
+
 	// Create a new image object with the calculated pixels
 	// In case of normal color images use nComp=3,
 	// In case of B/W images use nComp=1.
@@ -0,0 +1,120 @@
+/*
+ * worker_pool.cpp
+ *
+ *  Created on: Fall 2022
+ */
+
+#include <stdlib.h>
+#include "worker_pool.h"
+
+// Body of every worker: take a job, run it, repeat until the pool stops
+static void *poolWorker(void *args){
+
+	worker_pool_t *pool = (worker_pool_t *)args;
+	pool_job_t job;
+
+	pthread_mutex_lock(&pool->lock);
+	while (true){
+
+		// Park the thread until there is something to do
+		while (pool->jobCount == 0 && !pool->stop){
+			pthread_cond_wait(&pool->jobReady, &pool->lock);
+		}
+		if (pool->jobCount == 0){ // Stop requested and queue empty
+			break;
+		}
+
+		job = pool->jobs[pool->jobHead];
+		pool->jobHead = (pool->jobHead + 1) % pool->jobCapacity;
+		pool->jobCount--;
+		pthread_cond_signal(&pool->jobTaken);
+		pthread_mutex_unlock(&pool->lock);
+
+		job.routine(job.arg);
+
+		pthread_mutex_lock(&pool->lock);
+		if (--pool->unfinished == 0){
+			pthread_cond_broadcast(&pool->allDone);
+		}
+	}
+	pthread_mutex_unlock(&pool->lock);
+
+	return NULL;
+}
+
+int poolCreate(worker_pool_t *pool, uint nThreads, uint jobCapacity){
+
+	pool->nThreads = 0;
+	pool->jobCapacity = jobCapacity;
+	pool->jobHead = 0;
+	pool->jobCount = 0;
+	pool->unfinished = 0;
+	pool->stop = false;
+
+	pool->threads = (pthread_t *) malloc(nThreads * sizeof(pthread_t));
+	pool->jobs = (pool_job_t *) malloc(jobCapacity * sizeof(pool_job_t));
+	if (pool->threads == NULL || pool->jobs == NULL){
+		free(pool->threads);
+		free(pool->jobs);
+		return -1;
+	}
+
+	pthread_mutex_init(&pool->lock, NULL);
+	pthread_cond_init(&pool->jobReady, NULL);
+	pthread_cond_init(&pool->jobTaken, NULL);
+	pthread_cond_init(&pool->allDone, NULL);
+
+	for (uint i = 0; i < nThreads; i++){
+		if (pthread_create(&pool->threads[i], NULL, poolWorker, pool) != 0){
+			poolDestroy(pool);
+			return -1;
+		}
+		pool->nThreads++;
+	}
+
+	return 0;
+}
+
+void poolSubmit(worker_pool_t *pool, pool_routine_t routine, void *arg){
+
+	pthread_mutex_lock(&pool->lock);
+	while (pool->jobCount == pool->jobCapacity){
+		pthread_cond_wait(&pool->jobTaken, &pool->lock);
+	}
+
+	pool_job_t *job = &pool->jobs[(pool->jobHead + pool->jobCount) % pool->jobCapacity];
+	job->routine = routine;
+	job->arg = arg;
+	pool->jobCount++;
+	pool->unfinished++;
+	pthread_cond_signal(&pool->jobReady);
+	pthread_mutex_unlock(&pool->lock);
+}
+
+void poolWait(worker_pool_t *pool){
+
+	pthread_mutex_lock(&pool->lock);
+	while (pool->unfinished != 0){
+		pthread_cond_wait(&pool->allDone, &pool->lock);
+	}
+	pthread_mutex_unlock(&pool->lock);
+}
+
+void poolDestroy(worker_pool_t *pool){
+
+	pthread_mutex_lock(&pool->lock);
+	pool->stop = true;
+	pthread_cond_broadcast(&pool->jobReady);
+	pthread_mutex_unlock(&pool->lock);
+
+	for (uint i = 0; i < pool->nThreads; i++){
+		pthread_join(pool->threads[i], NULL);
+	}
+
+	pthread_mutex_destroy(&pool->lock);
+	pthread_cond_destroy(&pool->jobReady);
+	pthread_cond_destroy(&pool->jobTaken);
+	pthread_cond_destroy(&pool->allDone);
+	free(pool->threads);
+	free(pool->jobs);
+}
@@ -0,0 +1,265 @@
+/*
+ * batch.cpp
+ *
+ *  Created on: Fall 2022
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <time.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <CImg.h>
+#include "batch.h"
+#include "bmp.h"
+
+using namespace cimg_library;
+
+// One image pair of the batch
+typedef struct {
+	char source[PATH_MAX];
+	char filter[PATH_MAX];
+	char destination[PATH_MAX];
+	const blend_context_t *ctx;
+	bool nativeBmp;
+	bool failed;
+} batch_job_t;
+
+// Growing array with all the pairs
+typedef struct {
+	batch_job_t *jobs;
+	uint count;
+	uint capacity;
+} batch_list_t;
+
+static int addJob(batch_list_t *list, const char *source, const char *filter, const char *destination){
+
+	if (list->count == list->capacity){
+		uint capacity = (list->capacity == 0) ? 64 : 2 * list->capacity;
+		batch_job_t *jobs = (batch_job_t *) realloc(list->jobs, capacity * sizeof(batch_job_t));
+		if (jobs == NULL){
+			return -1;
+		}
+		list->jobs = jobs;
+		list->capacity = capacity;
+	}
+
+	batch_job_t *job = &list->jobs[list->count++];
+	snprintf(job->source, PATH_MAX, "%s", source);
+	snprintf(job->filter, PATH_MAX, "%s", filter);
+	snprintf(job->destination, PATH_MAX, "%s", destination);
+	job->failed = false;
+
+	return 0;
+}
+
+// Reads the "source filter destination" lines of a manifest
+static int readManifest(const char *path, batch_list_t *list){
+	char source[PATH_MAX], filter[PATH_MAX], destination[PATH_MAX];
+	int fields;
+
+	FILE *file = fopen(path, "r");
+	if (file == NULL){
+		perror("Opening the batch manifest");
+		return -1;
+	}
+
+	while ((fields = fscanf(file, "%4095s %4095s %4095s", source, filter, destination)) == 3){
+		if (addJob(list, source, filter, destination) != 0){
+			fclose(file);
+			return -1;
+		}
+	}
+	fclose(file);
+
+	if (fields != EOF){
+		printf("Malformed batch manifest: %s (expected \"source filter destination\" lines)\n", path);
+		return -1;
+	}
+	return 0;
+}
+
+// Pairs source/NAME.bmp with filter/NAME.bmp, output goes to output/NAME.bmp
+static int readDirectory(const char *path, batch_list_t *list){
+	char sourceDir[PATH_MAX], source[PATH_MAX], filter[PATH_MAX], destination[PATH_MAX];
+	struct dirent *entry;
+	size_t length;
+
+	snprintf(sourceDir, PATH_MAX, "%s/source", path);
+	DIR *dir = opendir(sourceDir);
+	if (dir == NULL){
+		perror("Opening the source directory of the batch");
+		return -1;
+	}
+
+	snprintf(destination, PATH_MAX, "%s/output", path);
+	mkdir(destination, 0755);
+
+	while ((entry = readdir(dir)) != NULL){
+		length = strlen(entry->d_name);
+		if (length < 4 || strcmp(entry->d_name + length - 4, ".bmp") != 0){
+			continue;
+		}
+		snprintf(source, PATH_MAX, "%s/source/%s", path, entry->d_name);
+		snprintf(filter, PATH_MAX, "%s/filter/%s", path, entry->d_name);
+		snprintf(destination, PATH_MAX, "%s/output/%s", path, entry->d_name);
+		if (addJob(list, source, filter, destination) != 0){
+			closedir(dir);
+			return -1;
+		}
+	}
+	closedir(dir);
+
+	return 0;
+}
+
+// Mapped pair: the blend writes straight into the mapping of the output file
+static void blendNative(batch_job_t *job){
+	bmp_image_t srcImage, filterImage, dstImage;
+
+	if (bmpOpen(&srcImage, job->source) != 0){
+		perror(job->source);
+		job->failed = true;
+		return;
+	}
+	if (bmpOpen(&filterImage, job->filter) != 0){
+		perror(job->filter);
+		bmpClose(&srcImage);
+		job->failed = true;
+		return;
+	}
+
+	if (srcImage.width != filterImage.width || srcImage.height != filterImage.height
+			|| srcImage.channels != filterImage.channels){
+		printf("%s and %s don't have the same pixel size\n", job->source, job->filter);
+		job->failed = true;
+	}
+	else if (bmpCreate(&dstImage, job->destination, srcImage.width, srcImage.height, srcImage.channels) != 0){
+		perror(job->destination);
+		job->failed = true;
+	}
+	else {
+		if (blendBmpSerial(job->ctx, &srcImage, &filterImage, &dstImage) != 0){
+			printf("Failed to blend %s with %s: %s\n", job->source, job->filter, strerror(errno));
+			job->failed = true;
+		}
+		bmpClose(&dstImage);
+	}
+
+	bmpClose(&filterImage);
+	bmpClose(&srcImage);
+}
+
+// Load, blend and save of one pair, run by a worker of the pool
+static void *BatchThread(void *args){
+
+	batch_job_t *job = (batch_job_t *)args;
+	CImg<data_t> srcImage, filterImage;
+
+	if (job->nativeBmp){
+		blendNative(job);
+		return NULL;
+	}
+
+	try{
+		srcImage.load(job->source);
+		filterImage.load(job->filter);
+	} catch(CImgIOException& e){
+		printf("Failed to open %s or %s\n", job->source, job->filter);
+		job->failed = true;
+		return NULL;
+	}
+
+	uint width = srcImage.width();
+	uint height = srcImage.height();
+	if ((width != (uint)filterImage.width() || height != (uint)filterImage.height())
+			&& job->ctx->filterMode == BLEND_FILTER_EXACT){
+		printf("%s and %s don't have the same pixel size\n", job->source, job->filter);
+		job->failed = true;
+		return NULL;
+	}
+	if (srcImage.spectrum() != 3 || filterImage.spectrum() != 3){
+		printf("%s and %s must be RGB images\n", job->source, job->filter);
+		job->failed = true;
+		return NULL;
+	}
+
+	// The result is written straight into the pixels of the image to save
+	CImg<data_t> dstImage(width, height, 1, 3);
+
+	blend_image_t src = blendPlanarImage(srcImage.data(), width, height);
+	blend_image_t filter = blendPlanarImage(filterImage.data(), filterImage.width(), filterImage.height());
+	blend_image_t dst = blendPlanarImage(dstImage.data(), width, height);
+
+	// Whole image on this worker: the parallelism is between images. A
+	// failed blend (no memory for the scaled filter) saves nothing.
+	if (blendImageSerial(job->ctx, &src, &filter, &dst) != 0){
+		printf("Failed to blend %s with %s: %s\n", job->source, job->filter, strerror(errno));
+		job->failed = true;
+		return NULL;
+	}
+
+	try{
+		dstImage.save(job->destination);
+	} catch(CImgIOException& e){
+		printf("Failed to save %s\n", job->destination);
+		job->failed = true;
+	}
+
+	return NULL;
+}
+
+int runBatch(const char *path, blend_context_t *ctx, bool nativeBmp){
+
+	batch_list_t list = { NULL, 0, 0 };
+	struct stat info;
+	struct timespec tStart, tEnd;
+	double dElapsedTime;
+	int failed = 0;
+
+	if (stat(path, &info) != 0){
+		perror("Opening the batch");
+		return -1;
+	}
+	if ((S_ISDIR(info.st_mode) ? readDirectory(path, &list) : readManifest(path, &list)) != 0){
+		free(list.jobs);
+		return -1;
+	}
+
+	if (clock_gettime(CLOCK_MONOTONIC, &tStart) == -1){
+		perror("Clock_gettime Error!!");
+		exit(EXIT_FAILURE);
+	}
+
+	// poolSubmit blocks while the queue is full, which bounds the number of
+	// images loaded at the same time
+	for (uint i = 0; i < list.count; i++){
+		list.jobs[i].ctx = ctx;
+		list.jobs[i].nativeBmp = nativeBmp;
+		poolSubmit(&ctx->pool, BatchThread, &list.jobs[i]);
+	}
+	poolWait(&ctx->pool);
+
+	if (clock_gettime(CLOCK_MONOTONIC, &tEnd) == -1){
+		perror("Clock_gettime Error!!");
+		exit(EXIT_FAILURE);
+	}
+
+	dElapsedTime = (tEnd.tv_sec - tStart.tv_sec);
+	dElapsedTime += (tEnd.tv_nsec - tStart.tv_nsec) / 1e+9;
+
+	for (uint i = 0; i < list.count; i++){
+		failed += list.jobs[i].failed ? 1 : 0;
+	}
+
+	printf("\n");
+	printf("Blended images: %u (%d failed)\n", list.count - failed, failed);
+	printf("Elapsed time: %.4f\n", dElapsedTime);
+	printf("Throughput: %.2f images/s\n", (dElapsedTime > 0) ? (list.count - failed) / dElapsedTime : 0.0);
+
+	free(list.jobs);
+	return failed;
+}
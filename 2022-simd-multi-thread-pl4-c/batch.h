@@ -0,0 +1,24 @@
+/*
+ * batch.h
+ *
+ *  Created on: Fall 2022
+ */
+
+#ifndef BATCH_H_
+#define BATCH_H_
+
+#include "blend.h"
+
+// Blends many image pairs. path is either:
+//  - a manifest file with one "source filter destination" line per pair, or
+//  - a directory with "source" and "filter" subdirectories: every .bmp of
+//    source is blended with the file of the same name in filter and stored
+//    with that name in an "output" subdirectory (created if needed).
+// Each pair is one job of the pool of ctx (load, blend and save), so there are as
+// many images in flight as workers and all of them stay busy even when the
+// images are small. Returns the number of pairs that failed, or -1 if the
+// list of pairs could not be read. With nativeBmp the files are mapped
+// instead of loaded with CImg (see bmp.h).
+int runBatch(const char *path, blend_context_t *ctx, bool nativeBmp);
+
+#endif /* BATCH_H_ */
@@ -0,0 +1,533 @@
+/*
+ * bench.cpp
+ *
+ *  Created on: Fall 2022
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include "bench.h"
+#include "buffer_pool.h"
+#include "engine.h"
+#include "roofline.h"
+
+// Passes run before measuring (page faults, caches, frequency ramp-up)
+const uint BENCH_WARMUP = 5;
+
+// Timed passes of every case
+const uint BENCH_PASSES = 30;
+
+// Image sizes of the sweep
+const uint BENCH_SIZES[][2] = {
+	{ 256, 256 },
+	{ 1024, 768 },
+	{ 1920, 1080 },
+	{ 3840, 2160 }
+};
+const uint BENCH_SIZE_COUNT = sizeof(BENCH_SIZES) / sizeof(BENCH_SIZES[0]);
+
+// Everything a pass needs
+typedef struct {
+	worker_pool_t *pool; // NULL for single-thread engines
+	blend_kernel_t kernel;
+	blend_kernel_t streamKernel; // Same instruction set, with streaming stores
+	uint tilePixels;
+	filter_args_t filter_args;
+	filter_image filter_components;
+	buffer_pool_t *buffers; // Of the three images
+} bench_case_t;
+
+// A way of running one pass. New engines only have to be added to ENGINES.
+typedef struct {
+	const char *name;
+	bool threaded; // Swept over the thread counts with a pool
+	void (*pass)(bench_case_t *c);
+} bench_engine_t;
+
+static void passSingleThread(bench_case_t *c){
+	c->kernel(c->filter_args, c->filter_components, 0, c->filter_args.pixelCount);
+}
+
+static void passMultiThread(bench_case_t *c){
+	filterProcess(c->pool, c->kernel, c->filter_args, c->filter_components);
+}
+
+static void passTiled(bench_case_t *c){
+	filterProcessTiled(c->pool, c->kernel, c->filter_args, c->filter_components, c->tilePixels);
+}
+
+static void passTiledStream(bench_case_t *c){
+	filterProcessTiled(c->pool, c->streamKernel, c->filter_args, c->filter_components, c->tilePixels);
+}
+
+static void passStealing(bench_case_t *c){
+	filterProcessStealing(c->pool, c->kernel, c->filter_args, c->filter_components, c->tilePixels, NULL);
+}
+
+static const bench_engine_t ENGINES[] = {
+	{ "single-thread", false, passSingleThread },
+	{ "multi-thread", true, passMultiThread },
+	{ "multi-thread-tiled", true, passTiled },
+	{ "multi-thread-tiled-stream", true, passTiledStream },
+	{ "multi-thread-stealing", true, passStealing }
+};
+const uint ENGINE_COUNT = sizeof(ENGINES) / sizeof(ENGINES[0]);
+
+// Statistics of one case
+typedef struct {
+	double minMs;
+	double medianMs;
+	double p99Ms;
+	double gbPerSecond; // Using the median pass
+	double mpixelsPerSecond;
+	double totalMs; // All the timed passes
+} bench_stats_t;
+
+static double elapsedMs(struct timespec tStart, struct timespec tEnd){
+	return (tEnd.tv_sec - tStart.tv_sec) * 1e+3 + (tEnd.tv_nsec - tStart.tv_nsec) / 1e+6;
+}
+
+static int compareDouble(const void *a, const void *b){
+	double x = *(const double *)a, y = *(const double *)b;
+	return (x > y) - (x < y);
+}
+
+// Bytes read and written by one pass: the source and filter components
+// of every pixel and the destination ones
+static double passBytes(const bench_case_t *c){
+	return (double)c->filter_args.pixelCount * 3 * 3 * sizeof(data_t);
+}
+
+// counters (NULL when not measured) count the timed passes only
+static void measure(const bench_engine_t *engine, bench_case_t *c, double *samples, bench_stats_t *stats,
+		perf_counters_t *counters){
+	struct timespec tStart, tEnd;
+	double totalMs = 0.0;
+
+	for (uint i = 0; i < BENCH_WARMUP; i++){
+		engine->pass(c);
+	}
+	if (counters != NULL){
+		perfStart(counters);
+	}
+	for (uint i = 0; i < BENCH_PASSES; i++){
+		clock_gettime(CLOCK_MONOTONIC, &tStart);
+		engine->pass(c);
+		clock_gettime(CLOCK_MONOTONIC, &tEnd);
+		samples[i] = elapsedMs(tStart, tEnd);
+		totalMs += samples[i];
+	}
+	if (counters != NULL){
+		perfStop(counters);
+	}
+	stats->totalMs = totalMs;
+
+	qsort(samples, BENCH_PASSES, sizeof(double), compareDouble);
+	stats->minMs = samples[0];
+	stats->medianMs = samples[BENCH_PASSES / 2];
+	stats->p99Ms = samples[(BENCH_PASSES * 99 + 99) / 100 - 1]; // Nearest rank
+
+	stats->gbPerSecond = passBytes(c) / (stats->medianMs * 1e+6);
+	stats->mpixelsPerSecond = c->filter_args.pixelCount / (stats->medianMs * 1e+3);
+}
+
+// Synthetic source, filter and destination images of pixelCount pixels,
+// on huge pages as in the program (see buffer_pool.h)
+static int createImages(bench_case_t *c, uint pixelCount){
+	data_t *pSrc = (data_t *) bufferAcquire(c->buffers, pixelCount * 3 * sizeof(data_t));
+	data_t *pFilter = (data_t *) bufferAcquire(c->buffers, pixelCount * 3 * sizeof(data_t));
+	data_t *pDst = (data_t *) bufferAcquire(c->buffers, pixelCount * 3 * sizeof(data_t));
+
+	if (pSrc == NULL || pFilter == NULL || pDst == NULL){
+		bufferRelease(c->buffers, pSrc);
+		bufferRelease(c->buffers, pFilter);
+		bufferRelease(c->buffers, pDst);
+		return -1;
+	}
+	for (uint i = 0; i < pixelCount * 3; i++){
+		pSrc[i] = rand() % 256;
+		pFilter[i] = rand() % 256;
+		pDst[i] = 0;
+	}
+
+	c->filter_args.pixelCount = pixelCount;
+	c->filter_args.pRsrc = pSrc;
+	c->filter_args.pGsrc = pSrc + pixelCount;
+	c->filter_args.pBsrc = pSrc + 2 * pixelCount;
+	c->filter_args.pRdst = pDst;
+	c->filter_args.pGdst = pDst + pixelCount;
+	c->filter_args.pBdst = pDst + 2 * pixelCount;
+	c->filter_components.filterPixelCount = pixelCount;
+	c->filter_components.pRfilter = pFilter;
+	c->filter_components.pGfilter = pFilter + pixelCount;
+	c->filter_components.pBfilter = pFilter + 2 * pixelCount;
+
+	return 0;
+}
+
+static void freeImages(bench_case_t *c){
+	bufferRelease(c->buffers, c->filter_args.pRsrc);
+	bufferRelease(c->buffers, c->filter_components.pRfilter);
+	bufferRelease(c->buffers, c->filter_args.pRdst);
+}
+
+// One field of the counters: empty (CSV) or null (JSON) when not counted
+static void printPerfField(FILE *out, bench_format_t format, const char *name, double value){
+
+	if (format == BENCH_CSV){
+		if (value < 0.0){
+			fprintf(out, ",");
+		} else {
+			fprintf(out, ",%.4f", value);
+		}
+	}
+	else if (value < 0.0){
+		fprintf(out, ", \"%s\": null", name);
+	}
+	else {
+		fprintf(out, ", \"%s\": %.4f", name, value);
+	}
+}
+
+static void printPerfFields(FILE *out, bench_format_t format, const roofline_t *roofline){
+	const perf_sample_t *counters = &roofline->counters;
+
+	printPerfField(out, format, "cycles_per_pass", counters->present[PERF_CYCLES] ? (double)counters->value[PERF_CYCLES] / BENCH_PASSES : -1.0);
+	printPerfField(out, format, "ipc", roofline->ipc);
+	printPerfField(out, format, "instructions_per_byte", roofline->instructionsPerByte);
+	printPerfField(out, format, "llc_misses_per_pass", counters->present[PERF_LLC_MISSES] ? (double)counters->value[PERF_LLC_MISSES] / BENCH_PASSES : -1.0);
+	printPerfField(out, format, "dram_gb_per_s", roofline->dramGbPerSecond);
+	printPerfField(out, format, "peak_fraction", roofline->peakFraction);
+	printPerfField(out, format, "frontend_stalls", roofline->frontendStalls);
+	printPerfField(out, format, "backend_stalls", roofline->backendStalls);
+	if (format == BENCH_CSV){
+		fprintf(out, ",%s", roofline->bound);
+	} else {
+		fprintf(out, ", \"bound\": \"%s\"", roofline->bound);
+	}
+}
+
+// roofline is NULL when the counters are not measured
+static void printRecord(FILE *out, bench_format_t format, bool first, const char *engine, kernel_isa_t isa,
+		blend_mode_t mode, kernel_precision_t precision, uint threads, uint width, uint height, const bench_stats_t *stats,
+		const roofline_t *roofline){
+
+	if (format == BENCH_CSV){
+		fprintf(out, "%s,%s,%s,%s,%s,%u,%u,%u,%u,%.4f,%.4f,%.4f,%.3f,%.3f",
+				engine, kernelName(isa), modeName(mode), precisionName(precision), (sizeof(data_t) == 1) ? "uint8" : "float", threads, width, height,
+				BENCH_PASSES, stats->minMs, stats->medianMs, stats->p99Ms, stats->gbPerSecond, stats->mpixelsPerSecond);
+		if (roofline != NULL){
+			printPerfFields(out, format, roofline);
+		}
+		fprintf(out, "\n");
+	}
+	else {
+		fprintf(out, "%s\n    {\"engine\": \"%s\", \"kernel\": \"%s\", \"mode\": \"%s\", \"precision\": \"%s\", \"data\": \"%s\", \"threads\": %u, "
+				"\"width\": %u, \"height\": %u, \"passes\": %u, \"min_ms\": %.4f, \"median_ms\": %.4f, "
+				"\"p99_ms\": %.4f, \"gb_per_s\": %.3f, \"mpixels_per_s\": %.3f",
+				first ? "" : ",", engine, kernelName(isa), modeName(mode), precisionName(precision), (sizeof(data_t) == 1) ? "uint8" : "float", threads,
+				width, height, BENCH_PASSES, stats->minMs, stats->medianMs, stats->p99Ms,
+				stats->gbPerSecond, stats->mpixelsPerSecond);
+		if (roofline != NULL){
+			printPerfFields(out, format, roofline);
+		}
+		fprintf(out, "}");
+	}
+}
+
+int runBenchmark(const bench_options_t *options){
+
+	FILE *out = stdout;
+	double samples[BENCH_PASSES];
+	bench_stats_t stats;
+	bench_case_t c;
+	worker_pool_t pool;
+	buffer_pool_t buffers;
+	perf_counters_t counters;
+	roofline_t roofline;
+	double peakGbPerSecond = 0.0;
+	bool first = true;
+
+	if (options->outPath != NULL && (out = fopen(options->outPath, "w")) == NULL){
+		perror("Opening the benchmark output");
+		return -1;
+	}
+	if (bufferPoolCreate(&buffers) != 0){
+		perror("Creating the buffer pool");
+		if (out != stdout) fclose(out);
+		return -1;
+	}
+	c.buffers = &buffers;
+
+	// Roof of the memory-bound cases, with every thread
+	if (options->perf){
+		if (poolCreate(&pool, options->maxThreads, options->maxThreads) != 0){
+			printf("ERROR creating the worker pool.\n");
+			exit(EXIT_FAILURE);
+		}
+		peakGbPerSecond = measurePeakBandwidth(&pool);
+		poolDestroy(&pool);
+		fprintf(stderr, "Peak copy bandwidth: %.3f GB/s\n", peakGbPerSecond);
+	}
+
+	if (options->format == BENCH_CSV){
+		fprintf(out, "engine,kernel,mode,precision,data,threads,width,height,passes,min_ms,median_ms,p99_ms,gb_per_s,mpixels_per_s%s\n",
+				options->perf ? ",cycles_per_pass,ipc,instructions_per_byte,llc_misses_per_pass,dram_gb_per_s,"
+						"peak_fraction,frontend_stalls,backend_stalls,bound" : "");
+	}
+	else {
+		fprintf(out, "{\n  \"host\": {\"cpus\": %ld, \"best_kernel\": \"%s\"",
+				sysconf(_SC_NPROCESSORS_ONLN), kernelName(kernelBest()));
+		if (options->perf){
+			fprintf(out, ", \"peak_gb_per_s\": %.3f", peakGbPerSecond);
+		}
+		fprintf(out, "},\n  \"tile_pixels\": %u,\n  \"results\": [", options->tilePixels);
+	}
+
+	for (uint s = 0; s < BENCH_SIZE_COUNT; s++){
+		uint width = BENCH_SIZES[s][0];
+		uint height = BENCH_SIZES[s][1];
+		uint pixelCount = width * height;
+
+		if (createImages(&c, pixelCount) != 0){
+			perror("Allocating benchmark images");
+			bufferPoolDestroy(&buffers);
+			if (out != stdout) fclose(out);
+			return -1;
+		}
+
+		for (uint e = 0; e < ENGINE_COUNT; e++){
+			for (int k = 0; k < KERNEL_COUNT; k++){
+				kernel_isa_t isa = (kernel_isa_t)k;
+				if ((options->kernelForced && isa != options->isa) || !kernelSupported(isa)){
+					continue;
+				}
+				c.kernel = kernelSet(isa, options->precision)->range[options->mode];
+				c.streamKernel = kernelSet(isa, options->precision)->stream[options->mode];
+				c.tilePixels = options->tilePixels;
+
+				// 1, 2, 4, ... and maxThreads itself
+				uint threads = 1;
+				while (true){
+					c.pool = NULL;
+					if (ENGINES[e].threaded){
+						if (poolCreate(&pool, threads, threads) != 0){
+							printf("ERROR creating the worker pool.\n");
+							exit(EXIT_FAILURE);
+						}
+						c.pool = &pool;
+					}
+
+					// Counters of the calling thread and of the workers of this case
+					bool counted = options->perf && perfOpen(&counters, c.pool) == 0;
+					if (options->perf && !counted){
+						perror("Opening the performance counters");
+					}
+
+					fprintf(stderr, "%s %s %u threads %ux%u\n", ENGINES[e].name, kernelName(isa), threads, width, height);
+					measure(&ENGINES[e], &c, samples, &stats, counted ? &counters : NULL);
+					if (counted){
+						perf_sample_t total;
+						perfReadTotal(&counters, &total);
+						perfClose(&counters);
+						rooflineCompute(&roofline, &total, stats.totalMs / 1e+3, passBytes(&c) * BENCH_PASSES, peakGbPerSecond);
+					}
+					printRecord(out, options->format, first, ENGINES[e].name, isa, options->mode, options->precision, threads, width, height,
+							&stats, counted ? &roofline : NULL);
+					first = false;
+
+					if (c.pool != NULL){
+						poolDestroy(&pool);
+					}
+					if (!ENGINES[e].threaded || threads == options->maxThreads){
+						break;
+					}
+					threads = (threads * 2 < options->maxThreads) ? threads * 2 : options->maxThreads;
+				}
+			}
+		}
+
+		freeImages(&c);
+	}
+	bufferPoolDestroy(&buffers);
+
+	if (options->format == BENCH_JSON){
+		fprintf(out, "\n  ]\n}\n");
+	}
+	if (out != stdout){
+		fclose(out);
+	}
+	return 0;
+}
+
+/***********************************************
+ *
+ * Autotuner
+ *
+ * *********************************************/
+
+// Tiles and chunks tried by the autotuner (0: untiled)
+const uint TUNE_TILES[] = { 0, 4096, 16384, 65536 };
+const uint TUNE_TILE_COUNT = sizeof(TUNE_TILES) / sizeof(TUNE_TILES[0]);
+
+static void passSerialTiled(bench_case_t *c){
+	filterSlice(c->kernel, c->filter_args, c->filter_components, 0, c->filter_args.pixelCount, c->tilePixels);
+}
+
+// Median of one configuration
+static double tuneCase(void (*pass)(bench_case_t *c), bench_case_t *c){
+	bench_engine_t engine = { "tune", c->pool != NULL, pass };
+	double samples[BENCH_PASSES];
+	bench_stats_t stats;
+
+	measure(&engine, c, samples, &stats, NULL);
+	return stats.medianMs;
+}
+
+int runAutotune(const char *path, uint maxThreads){
+
+	blend_profile_t profile;
+	bench_case_t c;
+	worker_pool_t pool;
+	buffer_pool_t buffers;
+	uint pixelCounts[BENCH_SIZE_COUNT];
+	kernel_isa_t bestIsa[BENCH_SIZE_COUNT];
+	double serialMs[BENCH_SIZE_COUNT];
+
+	for (uint s = 0; s < BENCH_SIZE_COUNT; s++){
+		pixelCounts[s] = BENCH_SIZES[s][0] * BENCH_SIZES[s][1];
+	}
+	if (bufferPoolCreate(&buffers) != 0){
+		perror("Creating the buffer pool");
+		return -1;
+	}
+	c.buffers = &buffers;
+
+	// 1. Fastest kernel of every size, on one thread
+	for (uint s = 0; s < BENCH_SIZE_COUNT; s++){
+		if (createImages(&c, pixelCounts[s]) != 0){
+			perror("Allocating autotune images");
+			bufferPoolDestroy(&buffers);
+			return -1;
+		}
+		c.pool = NULL;
+		c.tilePixels = 0;
+		serialMs[s] = 0.0;
+		for (int k = 0; k < KERNEL_COUNT; k++){
+			if (!kernelSupported((kernel_isa_t)k)){
+				continue;
+			}
+			c.kernel = kernelFunction((kernel_isa_t)k, BLEND_OVERLAP);
+			double ms = tuneCase(passSingleThread, &c);
+			fprintf(stderr, "%ux%u %s serial: %.4f ms\n", BENCH_SIZES[s][0], BENCH_SIZES[s][1], kernelName((kernel_isa_t)k), ms);
+			if (serialMs[s] == 0.0 || ms < serialMs[s]){
+				serialMs[s] = ms;
+				bestIsa[s] = (kernel_isa_t)k;
+			}
+		}
+		freeImages(&c);
+	}
+
+	// 2. Workers: fastest thread count on the largest size
+	uint last = BENCH_SIZE_COUNT - 1;
+	double bestMs = 0.0;
+	profile.threads = 1;
+	if (createImages(&c, pixelCounts[last]) != 0){
+		perror("Allocating autotune images");
+		bufferPoolDestroy(&buffers);
+		return -1;
+	}
+	c.kernel = kernelFunction(bestIsa[last], BLEND_OVERLAP);
+	c.tilePixels = 0;
+	// 1, 2, 4, ... and maxThreads itself
+	uint threads = 1;
+	while (true){
+		if (poolCreate(&pool, threads, threads) != 0){
+			printf("ERROR creating the worker pool.\n");
+			exit(EXIT_FAILURE);
+		}
+		c.pool = &pool;
+		double ms = tuneCase(passMultiThread, &c);
+		fprintf(stderr, "%u threads: %.4f ms\n", threads, ms);
+		if (bestMs == 0.0 || ms < bestMs){
+			bestMs = ms;
+			profile.threads = threads;
+		}
+		poolDestroy(&pool);
+		if (threads >= maxThreads){
+			break;
+		}
+		threads = (threads * 2 < maxThreads) ? threads * 2 : maxThreads;
+	}
+	freeImages(&c);
+
+	// 3. Engine and tile of every size with those workers
+	if (poolCreate(&pool, profile.threads, profile.threads) != 0){
+		printf("ERROR creating the worker pool.\n");
+		exit(EXIT_FAILURE);
+	}
+	profile.nBuckets = BENCH_SIZE_COUNT;
+	for (uint s = 0; s < BENCH_SIZE_COUNT; s++){
+		tune_bucket_t *bucket = &profile.buckets[s];
+
+		if (createImages(&c, pixelCounts[s]) != 0){
+			perror("Allocating autotune images");
+			poolDestroy(&pool);
+			bufferPoolDestroy(&buffers);
+			return -1;
+		}
+		c.kernel = kernelFunction(bestIsa[s], BLEND_OVERLAP);
+		bucket->isa = bestIsa[s];
+		bucket->engine = TUNE_SERIAL;
+		bucket->tilePixels = 0;
+		bestMs = serialMs[s];
+
+		// Halfway (geometrically) to the next size
+		bucket->maxPixels = (s == last) ? UINT_MAX : (uint)sqrt((double)pixelCounts[s] * pixelCounts[s + 1]);
+
+		for (uint t = 0; t < TUNE_TILE_COUNT; t++){
+			c.tilePixels = TUNE_TILES[t];
+
+			c.pool = NULL;
+			double ms = (c.tilePixels > 0) ? tuneCase(passSerialTiled, &c) : serialMs[s];
+			if (ms < bestMs){
+				bestMs = ms;
+				bucket->engine = TUNE_SERIAL;
+				bucket->tilePixels = c.tilePixels;
+			}
+
+			c.pool = &pool;
+			ms = tuneCase(passTiled, &c);
+			if (ms < bestMs){
+				bestMs = ms;
+				bucket->engine = TUNE_STATIC;
+				bucket->tilePixels = c.tilePixels;
+			}
+
+			if (c.tilePixels > 0){
+				ms = tuneCase(passStealing, &c);
+				if (ms < bestMs){
+					bestMs = ms;
+					bucket->engine = TUNE_STEALING;
+					bucket->tilePixels = c.tilePixels;
+				}
+			}
+		}
+		fprintf(stderr, "%ux%u: %s %s tile %u (%.4f ms)\n", BENCH_SIZES[s][0], BENCH_SIZES[s][1], kernelName(bucket->isa),
+				tuneEngineName(bucket->engine), bucket->tilePixels, bestMs);
+		freeImages(&c);
+	}
+	poolDestroy(&pool);
+	bufferPoolDestroy(&buffers);
+
+	if (profileSave(&profile, path) != 0){
+		perror("Writing the tuning profile");
+		return -1;
+	}
+	printf("Profile written to %s\n", profilePath(path));
+	return 0;
+}
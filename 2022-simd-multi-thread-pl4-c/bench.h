@@ -0,0 +1,47 @@
+/*
+ * bench.h
+ *
+ *  Created on: Fall 2022
+ */
+
+#ifndef BENCH_H_
+#define BENCH_H_
+
+#include "kernels.h"
+#include "profile.h"
+
+// Format of the results
+typedef enum {
+	BENCH_CSV,
+	BENCH_JSON
+} bench_format_t;
+
+typedef struct {
+	bench_format_t format;
+	const char *outPath; // File for the results, NULL for stdout
+	bool kernelForced; // Only measure isa instead of every supported kernel
+	kernel_isa_t isa;
+	uint maxThreads; // Thread counts are swept from 1 up to this value
+	uint tilePixels; // Tile of the tiled engines, chunk of the stealing one
+	blend_mode_t mode; // Blend mode of every case
+	bool perf; // Hardware counters of every case and its bound (see roofline.h)
+	kernel_precision_t precision; // Of every kernel
+} bench_options_t;
+
+// Measures every engine (single-thread, multi-thread, multi-thread
+// tiled with regular or streaming stores, and work stealing) with every
+// kernel, thread count and image size on synthetic images. Each case
+// runs some warm-up passes and then timed passes (monotonic clock);
+// the results have min, median and p99 per pass, GB/s and pixels/s.
+// With perf they also have the counters of the timed passes (IPC, cache
+// misses, stalls) and the bound they imply against the peak bandwidth of
+// the host. Progress goes to stderr. Returns 0 on success and -1 on error.
+int runBenchmark(const bench_options_t *options);
+
+// Measures the kernels, the thread counts up to maxThreads and the
+// engines and tiles of every image size of the benchmark, and writes the
+// fastest configuration of this host to the profile (path as in
+// profilePath, see profile.h). Returns 0 on success and -1 on error.
+int runAutotune(const char *path, uint maxThreads);
+
+#endif /* BENCH_H_ */
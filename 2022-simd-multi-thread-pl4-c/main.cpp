@@ -0,0 +1,644 @@
+/*
+ * Main.cpp
+ *
+ *  Created on: Fall 2022
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <math.h>
+#include <pthread.h>
+#include <CImg.h>
+#include <time.h>
+#include <unistd.h>
+#include "batch.h"
+#include "bench.h"
+#include "blend.h"
+#include "bmp.h"
+#include "engine.h"
+#include "incremental.h"
+#include "preview.h"
+#include "region.h"
+#include "roofline.h"
+#include "server.h"
+#include "stream.h"
+#include "validate.h"
+
+using namespace cimg_library;
+
+// Name of images files
+const char *SOURCE_IMG = "bailarina.bmp";
+const char *FILTER_IMG = "background_V.bmp";
+const char *DESTINATION_IMG = "bailarina2.bmp";
+
+// Number of times the Blend Algorithm is repeated
+const uint REPEAT_ALGORITHM = 60;
+
+// Rectangles of --roi
+#define MAX_RECTS 16
+
+// Number of thread to use: 4 processors with 4 cores each - No Hyperthreading: 1 thread per core
+// (with --schedule=numa every thread is pinned to one of those cores). Only when the tuning is
+// forced: otherwise the workers are those of the profile, or one per processor without one.
+const uint NUMBER_OF_THREADS = 16;
+
+// Names of blend_schedule_t, in its order (engine of the --perf report)
+static const char *SCHEDULE_NAMES[] = { "static", "stealing", "numa" };
+
+// Counters of the calling thread and the workers of ctx, started right
+// before the timed passes (--perf). Returns false if none can be opened
+// (the passes are still timed).
+static bool startCounters(perf_counters_t *counters, blend_context_t *ctx){
+
+	if (perfOpen(counters, &ctx->pool) != 0){
+		perror("Opening the performance counters");
+		return false;
+	}
+	perfStart(counters);
+	return true;
+}
+
+// Counters of every thread and the bound of the engine over passes that
+// took seconds and moved bytes. The peak bandwidth is measured afterwards
+// with the same workers.
+static void reportCounters(perf_counters_t *counters, blend_context_t *ctx, const char *engine, double seconds, double bytes){
+	perf_sample_t total;
+	roofline_t roofline;
+
+	perfStop(counters);
+	perfReadTotal(counters, &total);
+	printPerfThreads(stdout, counters);
+	perfClose(counters);
+
+	rooflineCompute(&roofline, &total, seconds, bytes, measurePeakBandwidth(&ctx->pool));
+	printRoofline(stdout, engine, &roofline);
+}
+
+// Blend of the mapped files (--native-bmp): no CImg, no display. The pixels
+// are read from the page cache and the result is written to the mapping of
+// the destination file. With rectangles (--roi) only their pixels are
+// blended; the rest of the destination is a copy of the source.
+static int blendNativeBmp(blend_context_t *ctx, bool perf, const blend_rect_t *rects, uint nRects){
+	bmp_image_t srcImage, filterImage, dstImage;
+	struct timespec tStart, tEnd;
+	double dElapsedTime;
+	perf_counters_t counters;
+
+	if (bmpOpen(&srcImage, SOURCE_IMG) != 0){
+		printf("Failed to open the source image. Expected name: %s\n", SOURCE_IMG);
+		return -1;
+	}
+	if (bmpOpen(&filterImage, FILTER_IMG) != 0){
+		printf("Failed to open the filter image. Expected name: %s\n", FILTER_IMG);
+		bmpClose(&srcImage);
+		return -1;
+	}
+	if (srcImage.width != filterImage.width || srcImage.height != filterImage.height
+			|| srcImage.channels != filterImage.channels){
+		printf("Source Image and Filter Image don't have the same pixel size!!\n");
+		bmpClose(&filterImage);
+		bmpClose(&srcImage);
+		return -1;
+	}
+	if (bmpCreate(&dstImage, DESTINATION_IMG, srcImage.width, srcImage.height, srcImage.channels) != 0){
+		perror("Creating the destination image");
+		bmpClose(&filterImage);
+		bmpClose(&srcImage);
+		return -1;
+	}
+
+	blend_frame_t src = bmpFrame(&srcImage);
+	blend_frame_t filter = bmpFrame(&filterImage);
+	blend_frame_t dst = bmpFrame(&dstImage);
+	if (nRects > 0){
+		blendFrameCopy(&src, &dst); // Row by row: a top-down source goes to a bottom-up file
+	}
+
+	bool counted = perf && startCounters(&counters, ctx);
+	if(clock_gettime(CLOCK_MONOTONIC, &tStart) == -1){
+		perror("Clock_gettime Error!!");
+		exit(EXIT_FAILURE);
+	}
+
+	for(uint i = 0; i < REPEAT_ALGORITHM; i++){
+		int status = (nRects > 0) ? blendFrameRects(ctx, &src, &filter, &dst, rects, nRects)
+				: blendBmp(ctx, &srcImage, &filterImage, &dstImage);
+		if (status != 0){
+			perror("Blending the images");
+			bmpClose(&dstImage);
+			bmpClose(&filterImage);
+			bmpClose(&srcImage);
+			return -1;
+		}
+	}
+
+	if(clock_gettime(CLOCK_MONOTONIC, &tEnd) == -1){
+		perror("Clock_gettime Error!!");
+		exit(EXIT_FAILURE);
+	}
+
+	dElapsedTime = (tEnd.tv_sec - tStart.tv_sec);
+	dElapsedTime += (tEnd.tv_nsec - tStart.tv_nsec) / 1e+9;
+
+	printf("\n");
+	printf("Elapsed time: %.4f", dElapsedTime);
+	printf("\n");
+	if (counted){
+		// Every pass reads the source and the filter and writes the destination
+		double bytes = 3.0 * dstImage.rowBytes * dstImage.height * REPEAT_ALGORITHM;
+		reportCounters(&counters, ctx, "native-bmp", dElapsedTime, bytes);
+	}
+
+	// The destination is already in the file
+	bmpClose(&dstImage);
+	bmpClose(&filterImage);
+	bmpClose(&srcImage);
+
+	return 0;
+}
+
+// Work of every thread of the stealing scheduler over all the passes
+static void printSchedStats(const sched_stats_t *stats){
+
+	if (stats->passes == 0){
+		return;
+	}
+	printf("\nThread  Chunks  Stolen  Busy (ms)  Idle (ms)\n");
+	for (uint i = 0; i < stats->nWorkers; i++){
+		const worker_stats_t *w = &stats->workers[i];
+		printf("%6u %7lu %7lu %10.3f %10.3f\n", i, (unsigned long)w->chunks, (unsigned long)w->stolen, w->busyMs, w->idleMs);
+	}
+}
+
+// Pages of every node on the node of their worker, and on other nodes
+static void printNumaReport(const char *label, const numa_report_t *report){
+	uint64_t local = 0, remote = 0;
+
+	for (uint node = 0; node < report->nNodes; node++){
+		local += report->localPages[node];
+		remote += report->remotePages[node];
+	}
+	printf("%s: %.1f%% remote pages (%lu local, %lu remote, %lu not present)\n", label,
+			(local + remote > 0) ? 100.0 * remote / (local + remote) : 0.0,
+			(unsigned long)local, (unsigned long)remote, (unsigned long)report->absentPages);
+	for (uint node = 0; node < report->nNodes; node++){
+		uint64_t pages = report->localPages[node] + report->remotePages[node];
+		if (pages > 0){
+			printf("  node %u: %.1f%% remote\n", node, 100.0 * report->remotePages[node] / pages);
+		}
+	}
+}
+
+// Mappings of the buffer pool during the passes (none once it is warm)
+static void printBufferStats(const buffer_stats_t *before, buffer_pool_t *buffers){
+	buffer_stats_t after = bufferPoolStats(buffers);
+
+	printf("Buffers: %lu mapped during the passes, %lu requests (%lu reused), %lu huge, peak %.1f MiB\n",
+			(unsigned long)(after.mappings - before->mappings), (unsigned long)after.requests,
+			(unsigned long)after.reuses, (unsigned long)after.hugeMappings, after.peakBytes / (1024.0 * 1024.0));
+}
+
+int main(int argc, char **argv){
+
+	// The widest kernel supported by the host is used, unless one is forced
+	// with --kernel=<scalar|sse2|avx2|avx512> (e.g. to compare them)
+	kernel_isa_t isa = kernelBest();
+	const char *batchPath = NULL; // --batch=<manifest|directory>
+	const char *servePath = NULL; // --serve=<socket>: blend daemon
+	blend_rect_t rects[MAX_RECTS]; // --roi=<x>,<y>,<width>,<height> (repeatable), with --native-bmp
+	uint nRects = 0;
+	bool streaming = false; // --stream=<raw:WxH|y4m>: frames from stdin to stdout
+	stream_format_t streamFormat = STREAM_RAW;
+	uint streamWidth = 0, streamHeight = 0;
+	bool benchmark = false; // --bench=<csv|json> [--bench-out=<file>]
+	bool autotune = false; // --autotune: measure this host and write its profile
+	bool tuningForced = false; // --kernel, --tile or --schedule: the profile is not used
+	bool nativeBmp = false; // --native-bmp: mapped BMP files instead of CImg
+	bool prepared = false; // --prepared: Overlap coefficients of the filter computed once
+	bool incremental = false; // --incremental: only the tiles whose inputs changed are blended again
+	uint previewFactor = 0; // --preview=<2|4|8>: thumbnail of the blend shown before the full passes
+	bool perf = false; // --perf: hardware counters of every thread and the bound of the engine
+	bool validate = false; // --validate: error of the kernels against the exact scalar one
+	kernel_precision_t precision = PRECISION_EXACT; // --precision=<exact|approx>
+	uint tilePixels = 0; // --tile=<pixels>: tiled execution
+	blend_stores_t stores = BLEND_STORES_AUTO; // --stores=<auto|cached|stream>
+	blend_mode_t mode = BLEND_OVERLAP; // --mode=<overlap|multiply|screen|...>
+	blend_schedule_t schedule = BLEND_SCHEDULE_STATIC; // --schedule=<static|stealing|numa>
+	blend_filter_mode_t filterMode = BLEND_FILTER_EXACT; // --filter=<exact|wrap|nearest|bilinear>
+	bench_options_t benchOptions = { BENCH_JSON, NULL, false, KERNEL_SCALAR, NUMBER_OF_THREADS, DEFAULT_TILE_PIXELS, BLEND_OVERLAP, false, PRECISION_EXACT };
+	for (int i = 1; i < argc; i++){
+		if (strncmp(argv[i], "--kernel=", 9) == 0){
+			if (kernelFromName(argv[i] + 9, &isa) != 0){
+				printf("Unknown kernel: %s\n", argv[i] + 9);
+				exit(EXIT_FAILURE);
+			}
+			if (!kernelSupported(isa)){
+				printf("The %s kernel is not supported by this processor.\n", kernelName(isa));
+				exit(EXIT_FAILURE);
+			}
+			benchOptions.kernelForced = true;
+			tuningForced = true;
+		}
+		else if (strncmp(argv[i], "--batch=", 8) == 0){
+			batchPath = argv[i] + 8;
+		}
+		else if (strncmp(argv[i], "--serve=", 8) == 0){
+			servePath = argv[i] + 8;
+		}
+		else if (strncmp(argv[i], "--roi=", 6) == 0){
+			blend_rect_t *rect = &rects[nRects];
+			if (nRects == MAX_RECTS || sscanf(argv[i] + 6, "%u,%u,%u,%u", &rect->x, &rect->y, &rect->width, &rect->height) != 4){
+				printf("Bad or too many rectangles: %s\n", argv[i] + 6);
+				exit(EXIT_FAILURE);
+			}
+			nRects++;
+			if (blendRectsOverlap(rects, nRects, UINT_MAX, UINT_MAX)){
+				printf("Overlapping rectangles: %s\n", argv[i] + 6);
+				exit(EXIT_FAILURE);
+			}
+		}
+		else if (strcmp(argv[i], "--stream=y4m") == 0){
+			streaming = true;
+			streamFormat = STREAM_Y4M;
+		}
+		else if (strncmp(argv[i], "--stream=raw:", 13) == 0){
+			if (sscanf(argv[i] + 13, "%ux%u", &streamWidth, &streamHeight) != 2 || streamWidth == 0 || streamHeight == 0){
+				printf("Bad frame size: %s\n", argv[i] + 13);
+				exit(EXIT_FAILURE);
+			}
+			streaming = true;
+			streamFormat = STREAM_RAW;
+		}
+		else if (strcmp(argv[i], "--bench=csv") == 0 || strcmp(argv[i], "--bench=json") == 0){
+			benchmark = true;
+			benchOptions.format = (strcmp(argv[i], "--bench=csv") == 0) ? BENCH_CSV : BENCH_JSON;
+		}
+		else if (strncmp(argv[i], "--bench-out=", 12) == 0){
+			benchOptions.outPath = argv[i] + 12;
+		}
+		else if (strcmp(argv[i], "--native-bmp") == 0){
+			nativeBmp = true;
+		}
+		else if (strcmp(argv[i], "--prepared") == 0){
+			prepared = true;
+		}
+		else if (strcmp(argv[i], "--incremental") == 0){
+			incremental = true;
+		}
+		else if (strncmp(argv[i], "--preview=", 10) == 0){
+			uint previewWidth, previewHeight;
+			previewFactor = strtoul(argv[i] + 10, NULL, 10);
+			if (blendPreviewSize(1, 1, previewFactor, &previewWidth, &previewHeight) != 0){
+				printf("Unknown preview factor: %s\n", argv[i] + 10);
+				exit(EXIT_FAILURE);
+			}
+		}
+		else if (strncmp(argv[i], "--precision=", 12) == 0){
+			if (precisionFromName(argv[i] + 12, &precision) != 0){
+				printf("Unknown precision: %s\n", argv[i] + 12);
+				exit(EXIT_FAILURE);
+			}
+			benchOptions.precision = precision;
+		}
+		else if (strcmp(argv[i], "--validate") == 0){
+			validate = true;
+		}
+		else if (strcmp(argv[i], "--perf") == 0){
+			perf = true;
+			benchOptions.perf = true;
+		}
+		else if (strncmp(argv[i], "--tile=", 7) == 0){
+			tilePixels = strtoul(argv[i] + 7, NULL, 10);
+			tuningForced = true;
+			benchOptions.tilePixels = (tilePixels > 0) ? tilePixels : DEFAULT_TILE_PIXELS;
+		}
+		else if (strncmp(argv[i], "--mode=", 7) == 0){
+			if (modeFromName(argv[i] + 7, &mode) != 0){
+				printf("Unknown blend mode: %s\n", argv[i] + 7);
+				exit(EXIT_FAILURE);
+			}
+			benchOptions.mode = mode;
+		}
+		else if (strcmp(argv[i], "--stores=auto") == 0){
+			stores = BLEND_STORES_AUTO;
+		}
+		else if (strcmp(argv[i], "--stores=cached") == 0){
+			stores = BLEND_STORES_CACHED;
+		}
+		else if (strcmp(argv[i], "--stores=stream") == 0){
+			stores = BLEND_STORES_STREAM;
+		}
+		else if (strcmp(argv[i], "--schedule=static") == 0){
+			schedule = BLEND_SCHEDULE_STATIC;
+			tuningForced = true;
+		}
+		else if (strcmp(argv[i], "--schedule=stealing") == 0){
+			schedule = BLEND_SCHEDULE_STEALING;
+			tuningForced = true;
+		}
+		else if (strcmp(argv[i], "--schedule=numa") == 0){
+			schedule = BLEND_SCHEDULE_NUMA;
+			tuningForced = true;
+		}
+		else if (strcmp(argv[i], "--autotune") == 0){
+			autotune = true;
+		}
+		else if (strncmp(argv[i], "--filter=", 9) == 0){
+			if (samplerFromName(argv[i] + 9, &filterMode) != 0){
+				printf("Unknown filter mode: %s\n", argv[i] + 9);
+				exit(EXIT_FAILURE);
+			}
+		}
+		else {
+			printf("Usage: %s [--kernel=<scalar|sse2|avx2|avx512>] [--batch=<manifest|directory>]\n"
+					"       [--bench=<csv|json>] [--bench-out=<file>] [--autotune] [--native-bmp] [--prepared]\n"
+					"       [--tile=<pixels>] [--stores=<auto|cached|stream>] [--mode=<blend mode>]\n"
+					"       [--schedule=<static|stealing|numa>] [--filter=<exact|wrap|nearest|bilinear>] [--perf]\n"
+					"       [--precision=<exact|approx>] [--validate] [--serve=<socket>] [--incremental]\n"
+					"       [--stream=<raw:WxH|y4m>] [--roi=<x>,<y>,<width>,<height>]... [--preview=<2|4|8>]\n", argv[0]);
+			exit(EXIT_FAILURE);
+		}
+	}
+	if (nRects > 0 && (!nativeBmp || batchPath != NULL || servePath != NULL || streaming)){
+		printf("--roi needs --native-bmp (and no --batch, --serve or --stream)\n");
+		exit(EXIT_FAILURE);
+	}
+	// The mapped files are blended as interleaved frames, which have no sampler
+	if (nativeBmp && filterMode != BLEND_FILTER_EXACT){
+		printf("--filter=%s needs the CImg path: it cannot be used with --native-bmp\n", samplerName(filterMode));
+		exit(EXIT_FAILURE);
+	}
+	long nProcessors = sysconf(_SC_NPROCESSORS_ONLN);
+	if (nProcessors > (long)benchOptions.maxThreads){
+		benchOptions.maxThreads = (nProcessors < MAX_THREADS) ? nProcessors : MAX_THREADS;
+	}
+
+	// Benchmark mode: sweeps engines, kernels, thread counts and image sizes
+	if (benchmark){
+		benchOptions.isa = isa;
+		return (runBenchmark(&benchOptions) == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+
+	// Validation: error of the approximate kernels, then exit
+	if (validate){
+		return (runValidation(mode) == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+
+	// Autotune: the profile is read by blendCreate in the next runs
+	if (autotune){
+		return (runAutotune(NULL, benchOptions.maxThreads) == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+
+	// Threads are created once and reused by every pass. With the tuning
+	// profile blendCreate reads, the workers, kernel, engine and tile are
+	// the ones measured on this host
+	blend_context_t ctx;
+	if (blendCreate(&ctx, tuningForced ? NUMBER_OF_THREADS : 0) != 0){
+		printf("ERROR creating the worker pool.\n");
+		exit(EXIT_FAILURE);
+	}
+	bool tuned = !tuningForced && ctx.autoTune;
+	blendSetAutoTune(&ctx, tuned);
+	blendSetKernel(&ctx, isa);
+	blendSetTiling(&ctx, tilePixels, stores);
+	blendSetMode(&ctx, mode);
+	blendSetPrecision(&ctx, precision);
+	if (blendSetSchedule(&ctx, schedule) != 0){
+		perror("Pinning the workers");
+		exit(EXIT_FAILURE);
+	}
+
+	// Streaming: stdout carries the frames, so nothing else is printed on it
+	if (streaming){
+		int status = runStream(&ctx, streamFormat, streamWidth, streamHeight, FILTER_IMG);
+		blendDestroy(&ctx);
+		return (status == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+	if (tuned){
+		printf("Profile: %s (%u threads)\n", profilePath(NULL), ctx.pool.nThreads);
+	}
+	if (tuned){
+		printf("Kernel: from the profile, per image size\n");
+	} else {
+		printf("Kernel: %s\n", kernelName(isa));
+	}
+	printf("Mode: %s (%s)\n", modeName(mode), precisionName(precision));
+	blendSetFilterMode(&ctx, filterMode);
+
+	// Daemon: jobs of clients over a Unix socket with this context
+	if (servePath != NULL){
+		int status = runServer(servePath, &ctx);
+		blendDestroy(&ctx);
+		return (status == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+
+	cimg::exception_mode(0);
+
+	// Batch mode: many pairs, one pair per job of the pool
+	if (batchPath != NULL){
+		int failed = runBatch(batchPath, &ctx, nativeBmp);
+		blendDestroy(&ctx);
+		return (failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+
+	if (nativeBmp){
+		int status = blendNativeBmp(&ctx, perf, rects, nRects);
+		blendDestroy(&ctx);
+		return (status == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+
+	// Open file and object initialization (loaded in place, without a copy)
+	CImg<data_t> srcImage;
+	try
+	{
+		srcImage.load(SOURCE_IMG);
+	}
+	catch(CImgIOException& e){
+		printf("Failed to open the source image. Expected name: %s\n", SOURCE_IMG);
+		exit(EXIT_FAILURE);
+	}
+
+	// Filter Image initialization
+	CImg<data_t> filterImage;
+
+	try{
+
+		filterImage.load(FILTER_IMG);
+	} catch( CImgIOException& e ){
+		printf("Failed to open the filter image. Expected name: %s\n", FILTER_IMG);
+		exit(EXIT_FAILURE);
+	}
+	uint widthFilter = filterImage.width();// Getting information from the Filter image
+	uint heightFilter = filterImage.height();
+
+	// Time variables
+	struct timespec tStart, tEnd;
+	double dElapsedTime;
+
+	if (previewFactor == 0){
+		srcImage.display(); // Displays the source image
+	}
+	uint width = srcImage.width();// Getting information from the source image
+	uint height = srcImage.height();
+	uint nComp = srcImage.spectrum();// source image number of components
+
+	// Checking that Image and Filter have the same size, unless the filter
+	// is tiled or scaled on the fly (--filter)
+	if((height != heightFilter || width != widthFilter) && filterMode == BLEND_FILTER_EXACT){
+		perror("Source Image and Filter Image don't have the same pixel size!!");
+		exit(EXIT_FAILURE);
+	}
+
+	// The destination image is a buffer of the pool of the context (huge
+	// pages, see buffer_pool.h) shared with CImg, and the blend writes
+	// straight into its pixels, so nothing is copied before saving it.
+	// In case of normal color images use nComp=3,
+	// In case of B/W images use nComp=1.
+	data_t *dstPixels = (data_t *) blendAcquire(&ctx, (size_t)width * height * nComp * sizeof(data_t));
+	if (dstPixels == NULL){
+		perror("Allocating the destination image");
+		exit(EXIT_FAILURE);
+	}
+	CImg<data_t> dstImage(dstPixels, width, height, 1, nComp, true);
+
+	// Views of the R, G and B planes of the three images
+	blend_image_t src = blendPlanarImage(srcImage.data(), width, height);
+	blend_image_t filter = blendPlanarImage(filterImage.data(), widthFilter, heightFilter);
+	blend_image_t dst = blendPlanarImage(dstImage.data(), width, height);
+
+	// Thumbnail of the blend (1 / previewFactor of the width and height),
+	// shown right away instead of the source: one pass over the inputs
+	if (previewFactor > 0){
+		uint previewWidth, previewHeight;
+		if (width != widthFilter || height != heightFilter){
+			printf("--preview needs a filter of the size of the source.\n");
+			exit(EXIT_FAILURE);
+		}
+		blendPreviewSize(width, height, previewFactor, &previewWidth, &previewHeight);
+		data_t *previewPixels = (data_t *) blendAcquire(&ctx, (size_t)previewWidth * previewHeight * nComp * sizeof(data_t));
+		if (previewPixels == NULL){
+			perror("Allocating the preview image");
+			exit(EXIT_FAILURE);
+		}
+		CImg<data_t> previewImage(previewPixels, previewWidth, previewHeight, 1, nComp, true);
+		blend_image_t preview = blendPlanarImage(previewPixels, previewWidth, previewHeight);
+
+		clock_gettime(CLOCK_MONOTONIC, &tStart);
+		blendImagePreview(&ctx, &src, &filter, &preview, previewFactor);
+		clock_gettime(CLOCK_MONOTONIC, &tEnd);
+		printf("Preview 1/%u (%ux%u): %.4f ms\n", previewFactor, previewWidth, previewHeight,
+				(tEnd.tv_sec - tStart.tv_sec) * 1e3 + (tEnd.tv_nsec - tStart.tv_nsec) / 1e6);
+		previewImage.display();
+		blendRelease(&ctx, previewPixels);
+	}
+
+	// Slices of the workers on their nodes before measuring
+	if (schedule == BLEND_SCHEDULE_NUMA){
+		numa_report_t report;
+		printf("NUMA nodes: %u\n", ctx.topology.nNodes);
+		if (blendNumaReport(&ctx, &src, &filter, &dst, &report) == 0){
+			printNumaReport("Before placement", &report);
+		}
+		if (blendPlaceImages(&ctx, &src, &filter, &dst) != 0){
+			perror("Placing the images on the NUMA nodes");
+		}
+		else if (blendNumaReport(&ctx, &src, &filter, &dst, &report) == 0){
+			printNumaReport("After placement", &report);
+		}
+	}
+
+	// The coefficients of the filter are computed once, out of the timing
+	blend_prepared_t preparedFilter;
+	if (prepared){
+		if (width != widthFilter || height != heightFilter){
+			printf("--prepared needs a filter of the size of the source.\n");
+			exit(EXIT_FAILURE);
+		}
+		if (blendPrepareFilter(&ctx, &filter, &preparedFilter) != 0){
+			perror("Preparing the filter (only the overlap mode can be prepared)");
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	// Fingerprints of the tiles of the previous pass
+	blend_incremental_t tiles;
+	if (incremental){
+		if (prepared || width != widthFilter || height != heightFilter){
+			printf("--incremental needs a filter of the size of the source, not prepared.\n");
+			exit(EXIT_FAILURE);
+		}
+		if (blendIncrementalCreate(&tiles, width, height, 0, 0) != 0){
+			perror("Allocating the tile fingerprints");
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	// Measuring start time
+	perf_counters_t counters;
+	bool counted = perf && startCounters(&counters, &ctx);
+	buffer_stats_t buffersBefore = bufferPoolStats(ctx.buffers);
+	if(clock_gettime(CLOCK_MONOTONIC, &tStart) == -1){
+		perror("Clock_gettime Error!!");
+		exit(EXIT_FAILURE);
+	}
+
+	// ALGORITHM --> Repeated N times
+	for(uint i = 0; i < REPEAT_ALGORITHM; i++){
+		if (prepared){
+			blendImagePrepared(&ctx, &src, &preparedFilter, &dst);
+		}
+		else if (incremental){
+			blendImageIncremental(&ctx, &tiles, &src, &filter, &dst);
+		}
+		else {
+			blendImage(&ctx, &src, &filter, &dst);
+		}
+	}
+
+	// Measuring end time
+	if(clock_gettime(CLOCK_MONOTONIC, &tEnd) == -1){
+		perror("Clock_gettime Error!!");
+		exit(EXIT_FAILURE);
+	}
+
+	// Calculating elapsed time
+	dElapsedTime = (tEnd.tv_sec - tStart.tv_sec);
+	dElapsedTime += (tEnd.tv_nsec - tStart.tv_nsec) / 1e+9;
+
+	printf("\n");
+	printf("Elapsed time: %.4f", dElapsedTime);
+	printf("\n");
+	printSchedStats(&ctx.schedStats);
+	printBufferStats(&buffersBefore, ctx.buffers);
+	if (incremental){
+		printf("Tiles reused: %.1f%% (%lu blended, %lu reused)\n", 100.0 * blendIncrementalReuse(&tiles),
+				(unsigned long)tiles.tilesBlended, (unsigned long)tiles.tilesReused);
+		blendIncrementalRelease(&tiles);
+	}
+	if (counted){
+		// Source, filter (or its two coefficients) and destination of every pass
+		double filterBytes = prepared ? 2 * sizeof(float) : sizeof(data_t);
+		double bytes = (double)width * height * 3 * (2 * sizeof(data_t) + filterBytes) * REPEAT_ALGORITHM;
+		char engine[64];
+		snprintf(engine, sizeof(engine), "%s/%s%s", ctx.autoTune ? "profile" : SCHEDULE_NAMES[schedule], kernelName(isa),
+				prepared ? "/prepared" : "");
+		reportCounters(&counters, &ctx, engine, dElapsedTime, bytes);
+	}
+
+	if (prepared){
+		blendReleaseFilter(&preparedFilter);
+	}
+
+	// Store destination image in disk
+	dstImage.save(DESTINATION_IMG);
+
+	// Display destination image
+	dstImage.display();
+
+	// Stop the workers and unmap the destination
+	blendDestroy(&ctx);
+
+	return 0;
+}
@@ -0,0 +1,223 @@
+/*
+ * roofline.cpp
+ *
+ *  Created on: Fall 2022
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "roofline.h"
+#include "engine.h"
+
+// Bytes of each buffer of the bandwidth test: far larger than any
+// last-level cache
+const size_t PEAK_BYTES = 128u << 20;
+
+// Passes of the bandwidth test (the best one is kept)
+const uint PEAK_PASSES = 5;
+
+// Bytes of a line brought by a last-level cache miss
+const double CACHE_LINE = 64.0;
+
+// An engine moving this fraction of the peak bandwidth is memory bound
+const double MEMORY_BOUND = 0.7;
+
+// An engine stalled this fraction of its cycles is latency (or front end) bound
+const double STALL_BOUND = 0.4;
+
+// Slice of the copy of one worker
+typedef struct {
+	const uint8_t *src;
+	uint8_t *dst;
+	size_t bytes;
+} copy_args_t;
+
+static void *CopyThread(void *args){
+
+	copy_args_t *params = (copy_args_t *)args;
+
+	memcpy(params->dst, params->src, params->bytes);
+
+	return NULL;
+}
+
+static double elapsedSeconds(struct timespec tStart, struct timespec tEnd){
+	return (tEnd.tv_sec - tStart.tv_sec) + (tEnd.tv_nsec - tStart.tv_nsec) / 1e+9;
+}
+
+double measurePeakBandwidth(worker_pool_t *pool){
+	uint8_t *src = (uint8_t *) malloc(PEAK_BYTES);
+	uint8_t *dst = (uint8_t *) malloc(PEAK_BYTES);
+	copy_args_t params[MAX_THREADS];
+	uint nThreads = (pool != NULL) ? pool->nThreads : 1;
+	size_t slice = PEAK_BYTES / nThreads;
+	struct timespec tStart, tEnd;
+	double best = 0.0;
+
+	if (src == NULL || dst == NULL){
+		free(src);
+		free(dst);
+		return 0.0;
+	}
+
+	// Pages faulted in before measuring
+	memset(src, 1, PEAK_BYTES);
+	memset(dst, 0, PEAK_BYTES);
+
+	for (uint i = 0; i < nThreads; i++){
+		params[i].src = src + i * slice;
+		params[i].dst = dst + i * slice;
+		params[i].bytes = (i == nThreads - 1) ? PEAK_BYTES - i * slice : slice;
+	}
+
+	for (uint pass = 0; pass < PEAK_PASSES; pass++){
+		clock_gettime(CLOCK_MONOTONIC, &tStart);
+		if (pool == NULL){
+			CopyThread(&params[0]);
+		} else {
+			for (uint i = 0; i < nThreads; i++){
+				poolSubmit(pool, CopyThread, &params[i]);
+			}
+			poolWait(pool);
+		}
+		clock_gettime(CLOCK_MONOTONIC, &tEnd);
+
+		double gbPerSecond = 2.0 * PEAK_BYTES / (elapsedSeconds(tStart, tEnd) * 1e+9);
+		best = (gbPerSecond > best) ? gbPerSecond : best;
+	}
+
+	free(src);
+	free(dst);
+	return best;
+}
+
+// value / total, or -1 if one of them is not counted
+static double ratio(const perf_sample_t *counters, perf_event_id_t value, perf_event_id_t total){
+
+	if (!counters->present[value] || !counters->present[total] || counters->value[total] == 0){
+		return -1.0;
+	}
+	return (double)counters->value[value] / counters->value[total];
+}
+
+void rooflineCompute(roofline_t *roofline, const perf_sample_t *counters, double seconds, double bytes,
+		double peakGbPerSecond){
+
+	roofline->counters = *counters;
+	roofline->seconds = seconds;
+	roofline->bytes = bytes;
+	roofline->gbPerSecond = bytes / (seconds * 1e+9);
+	roofline->dramGbPerSecond = counters->present[PERF_LLC_MISSES]
+			? counters->value[PERF_LLC_MISSES] * CACHE_LINE / (seconds * 1e+9) : -1.0;
+	roofline->ipc = ratio(counters, PERF_INSTRUCTIONS, PERF_CYCLES);
+	roofline->instructionsPerByte = counters->present[PERF_INSTRUCTIONS] ? counters->value[PERF_INSTRUCTIONS] / bytes : -1.0;
+	roofline->frontendStalls = ratio(counters, PERF_STALLED_FRONTEND, PERF_CYCLES);
+	roofline->backendStalls = ratio(counters, PERF_STALLED_BACKEND, PERF_CYCLES);
+
+	// The peak counts the bytes read and written, and so do the bytes of
+	// the kernels, while the misses only count the lines read (not the
+	// write-backs nor the streaming stores): the larger of both, so that
+	// an engine moving all its bytes at the peak reaches it
+	double traffic = (roofline->dramGbPerSecond > roofline->gbPerSecond) ? roofline->dramGbPerSecond : roofline->gbPerSecond;
+	roofline->peakFraction = (peakGbPerSecond > 0.0) ? traffic / peakGbPerSecond : -1.0;
+
+	if (roofline->peakFraction > 1.0){
+		// Only the caches go faster than the roof
+		roofline->bound = "cache bandwidth";
+	}
+	else if (roofline->peakFraction >= MEMORY_BOUND){
+		roofline->bound = "memory bandwidth";
+	}
+	else if (roofline->backendStalls >= STALL_BOUND){
+		roofline->bound = "latency (back-end stalls)";
+	}
+	else if (roofline->frontendStalls >= STALL_BOUND){
+		roofline->bound = "front end";
+	}
+	else if (roofline->ipc >= 0.0){
+		roofline->bound = "compute";
+	}
+	else {
+		roofline->bound = "unknown (no cycle counters)";
+	}
+}
+
+// A ratio as a percentage, or "-" when it is not counted
+static void printPercent(FILE *out, double value){
+
+	if (value < 0.0){
+		fprintf(out, " %9s", "-");
+	} else {
+		fprintf(out, " %8.1f%%", 100.0 * value);
+	}
+}
+
+static void printCount(FILE *out, const perf_sample_t *sample, perf_event_id_t event, double scale){
+
+	if (!sample->present[event]){
+		fprintf(out, " %12s", "-");
+	} else {
+		fprintf(out, " %12.3f", sample->value[event] / scale);
+	}
+}
+
+static void printThread(FILE *out, const char *label, const perf_sample_t *sample){
+	double ipc = ratio(sample, PERF_INSTRUCTIONS, PERF_CYCLES);
+
+	fprintf(out, "%6s", label);
+	printCount(out, sample, PERF_TASK_CLOCK, 1e+6);
+	printCount(out, sample, PERF_CYCLES, 1e+6);
+	printCount(out, sample, PERF_INSTRUCTIONS, 1e+6);
+	if (ipc < 0.0){
+		fprintf(out, " %6s", "-");
+	} else {
+		fprintf(out, " %6.2f", ipc);
+	}
+	printCount(out, sample, PERF_LLC_MISSES, 1e+3);
+	printPercent(out, ratio(sample, PERF_STALLED_FRONTEND, PERF_CYCLES));
+	printPercent(out, ratio(sample, PERF_STALLED_BACKEND, PERF_CYCLES));
+	fprintf(out, "\n");
+}
+
+void printPerfThreads(FILE *out, const perf_counters_t *counters){
+	perf_sample_t sample;
+	char label[16];
+
+	fprintf(out, "\nThread    Task (ms)   Cycles (M)    Instr (M)    IPC  LLC miss (K)  FE stall  BE stall\n");
+	for (uint t = 0; t < counters->nThreads; t++){
+		perfRead(counters, t, &sample);
+		// The calling thread only waits in the threaded engines
+		if (t == 0){
+			snprintf(label, sizeof(label), "main");
+		} else {
+			snprintf(label, sizeof(label), "%u", t - 1);
+		}
+		printThread(out, label, &sample);
+	}
+	perfReadTotal(counters, &sample);
+	printThread(out, "total", &sample);
+}
+
+void printRoofline(FILE *out, const char *engine, const roofline_t *roofline){
+
+	fprintf(out, "\nEngine %s: %.3f GB/s of the kernels", engine, roofline->gbPerSecond);
+	if (roofline->dramGbPerSecond >= 0.0){
+		fprintf(out, ", %.3f GB/s from memory", roofline->dramGbPerSecond);
+	}
+	if (roofline->peakFraction >= 0.0){
+		fprintf(out, " (%.0f%% of the peak)", 100.0 * roofline->peakFraction);
+	}
+	fprintf(out, "\n");
+	if (roofline->ipc >= 0.0){
+		fprintf(out, "  IPC %.2f, %.2f instructions per byte\n", roofline->ipc, roofline->instructionsPerByte);
+	}
+	if (roofline->frontendStalls >= 0.0 || roofline->backendStalls >= 0.0){
+		fprintf(out, "  Stalled cycles:");
+		printPercent(out, roofline->frontendStalls);
+		fprintf(out, " front end,");
+		printPercent(out, roofline->backendStalls);
+		fprintf(out, " back end\n");
+	}
+	fprintf(out, "  Bound: %s\n", roofline->bound);
+}
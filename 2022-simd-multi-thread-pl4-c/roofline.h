@@ -0,0 +1,50 @@
+/*
+ * roofline.h
+ *
+ *  Created on: Fall 2022
+ *
+ * What the hardware counters of some passes of an engine say about it
+ * (--perf): instructions per cycle, stalls, the bytes it moves against the
+ * bandwidth of the host, and so which limit it runs into.
+ */
+
+#ifndef ROOFLINE_H_
+#define ROOFLINE_H_
+
+#include <stdio.h>
+#include "perf.h"
+
+// Counters of some passes and what they imply. Ratios of events the host
+// does not count are negative.
+typedef struct {
+	perf_sample_t counters; // Sum of every thread
+	double seconds; // Wall clock of the passes
+	double bytes; // Read and written by the kernels (source, filter and destination)
+	double gbPerSecond; // bytes / seconds
+	double dramGbPerSecond; // Lines missed in the last-level cache / seconds
+	double peakFraction; // Larger of gbPerSecond and dramGbPerSecond / peak bandwidth of the host
+	double ipc;
+	double instructionsPerByte; // Arithmetic intensity, in instructions
+	double frontendStalls; // Fraction of the cycles
+	double backendStalls;
+	const char *bound; // Limit the engine runs into
+} roofline_t;
+
+// Copy bandwidth of the host with every worker of pool (or the calling
+// thread when pool is NULL), in GB/s, read and written bytes counted:
+// the roof of the memory-bound engines. Returns 0 if the buffers cannot
+// be allocated.
+double measurePeakBandwidth(worker_pool_t *pool);
+
+// Derives the ratios and the bound of counters measured over seconds in
+// which bytes were moved. peakGbPerSecond may be 0 (unknown).
+void rooflineCompute(roofline_t *roofline, const perf_sample_t *counters, double seconds, double bytes,
+		double peakGbPerSecond);
+
+// Table of the counters of every thread (thread 0 is the calling one)
+void printPerfThreads(FILE *out, const perf_counters_t *counters);
+
+// Report of one engine
+void printRoofline(FILE *out, const char *engine, const roofline_t *roofline);
+
+#endif /* ROOFLINE_H_ */
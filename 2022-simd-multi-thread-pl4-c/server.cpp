@@ -0,0 +1,519 @@
+/*
+ * server.cpp
+ *
+ *  Created on: Fall 2022
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include "server.h"
+#include "bmp.h"
+
+// Connections served at the same time
+#define MAX_CLIENTS 64
+
+// Filters and shared memory objects kept mapped (the least recently used
+// one is dropped for a new one)
+#define CACHE_ENTRIES 16
+
+// Longest request: three paths and the command
+#define LINE_BYTES (3 * PATH_MAX + 64)
+
+// Jobs kept for the percentiles of stats
+#define LATENCY_WINDOW 4096
+
+// Filter kept between requests
+typedef struct {
+	bool used;
+	char path[PATH_MAX];
+	struct timespec mtime; // Of the file when it was opened
+	off_t size;
+	uint64_t lastUse;
+	bmp_image_t image;
+	data_t *planes; // R, G and B planes, built by the first planar job
+	bool prepared; // coefficients hold the Overlap coefficients of planes
+	blend_prepared_t coefficients;
+} filter_entry_t;
+
+// Mapping of a shared memory object
+typedef struct {
+	bool used;
+	char name[NAME_MAX];
+	uint8_t *map;
+	size_t size;
+	dev_t device; // Object mapped, told apart from a new one of the same name
+	ino_t inode;
+	uint64_t lastUse;
+} shm_entry_t;
+
+// Connection and the part of a request received so far
+typedef struct {
+	int fd;
+	char line[LINE_BYTES];
+	size_t length;
+} client_t;
+
+typedef struct {
+	blend_context_t *ctx;
+	filter_entry_t filters[CACHE_ENTRIES];
+	shm_entry_t shms[CACHE_ENTRIES];
+	uint64_t uses; // Clock of the caches
+	double latencies[LATENCY_WINDOW]; // Microseconds of the last jobs, circular
+	uint64_t jobs;
+	double totalUs;
+	double maxUs;
+	bool stop;
+} server_t;
+
+// Set by SIGINT and SIGTERM
+static volatile sig_atomic_t stopRequested = 0;
+
+static void onStopSignal(int){
+	stopRequested = 1;
+}
+
+static double elapsedUs(struct timespec tStart, struct timespec tEnd){
+	return (tEnd.tv_sec - tStart.tv_sec) * 1e+6 + (tEnd.tv_nsec - tStart.tv_nsec) / 1e+3;
+}
+
+static void dropFilter(server_t *server, filter_entry_t *entry){
+
+	if (entry->prepared){
+		blendReleaseFilter(&entry->coefficients);
+	}
+	blendRelease(server->ctx, entry->planes);
+	bmpClose(&entry->image);
+	entry->used = false;
+}
+
+// Least recently used entry of a cache, or a free one
+template<class Entry> static Entry *victim(Entry *entries){
+	Entry *oldest = &entries[0];
+
+	for (uint i = 0; i < CACHE_ENTRIES; i++){
+		if (!entries[i].used){
+			return &entries[i];
+		}
+		if (entries[i].lastUse < oldest->lastUse){
+			oldest = &entries[i];
+		}
+	}
+	return oldest;
+}
+
+// Mapped filter of path, opened again if the file changed since it was cached
+static filter_entry_t *findFilter(server_t *server, const char *path){
+	struct stat info;
+
+	if (stat(path, &info) != 0){
+		return NULL;
+	}
+
+	filter_entry_t *entry = NULL;
+	for (uint i = 0; i < CACHE_ENTRIES && entry == NULL; i++){
+		if (server->filters[i].used && strcmp(server->filters[i].path, path) == 0){
+			entry = &server->filters[i];
+		}
+	}
+	if (entry != NULL && (entry->size != info.st_size || entry->mtime.tv_sec != info.st_mtim.tv_sec
+			|| entry->mtime.tv_nsec != info.st_mtim.tv_nsec)){
+		dropFilter(server, entry);
+		entry = NULL;
+	}
+
+	if (entry == NULL){
+		entry = victim(server->filters);
+		if (entry->used){
+			dropFilter(server, entry);
+		}
+		if (bmpOpen(&entry->image, path) != 0){
+			return NULL;
+		}
+		snprintf(entry->path, PATH_MAX, "%s", path);
+		entry->mtime = info.st_mtim;
+		entry->size = info.st_size;
+		entry->planes = NULL;
+		entry->prepared = false;
+		entry->used = true;
+	}
+	entry->lastUse = ++server->uses;
+	return entry;
+}
+
+// R, G and B planes of a filter (the file is BGR or BGRA), and the Overlap
+// coefficients when the mode of the context is Overlap
+static int planarFilter(server_t *server, filter_entry_t *entry){
+	const bmp_image_t *image = &entry->image;
+	size_t pixelCount = (size_t)image->width * image->height;
+
+	if (entry->planes != NULL){
+		return 0;
+	}
+	// From the pool of the context: the planes of a replaced filter are
+	// reused by the next one of the same size
+	entry->planes = (data_t *) blendAcquire(server->ctx, 3 * pixelCount * sizeof(data_t));
+	if (entry->planes == NULL){
+		return -1;
+	}
+
+	blend_frame_t frame = bmpFrame(image);
+	for (uint y = 0; y < image->height; y++){
+		const uint8_t *row = frame.data + (ptrdiff_t)y * frame.stride;
+		data_t *r = entry->planes + (size_t)y * image->width;
+
+		for (uint x = 0; x < image->width; x++){
+			r[x] = row[x * image->channels + 2];
+			r[x + pixelCount] = row[x * image->channels + 1];
+			r[x + 2 * pixelCount] = row[x * image->channels];
+		}
+	}
+
+	blend_image_t filter = blendPlanarImage(entry->planes, image->width, image->height);
+	entry->prepared = server->ctx->mode == BLEND_OVERLAP && blendPrepareFilter(server->ctx, &filter, &entry->coefficients) == 0;
+	return 0;
+}
+
+// Mapping of the shared memory object name, of at least size bytes. The
+// object is opened on every job: a name unlinked and created again by the
+// client is another object, mapped again.
+static uint8_t *findShm(server_t *server, const char *name, size_t size){
+	shm_entry_t *entry = NULL;
+	struct stat info;
+
+	int fd = shm_open(name, O_RDWR, 0);
+	if (fd == -1){
+		return NULL;
+	}
+	if (fstat(fd, &info) != 0 || (size_t)info.st_size < size){
+		close(fd);
+		errno = EINVAL;
+		return NULL;
+	}
+
+	for (uint i = 0; i < CACHE_ENTRIES && entry == NULL; i++){
+		if (server->shms[i].used && strcmp(server->shms[i].name, name) == 0){
+			entry = &server->shms[i];
+		}
+	}
+	// Mapped again when the object changed or the job needs more than the
+	// cached mapping
+	if (entry != NULL && (entry->device != info.st_dev || entry->inode != info.st_ino || entry->size < size)){
+		munmap(entry->map, entry->size);
+		entry->used = false;
+	}
+
+	if (entry == NULL || !entry->used){
+		entry = (entry != NULL) ? entry : victim(server->shms);
+		if (entry->used){
+			munmap(entry->map, entry->size);
+			entry->used = false;
+		}
+		entry->map = (uint8_t *) mmap(NULL, info.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		if (entry->map == MAP_FAILED){
+			close(fd);
+			return NULL;
+		}
+		snprintf(entry->name, NAME_MAX, "%s", name);
+		entry->size = info.st_size;
+		entry->device = info.st_dev;
+		entry->inode = info.st_ino;
+		entry->used = true;
+	}
+	close(fd);
+	entry->lastUse = ++server->uses;
+	return entry->map;
+}
+
+static const char *jobBmp(server_t *server, const char *source, const char *filterPath, const char *destination){
+	bmp_image_t srcImage, dstImage;
+
+	filter_entry_t *filter = findFilter(server, filterPath);
+	if (filter == NULL){
+		return "cannot open the filter";
+	}
+	if (bmpOpen(&srcImage, source) != 0){
+		return "cannot open the source";
+	}
+	if (bmpCreate(&dstImage, destination, srcImage.width, srcImage.height, srcImage.channels) != 0){
+		bmpClose(&srcImage);
+		return "cannot create the destination";
+	}
+
+	int status = blendBmp(server->ctx, &srcImage, &filter->image, &dstImage);
+	bmpClose(&dstImage);
+	bmpClose(&srcImage);
+
+	return (status == 0) ? NULL : "the filter does not match the source";
+}
+
+static const char *jobFrame(server_t *server, const char *name, uint width, uint height, uint channels, const char *filterPath){
+	size_t frameBytes = (size_t)width * height * channels;
+
+	if (width == 0 || height == 0 || (channels != 3 && channels != 4)){
+		return "bad frame size";
+	}
+	filter_entry_t *filter = findFilter(server, filterPath);
+	if (filter == NULL){
+		return "cannot open the filter";
+	}
+	uint8_t *map = findShm(server, name, 2 * frameBytes);
+	if (map == NULL){
+		return "cannot map the shared memory (missing or too small)";
+	}
+
+	blend_frame_t src = { map, (ptrdiff_t)width * channels, width, height, channels };
+	blend_frame_t dst = { map + frameBytes, (ptrdiff_t)width * channels, width, height, channels };
+	blend_frame_t filterFrame = bmpFrame(&filter->image);
+
+	return (blendFrame(server->ctx, &src, &filterFrame, &dst) == 0) ? NULL : "the filter does not match the frame";
+}
+
+static const char *jobPlanar(server_t *server, const char *name, uint width, uint height, const char *filterPath){
+	size_t imageBytes = (size_t)width * height * 3 * sizeof(data_t);
+
+	if (width == 0 || height == 0){
+		return "bad image size";
+	}
+	filter_entry_t *filter = findFilter(server, filterPath);
+	if (filter == NULL){
+		return "cannot open the filter";
+	}
+	if (planarFilter(server, filter) != 0){
+		return "out of memory";
+	}
+	uint8_t *map = findShm(server, name, 2 * imageBytes);
+	if (map == NULL){
+		return "cannot map the shared memory (missing or too small)";
+	}
+
+	blend_image_t src = blendPlanarImage((data_t *)map, width, height);
+	blend_image_t dst = blendPlanarImage((data_t *)(map + imageBytes), width, height);
+	blend_image_t filterImage = blendPlanarImage(filter->planes, filter->image.width, filter->image.height);
+	// The coefficients are per pixel: a filter of another size goes through
+	// the sampler of the context
+	bool prepared = filter->prepared && filter->image.width == width && filter->image.height == height;
+	int status = prepared ? blendImagePrepared(server->ctx, &src, &filter->coefficients, &dst)
+			: blendImage(server->ctx, &src, &filterImage, &dst);
+
+	return (status == 0) ? NULL : "the filter does not match the image";
+}
+
+static int compareDouble(const void *a, const void *b){
+	double x = *(const double *)a, y = *(const double *)b;
+	return (x > y) - (x < y);
+}
+
+static void formatStats(const server_t *server, char *reply, size_t size){
+	static double sorted[LATENCY_WINDOW];
+	uint count = (server->jobs < LATENCY_WINDOW) ? server->jobs : LATENCY_WINDOW;
+
+	if (count == 0){
+		snprintf(reply, size, "ok jobs 0\n");
+		return;
+	}
+	memcpy(sorted, server->latencies, count * sizeof(double));
+	qsort(sorted, count, sizeof(double), compareDouble);
+	snprintf(reply, size, "ok jobs %lu mean_us %.1f p50_us %.1f p99_us %.1f max_us %.1f\n",
+			(unsigned long)server->jobs, server->totalUs / server->jobs, sorted[count / 2],
+			sorted[(count * 99 + 99) / 100 - 1], server->maxUs);
+}
+
+// Runs one request line and writes its reply. Returns false when the
+// connection has to be closed.
+static bool handleRequest(server_t *server, char *line, char *reply, size_t size){
+	char command[16], a[PATH_MAX], b[PATH_MAX], c[PATH_MAX];
+	uint width, height, channels;
+	const char *error = NULL;
+	struct timespec tStart, tEnd;
+
+	clock_gettime(CLOCK_MONOTONIC, &tStart);
+	if (sscanf(line, "%15s", command) != 1){
+		snprintf(reply, size, "error empty request\n");
+		return true;
+	}
+
+	if (strcmp(command, "blend") == 0 && sscanf(line, "%*s %4095s %4095s %4095s", a, b, c) == 3){
+		error = jobBmp(server, a, b, c);
+	}
+	else if (strcmp(command, "frame") == 0 && sscanf(line, "%*s %4095s %u %u %u %4095s", a, &width, &height, &channels, b) == 5){
+		error = jobFrame(server, a, width, height, channels, b);
+	}
+	else if (strcmp(command, "planar") == 0 && sscanf(line, "%*s %4095s %u %u %4095s", a, &width, &height, b) == 4){
+		error = jobPlanar(server, a, width, height, b);
+	}
+	else if (strcmp(command, "stats") == 0){
+		formatStats(server, reply, size);
+		return true;
+	}
+	else if (strcmp(command, "quit") == 0){
+		return false;
+	}
+	else if (strcmp(command, "shutdown") == 0){
+		snprintf(reply, size, "ok\n");
+		server->stop = true;
+		return true;
+	}
+	else {
+		snprintf(reply, size, "error unknown or malformed request\n");
+		return true;
+	}
+
+	if (error != NULL){
+		snprintf(reply, size, "error %s\n", error);
+		return true;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &tEnd);
+	double us = elapsedUs(tStart, tEnd);
+	server->latencies[server->jobs % LATENCY_WINDOW] = us;
+	server->jobs++;
+	server->totalUs += us;
+	server->maxUs = (us > server->maxUs) ? us : server->maxUs;
+	snprintf(reply, size, "ok %.1f\n", us);
+	return true;
+}
+
+// Reads what the client sent and serves its complete lines. Returns false
+// when the connection is closed.
+static bool serveClient(server_t *server, client_t *client){
+	char reply[256];
+
+	ssize_t received = read(client->fd, client->line + client->length, LINE_BYTES - 1 - client->length);
+	if (received <= 0){
+		return false;
+	}
+	client->length += received;
+
+	char *newline;
+	while ((newline = (char *) memchr(client->line, '\n', client->length)) != NULL){
+		*newline = '\0';
+		bool open = handleRequest(server, client->line, reply, sizeof(reply));
+		if (!open || send(client->fd, reply, strlen(reply), MSG_NOSIGNAL) < 0){
+			return false;
+		}
+		size_t used = newline + 1 - client->line;
+		memmove(client->line, newline + 1, client->length - used);
+		client->length -= used;
+	}
+
+	// A line that does not fit is not a request
+	return client->length < LINE_BYTES - 1;
+}
+
+static int listenOn(const char *socketPath){
+	struct sockaddr_un address;
+
+	if (strlen(socketPath) >= sizeof(address.sun_path)){
+		errno = ENAMETOOLONG;
+		return -1;
+	}
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd == -1){
+		return -1;
+	}
+
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	strcpy(address.sun_path, socketPath);
+	unlink(socketPath);
+	if (bind(fd, (struct sockaddr *)&address, sizeof(address)) != 0 || listen(fd, MAX_CLIENTS) != 0){
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+int runServer(const char *socketPath, blend_context_t *ctx){
+	static server_t server; // Too large for the stack
+	client_t *clients = (client_t *) malloc(MAX_CLIENTS * sizeof(client_t));
+	struct pollfd fds[1 + MAX_CLIENTS];
+	uint nClients = 0;
+	struct sigaction action;
+
+	if (clients == NULL){
+		perror("Allocating the clients");
+		return -1;
+	}
+	int listener = listenOn(socketPath);
+	if (listener == -1){
+		perror("Listening on the socket");
+		free(clients);
+		return -1;
+	}
+
+	// No SA_RESTART: poll returns on the signal
+	memset(&action, 0, sizeof(action));
+	action.sa_handler = onStopSignal;
+	sigaction(SIGINT, &action, NULL);
+	sigaction(SIGTERM, &action, NULL);
+
+	memset(&server, 0, sizeof(server));
+	server.ctx = ctx;
+	printf("Serving on %s (%u threads)\n", socketPath, ctx->pool.nThreads);
+	fflush(stdout);
+
+	while (!server.stop && !stopRequested){
+		fds[0].fd = listener;
+		fds[0].events = (nClients < MAX_CLIENTS) ? POLLIN : 0;
+		for (uint i = 0; i < nClients; i++){
+			fds[1 + i].fd = clients[i].fd;
+			fds[1 + i].events = POLLIN;
+		}
+		if (poll(fds, 1 + nClients, -1) < 0){
+			if (errno == EINTR){
+				continue;
+			}
+			perror("Waiting for requests");
+			break;
+		}
+
+		// Clients first, so the indices of fds still match
+		for (uint i = nClients; i-- > 0;){
+			if (fds[1 + i].revents == 0){
+				continue;
+			}
+			if (!serveClient(&server, &clients[i])){
+				close(clients[i].fd);
+				clients[i] = clients[--nClients];
+			}
+		}
+		if (fds[0].revents & POLLIN){
+			int fd = accept(listener, NULL, NULL);
+			if (fd >= 0){
+				clients[nClients].fd = fd;
+				clients[nClients].length = 0;
+				nClients++;
+			}
+		}
+	}
+
+	for (uint i = 0; i < nClients; i++){
+		close(clients[i].fd);
+	}
+	for (uint i = 0; i < CACHE_ENTRIES; i++){
+		if (server.filters[i].used){
+			dropFilter(&server, &server.filters[i]);
+		}
+		if (server.shms[i].used){
+			munmap(server.shms[i].map, server.shms[i].size);
+		}
+	}
+	close(listener);
+	unlink(socketPath);
+	free(clients);
+	printf("Served %lu jobs\n", (unsigned long)server.jobs);
+
+	return 0;
+}
@@ -0,0 +1,42 @@
+/*
+ * server.h
+ *
+ *  Created on: Fall 2022
+ *
+ * Blend daemon (--serve=<socket>): one process listens on a Unix domain
+ * socket and blends the jobs of its clients with the workers, kernels and
+ * filters it keeps between requests, so a small request costs its blend
+ * and not the start-up of a program. No CImg and no display.
+ *
+ * Protocol: one request per line, one reply line per request, any number
+ * of requests per connection. Every reply starts with "ok" or "error";
+ * "ok" replies of jobs end with the microseconds the request took.
+ *   blend <source.bmp> <filter.bmp> <destination.bmp>
+ *       Mapped BMP files (see bmp.h); the destination is created.
+ *   frame <shm> <width> <height> <channels> <filter.bmp>
+ *       POSIX shared memory object <shm> (shm_open name) holding the source
+ *       frame and then the destination frame: top-down rows without
+ *       padding, BGR or BGRA (see frame.h).
+ *   planar <shm> <width> <height> <filter.bmp>
+ *       <shm> holds the R, G and B planes of the source and then those of
+ *       the destination, as data_t (see kernels.h). The Overlap coefficients
+ *       of the filter are prepared once (see blendPrepareFilter) and used
+ *       when it has the size of the image; otherwise it is sampled (--filter).
+ *   stats
+ *       Latency of the jobs so far: count, mean, p50, p99 and max (us).
+ *   quit       Closes the connection.
+ *   shutdown   Stops the server.
+ * Filters are mapped once and kept (a changed file is reopened), and so
+ * are the mappings of the shared memory objects.
+ */
+
+#ifndef SERVER_H_
+#define SERVER_H_
+
+#include "blend.h"
+
+// Serves on socketPath (replaced if it exists) until a shutdown request,
+// SIGINT or SIGTERM. Returns 0 on success and -1 on error.
+int runServer(const char *socketPath, blend_context_t *ctx);
+
+#endif /* SERVER_H_ */
@@ -0,0 +1,541 @@
+/*
+ * stream.cpp
+ *
+ *  Created on: Fall 2022
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <mm_malloc.h>
+#include "stream.h"
+#include "bmp.h"
+
+// Frames in flight: one being read, one blended, one written and a spare
+#define RING_FRAMES 4
+
+// Frames kept for the latency percentiles
+#define LATENCY_WINDOW 4096
+
+// Longest line of a Y4M header
+#define Y4M_LINE 256
+
+// Seconds between two progress lines
+const double REPORT_SECONDS = 5.0;
+
+// One buffer of the ring
+typedef struct {
+	uint8_t *rgb; // Frame as blended: top-down RGB rows without padding
+	uint8_t *planes; // Y4M: Y, Cb and Cr planes as read and written
+	struct timespec tRead; // End of the read of the frame
+} stream_slot_t;
+
+typedef struct {
+	stream_format_t format;
+	uint width;
+	uint height;
+	uint chromaWidth; // Y4M
+	uint chromaHeight;
+	size_t rgbBytes;
+	size_t planeBytes; // Y4M: the three planes
+	stream_slot_t slots[RING_FRAMES];
+
+	// Frames read, blended and written so far: slot n % RING_FRAMES holds frame n
+	pthread_mutex_t lock;
+	pthread_cond_t changed;
+	uint64_t nRead;
+	uint64_t nBlended;
+	uint64_t nWritten;
+	bool endOfInput;
+	bool blendDone;
+	bool inputFailed; // The frames read before are still blended and written
+	bool failed;
+	const char *error;
+
+	// Written by the writer thread only
+	double latencies[LATENCY_WINDOW]; // Milliseconds, circular
+	double totalMs;
+	double maxMs;
+	struct timespec tStart;
+	struct timespec tReport;
+	uint64_t nReported;
+} stream_t;
+
+static double elapsedSeconds(struct timespec tStart, struct timespec tEnd){
+	return (tEnd.tv_sec - tStart.tv_sec) + (tEnd.tv_nsec - tStart.tv_nsec) / 1e+9;
+}
+
+// Reads exactly bytes unless the input ends. Returns the bytes read, or -1 on error.
+static ssize_t readFull(int fd, uint8_t *buffer, size_t bytes){
+	size_t done = 0;
+
+	while (done < bytes){
+		ssize_t n = read(fd, buffer + done, bytes - done);
+		if (n == 0){
+			break;
+		}
+		if (n < 0){
+			if (errno == EINTR){
+				continue;
+			}
+			return -1;
+		}
+		done += n;
+	}
+	return done;
+}
+
+static int writeFull(int fd, const uint8_t *buffer, size_t bytes){
+	size_t done = 0;
+
+	while (done < bytes){
+		ssize_t n = write(fd, buffer + done, bytes - done);
+		if (n < 0){
+			if (errno == EINTR){
+				continue;
+			}
+			return -1;
+		}
+		done += n;
+	}
+	return 0;
+}
+
+// Reads a line of a Y4M header without the newline (byte by byte: the frames
+// follow it). Returns its length, or -1 at the end of the input or on error.
+static int readLine(int fd, char *line, size_t size){
+	size_t length = 0;
+	char c;
+
+	for (;;){
+		ssize_t n = read(fd, &c, 1);
+		if (n < 0 && errno == EINTR){
+			continue;
+		}
+		if (n <= 0 || length == size - 1){
+			return -1;
+		}
+		if (c == '\n'){
+			line[length] = '\0';
+			return length;
+		}
+		line[length++] = c;
+	}
+}
+
+// Parses the stream header and copies it to stdout
+static int y4mHeader(stream_t *stream){
+	char line[Y4M_LINE], tokens[Y4M_LINE];
+	bool chroma444 = false;
+
+	int length = readLine(STDIN_FILENO, line, sizeof(line));
+	if (length < 0 || strncmp(line, "YUV4MPEG2 ", 10) != 0){
+		stream->error = "the input is not a YUV4MPEG2 stream";
+		return -1;
+	}
+	strcpy(tokens, line);
+	for (char *token = strtok(tokens + 10, " "); token != NULL; token = strtok(NULL, " ")){
+		if (token[0] == 'W'){
+			stream->width = strtoul(token + 1, NULL, 10);
+		}
+		else if (token[0] == 'H'){
+			stream->height = strtoul(token + 1, NULL, 10);
+		}
+		else if (token[0] == 'C'){
+			// 4:2:0 with any chroma siting, or 4:4:4, 8 bits
+			if (strcmp(token + 1, "444") == 0){
+				chroma444 = true;
+			}
+			else if (strcmp(token + 1, "420") != 0 && strcmp(token + 1, "420jpeg") != 0
+					&& strcmp(token + 1, "420mpeg2") != 0 && strcmp(token + 1, "420paldv") != 0){
+				stream->error = "unsupported Y4M colour space (4:2:0 or 4:4:4, 8 bits)";
+				return -1;
+			}
+		}
+	}
+	if (stream->width == 0 || stream->height == 0){
+		stream->error = "the Y4M header has no size";
+		return -1;
+	}
+	stream->chromaWidth = chroma444 ? stream->width : (stream->width + 1) / 2;
+	stream->chromaHeight = chroma444 ? stream->height : (stream->height + 1) / 2;
+
+	// The output has the same header
+	line[length] = '\n';
+	return writeFull(STDOUT_FILENO, (const uint8_t *)line, length + 1);
+}
+
+static uint8_t clampByte(float value){
+	return (value <= 0.0f) ? 0 : (value >= 255.0f) ? 255 : (uint8_t)(value + 0.5f);
+}
+
+static void yuvToRgb(const stream_t *stream, stream_slot_t *slot){
+	size_t pixelCount = (size_t)stream->width * stream->height;
+	const uint8_t *pY = slot->planes;
+	const uint8_t *pU = pY + pixelCount;
+	const uint8_t *pV = pU + (size_t)stream->chromaWidth * stream->chromaHeight;
+	uint shift = (stream->chromaWidth == stream->width) ? 0 : 1;
+
+	for (uint y = 0; y < stream->height; y++){
+		uint8_t *rgb = slot->rgb + (size_t)y * stream->width * 3;
+		const uint8_t *rowU = pU + (size_t)(y >> shift) * stream->chromaWidth;
+		const uint8_t *rowV = pV + (size_t)(y >> shift) * stream->chromaWidth;
+
+		for (uint x = 0; x < stream->width; x++){
+			float luma = pY[(size_t)y * stream->width + x];
+			float cb = rowU[x >> shift] - 128.0f;
+			float cr = rowV[x >> shift] - 128.0f;
+
+			rgb[3 * x] = clampByte(luma + 1.402f * cr);
+			rgb[3 * x + 1] = clampByte(luma - 0.344136f * cb - 0.714136f * cr);
+			rgb[3 * x + 2] = clampByte(luma + 1.772f * cb);
+		}
+	}
+}
+
+// Chroma of 4:2:0 streams is the mean of the pixels of its block
+static void rgbToYuv(const stream_t *stream, stream_slot_t *slot){
+	size_t pixelCount = (size_t)stream->width * stream->height;
+	uint8_t *pY = slot->planes;
+	uint8_t *pU = pY + pixelCount;
+	uint8_t *pV = pU + (size_t)stream->chromaWidth * stream->chromaHeight;
+	uint shift = (stream->chromaWidth == stream->width) ? 0 : 1;
+
+	for (uint y = 0; y < stream->height; y++){
+		const uint8_t *rgb = slot->rgb + (size_t)y * stream->width * 3;
+
+		for (uint x = 0; x < stream->width; x++){
+			pY[(size_t)y * stream->width + x] = clampByte(0.299f * rgb[3 * x] + 0.587f * rgb[3 * x + 1] + 0.114f * rgb[3 * x + 2]);
+		}
+	}
+
+	for (uint cy = 0; cy < stream->chromaHeight; cy++){
+		for (uint cx = 0; cx < stream->chromaWidth; cx++){
+			float r = 0.0f, g = 0.0f, b = 0.0f;
+			uint count = 0;
+
+			for (uint y = cy << shift; y < ((cy + 1) << shift) && y < stream->height; y++){
+				for (uint x = cx << shift; x < ((cx + 1) << shift) && x < stream->width; x++){
+					const uint8_t *rgb = slot->rgb + ((size_t)y * stream->width + x) * 3;
+					r += rgb[0];
+					g += rgb[1];
+					b += rgb[2];
+					count++;
+				}
+			}
+			r /= count;
+			g /= count;
+			b /= count;
+			pU[(size_t)cy * stream->chromaWidth + cx] = clampByte(128.0f - 0.168736f * r - 0.331264f * g + 0.5f * b);
+			pV[(size_t)cy * stream->chromaWidth + cx] = clampByte(128.0f + 0.5f * r - 0.418688f * g - 0.081312f * b);
+		}
+	}
+}
+
+// Reads the next frame into slot. Returns 1, 0 at the end of the input or -1 on error.
+static int readFrame(stream_t *stream, stream_slot_t *slot){
+	char line[Y4M_LINE];
+
+	if (stream->format == STREAM_RAW){
+		ssize_t n = readFull(STDIN_FILENO, slot->rgb, stream->rgbBytes);
+		if (n == 0){
+			return 0;
+		}
+		if (n != (ssize_t)stream->rgbBytes){
+			stream->error = (n < 0) ? "cannot read the input" : "the last frame is truncated";
+			return -1;
+		}
+		return 1;
+	}
+
+	// Y4M: the parameters of the FRAME line are dropped
+	if (readLine(STDIN_FILENO, line, sizeof(line)) < 0){
+		return 0;
+	}
+	if (strncmp(line, "FRAME", 5) != 0){
+		stream->error = "bad Y4M frame header";
+		return -1;
+	}
+	if (readFull(STDIN_FILENO, slot->planes, stream->planeBytes) != (ssize_t)stream->planeBytes){
+		stream->error = "the last frame is truncated";
+		return -1;
+	}
+	yuvToRgb(stream, slot);
+	return 1;
+}
+
+static int writeFrame(stream_t *stream, stream_slot_t *slot){
+	static const uint8_t FRAME_HEADER[] = "FRAME\n";
+
+	if (stream->format == STREAM_RAW){
+		return writeFull(STDOUT_FILENO, slot->rgb, stream->rgbBytes);
+	}
+	rgbToYuv(stream, slot);
+	if (writeFull(STDOUT_FILENO, FRAME_HEADER, sizeof(FRAME_HEADER) - 1) != 0){
+		return -1;
+	}
+	return writeFull(STDOUT_FILENO, slot->planes, stream->planeBytes);
+}
+
+static void fail(stream_t *stream, const char *error){
+
+	pthread_mutex_lock(&stream->lock);
+	if (!stream->failed){
+		stream->failed = true;
+		stream->error = (error != NULL) ? error : stream->error;
+	}
+	pthread_cond_broadcast(&stream->changed);
+	pthread_mutex_unlock(&stream->lock);
+}
+
+static void *ReaderThread(void *args){
+	stream_t *stream = (stream_t *)args;
+
+	// Only cancelled while it waits for the input (see runStream)
+	pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
+	for (;;){
+		pthread_mutex_lock(&stream->lock);
+		while (stream->nRead - stream->nWritten == RING_FRAMES && !stream->failed){
+			pthread_cond_wait(&stream->changed, &stream->lock);
+		}
+		bool failed = stream->failed;
+		stream_slot_t *slot = &stream->slots[stream->nRead % RING_FRAMES];
+		pthread_mutex_unlock(&stream->lock);
+		if (failed){
+			break;
+		}
+
+		pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, NULL);
+		int status = readFrame(stream, slot);
+		pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
+		clock_gettime(CLOCK_MONOTONIC, &slot->tRead);
+
+		pthread_mutex_lock(&stream->lock);
+		if (status == 1){
+			stream->nRead++;
+		} else {
+			stream->endOfInput = true;
+			stream->inputFailed = status < 0;
+		}
+		pthread_cond_broadcast(&stream->changed);
+		pthread_mutex_unlock(&stream->lock);
+		if (status != 1){
+			break;
+		}
+	}
+	return NULL;
+}
+
+static void recordFrame(stream_t *stream, const stream_slot_t *slot){
+	struct timespec tNow;
+
+	clock_gettime(CLOCK_MONOTONIC, &tNow);
+	double ms = elapsedSeconds(slot->tRead, tNow) * 1e+3;
+	stream->latencies[stream->nWritten % LATENCY_WINDOW] = ms;
+	stream->totalMs += ms;
+	stream->maxMs = (ms > stream->maxMs) ? ms : stream->maxMs;
+
+	double interval = elapsedSeconds(stream->tReport, tNow);
+	if (interval >= REPORT_SECONDS){
+		fprintf(stderr, "%lu frames, %.1f fps\n", (unsigned long)(stream->nWritten + 1),
+				(stream->nWritten + 1 - stream->nReported) / interval);
+		stream->tReport = tNow;
+		stream->nReported = stream->nWritten + 1;
+	}
+}
+
+static void *WriterThread(void *args){
+	stream_t *stream = (stream_t *)args;
+
+	for (;;){
+		pthread_mutex_lock(&stream->lock);
+		while (stream->nWritten == stream->nBlended && !stream->blendDone && !stream->failed){
+			pthread_cond_wait(&stream->changed, &stream->lock);
+		}
+		bool done = stream->failed || stream->nWritten == stream->nBlended;
+		stream_slot_t *slot = &stream->slots[stream->nWritten % RING_FRAMES];
+		pthread_mutex_unlock(&stream->lock);
+		if (done){
+			break;
+		}
+
+		if (writeFrame(stream, slot) != 0){
+			fail(stream, "cannot write the output");
+			break;
+		}
+		recordFrame(stream, slot);
+
+		pthread_mutex_lock(&stream->lock);
+		stream->nWritten++;
+		pthread_cond_broadcast(&stream->changed);
+		pthread_mutex_unlock(&stream->lock);
+	}
+	return NULL;
+}
+
+// The filter as a top-down RGB frame, like the frames of the stream
+static uint8_t *loadFilter(const stream_t *stream, const char *filterPath){
+	bmp_image_t image;
+
+	if (bmpOpen(&image, filterPath) != 0){
+		return NULL;
+	}
+	if (image.width != stream->width || image.height != stream->height){
+		bmpClose(&image);
+		errno = EINVAL;
+		return NULL;
+	}
+	uint8_t *rgb = (uint8_t *) _mm_malloc(stream->rgbBytes, 64);
+	if (rgb == NULL){
+		bmpClose(&image);
+		return NULL;
+	}
+
+	blend_frame_t frame = bmpFrame(&image);
+	for (uint y = 0; y < image.height; y++){
+		const uint8_t *bgr = frame.data + (ptrdiff_t)y * frame.stride;
+		uint8_t *row = rgb + (size_t)y * image.width * 3;
+
+		for (uint x = 0; x < image.width; x++){
+			row[3 * x] = bgr[x * image.channels + 2];
+			row[3 * x + 1] = bgr[x * image.channels + 1];
+			row[3 * x + 2] = bgr[x * image.channels];
+		}
+	}
+	bmpClose(&image);
+	return rgb;
+}
+
+static int compareDouble(const void *a, const void *b){
+	double x = *(const double *)a, y = *(const double *)b;
+	return (x > y) - (x < y);
+}
+
+static void printReport(const stream_t *stream){
+	static double sorted[LATENCY_WINDOW];
+	struct timespec tEnd;
+	uint count = (stream->nWritten < LATENCY_WINDOW) ? stream->nWritten : LATENCY_WINDOW;
+
+	clock_gettime(CLOCK_MONOTONIC, &tEnd);
+	double seconds = elapsedSeconds(stream->tStart, tEnd);
+	fprintf(stderr, "Streamed %lu frames of %ux%u in %.3f s: %.1f fps\n", (unsigned long)stream->nWritten,
+			stream->width, stream->height, seconds, stream->nWritten / seconds);
+	if (count == 0){
+		return;
+	}
+	memcpy(sorted, stream->latencies, count * sizeof(double));
+	qsort(sorted, count, sizeof(double), compareDouble);
+	fprintf(stderr, "Frame latency (ms): mean %.3f, p50 %.3f, p99 %.3f, max %.3f\n", stream->totalMs / stream->nWritten,
+			sorted[count / 2], sorted[(count * 99 + 99) / 100 - 1], stream->maxMs);
+}
+
+int runStream(blend_context_t *ctx, stream_format_t format, uint width, uint height, const char *filterPath){
+	static stream_t stream; // Too large for the stack
+	pthread_t reader, writer;
+	uint8_t *filterRgb = NULL;
+	int status = -1;
+
+	memset(&stream, 0, sizeof(stream));
+	stream.format = format;
+	stream.width = width;
+	stream.height = height;
+	pthread_mutex_init(&stream.lock, NULL);
+	pthread_cond_init(&stream.changed, NULL);
+
+	// A closed output is an error of write, not a signal
+	signal(SIGPIPE, SIG_IGN);
+
+	if (format == STREAM_Y4M && y4mHeader(&stream) != 0){
+		fprintf(stderr, "ERROR: %s\n", (stream.error != NULL) ? stream.error : strerror(errno));
+		return -1;
+	}
+	stream.rgbBytes = (size_t)stream.width * stream.height * 3;
+	stream.planeBytes = (size_t)stream.width * stream.height + 2 * (size_t)stream.chromaWidth * stream.chromaHeight;
+
+	filterRgb = loadFilter(&stream, filterPath);
+	if (filterRgb == NULL){
+		fprintf(stderr, "ERROR: the filter %s cannot be opened or is not %ux%u\n", filterPath, stream.width, stream.height);
+		return -1;
+	}
+	for (uint i = 0; i < RING_FRAMES; i++){
+		stream.slots[i].rgb = (uint8_t *) _mm_malloc(stream.rgbBytes, 64);
+		stream.slots[i].planes = (format == STREAM_Y4M) ? (uint8_t *) _mm_malloc(stream.planeBytes, 64) : NULL;
+		if (stream.slots[i].rgb == NULL || (format == STREAM_Y4M && stream.slots[i].planes == NULL)){
+			fprintf(stderr, "ERROR: cannot allocate the frames\n");
+			goto release;
+		}
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &stream.tStart);
+	stream.tReport = stream.tStart;
+	if (pthread_create(&reader, NULL, ReaderThread, &stream) != 0){
+		fprintf(stderr, "ERROR creating the reader thread\n");
+		goto release;
+	}
+	if (pthread_create(&writer, NULL, WriterThread, &stream) != 0){
+		fprintf(stderr, "ERROR creating the writer thread\n");
+		fail(&stream, NULL);
+		pthread_cancel(reader);
+		pthread_join(reader, NULL);
+		goto release;
+	}
+
+	{
+		blend_frame_t filter = { filterRgb, (ptrdiff_t)stream.width * 3, stream.width, stream.height, 3 };
+
+		for (;;){
+			pthread_mutex_lock(&stream.lock);
+			while (stream.nBlended == stream.nRead && !stream.endOfInput && !stream.failed){
+				pthread_cond_wait(&stream.changed, &stream.lock);
+			}
+			bool done = stream.failed || stream.nBlended == stream.nRead;
+			stream_slot_t *slot = &stream.slots[stream.nBlended % RING_FRAMES];
+			pthread_mutex_unlock(&stream.lock);
+			if (done){
+				break;
+			}
+
+			// In place: the slot is written as blended
+			blend_frame_t frame = { slot->rgb, (ptrdiff_t)stream.width * 3, stream.width, stream.height, 3 };
+			blendFrame(ctx, &frame, &filter, &frame);
+
+			pthread_mutex_lock(&stream.lock);
+			stream.nBlended++;
+			pthread_cond_broadcast(&stream.changed);
+			pthread_mutex_unlock(&stream.lock);
+		}
+	}
+
+	pthread_mutex_lock(&stream.lock);
+	stream.blendDone = true;
+	pthread_cond_broadcast(&stream.changed);
+	pthread_mutex_unlock(&stream.lock);
+	pthread_join(writer, NULL);
+	// The reader may be blocked on an input that never ends
+	if (stream.failed){
+		pthread_cancel(reader);
+	}
+	pthread_join(reader, NULL);
+
+	printReport(&stream);
+	if (stream.failed || stream.inputFailed){
+		fprintf(stderr, "ERROR: %s\n", stream.error);
+	} else {
+		status = 0;
+	}
+
+release:
+	for (uint i = 0; i < RING_FRAMES; i++){
+		_mm_free(stream.slots[i].rgb);
+		_mm_free(stream.slots[i].planes);
+	}
+	_mm_free(filterRgb);
+	pthread_mutex_destroy(&stream.lock);
+	pthread_cond_destroy(&stream.changed);
+	return status;
+}
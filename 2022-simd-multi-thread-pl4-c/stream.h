@@ -0,0 +1,35 @@
+/*
+ * stream.h
+ *
+ *  Created on: Fall 2022
+ *
+ * Streaming mode (--stream=<raw:WxH|y4m>): frames are read from stdin,
+ * blended with a filter kept in memory and written to stdout, e.g. to put
+ * a background on a video feed between two ffmpeg processes. A reader
+ * thread, the blend (on the workers) and a writer thread work on different
+ * frames of a ring of a few reused aligned buffers, so the memory does not
+ * grow with the length of the stream.
+ *   raw  Frames of width * height RGB24 pixels, top-down, without padding.
+ *   y4m  YUV4MPEG2 with 4:2:0 (the default) or 4:4:4 chroma. Frames are
+ *        converted to RGB (BT.601, full range) for the blend and back.
+ * The sustained frames per second and the latency of the frames (from the
+ * end of their read to the end of their write) are printed on stderr.
+ */
+
+#ifndef STREAM_H_
+#define STREAM_H_
+
+#include "blend.h"
+
+typedef enum {
+	STREAM_RAW,
+	STREAM_Y4M
+} stream_format_t;
+
+// Blends every frame of stdin with the BMP file filterPath, which must be
+// the size of the frames. width and height are those of raw frames (Y4M
+// streams give theirs in the header). Returns 0 at the end of the input
+// and -1 on error (reported on stderr).
+int runStream(blend_context_t *ctx, stream_format_t format, uint width, uint height, const char *filterPath);
+
+#endif /* STREAM_H_ */
@@ -0,0 +1,351 @@
+/*
+ * validate.cpp
+ *
+ *  Created on: Fall 2022
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "validate.h"
+#include "bmp.h"
+#include "incremental.h"
+
+// Every pair of components: the source varies fastest
+const uint PAIR_COUNT = 256 * 256;
+
+// Error of a kernel against the reference
+typedef struct {
+	double maxAbs;
+	uint64_t maxUlp;
+	uint mismatches;
+} kernel_error_t;
+
+#ifndef UINT8_PIPELINE
+
+// Bits of a float as an integer that grows with the float, so that the
+// distance between two of them counts the floats in between
+static int64_t orderedBits(float f){
+	int32_t bits;
+
+	memcpy(&bits, &f, sizeof(bits));
+	return (bits < 0) ? (int64_t)INT32_MIN - bits : bits;
+}
+
+#endif
+
+static void addError(kernel_error_t *error, double abs, uint64_t ulp){
+
+	if (ulp == 0){
+		return;
+	}
+	error->mismatches++;
+	error->maxAbs = (abs > error->maxAbs) ? abs : error->maxAbs;
+	error->maxUlp = (ulp > error->maxUlp) ? ulp : error->maxUlp;
+}
+
+static void compareItems(const data_t *out, const data_t *ref, kernel_error_t *error){
+
+	memset(error, 0, sizeof(*error));
+	for (uint i = 0; i < PAIR_COUNT; i++){
+	#ifndef UINT8_PIPELINE
+		int64_t ulp = orderedBits(out[i]) - orderedBits(ref[i]);
+		addError(error, (out[i] > ref[i]) ? out[i] - ref[i] : ref[i] - out[i], (ulp < 0) ? -ulp : ulp);
+	#else
+		int diff = (int)out[i] - ref[i];
+		addError(error, abs(diff), abs(diff));
+	#endif
+	}
+}
+
+static void compareBytes(const uint8_t *out, const uint8_t *ref, kernel_error_t *error){
+
+	memset(error, 0, sizeof(*error));
+	for (uint i = 0; i < PAIR_COUNT; i++){
+		int diff = (int)out[i] - ref[i];
+		addError(error, abs(diff), abs(diff));
+	}
+}
+
+static void printError(const char *kernel, kernel_precision_t precision, const char *data, const kernel_error_t *error){
+	printf("%-8s %-8s %-6s %14.6g %10lu %10u (%.3f%%)\n", kernel, precisionName(precision), data,
+			error->maxAbs, (unsigned long)error->maxUlp, error->mismatches, 100.0 * error->mismatches / PAIR_COUNT);
+}
+
+// Changes of a tile that keep its stripes, only moved: the fingerprint
+// must see each of them
+typedef enum {
+	CHANGE_ROWS, // Two rows of a plane swapped
+	CHANGE_PLANES, // R and G swapped
+	CHANGE_IMAGES, // A row of the source swapped with the same row of the filter
+	CHANGE_SHIFT, // A 64-byte object moved by its size over a flat row
+	CHANGE_COUNT
+} tile_change_t;
+
+static const char *CHANGE_NAMES[CHANGE_COUNT] = { "swapped rows", "swapped planes", "source/filter rows", "shifted object" };
+
+// Two tiles of the default size, one above the other
+const uint CHECK_WIDTH = DEFAULT_INCREMENTAL_WIDTH;
+const uint CHECK_HEIGHT = 2 * DEFAULT_INCREMENTAL_HEIGHT;
+
+static void swapComponents(data_t *a, data_t *b, uint count){
+
+	for (uint i = 0; i < count; i++){
+		data_t t = a[i];
+		a[i] = b[i];
+		b[i] = t;
+	}
+}
+
+// Changes the first tile of src (and filter) as change says
+static void changeTile(tile_change_t change, data_t *src, data_t *filter){
+	uint planeCount = CHECK_WIDTH * CHECK_HEIGHT;
+	uint object = 64 / sizeof(data_t);
+
+	switch (change){
+	case CHANGE_ROWS:
+		swapComponents(src, src + CHECK_WIDTH, CHECK_WIDTH);
+		break;
+	case CHANGE_PLANES:
+		for (uint y = 0; y < DEFAULT_INCREMENTAL_HEIGHT; y++){
+			swapComponents(src + y * CHECK_WIDTH, src + planeCount + y * CHECK_WIDTH, CHECK_WIDTH);
+		}
+		break;
+	case CHANGE_IMAGES:
+		swapComponents(src, filter, CHECK_WIDTH);
+		break;
+	default:
+		swapComponents(src, src + object, object);
+		break;
+	}
+}
+
+// Incremental blends of every kernel after each change of tile_change_t:
+// the changed tile must be blended again, and only it. Returns the
+// changes missed.
+static uint checkIncremental(){
+	size_t count = (size_t)CHECK_WIDTH * CHECK_HEIGHT * 3;
+	data_t *items = (data_t *) malloc(4 * count * sizeof(data_t));
+	blend_context_t ctx;
+	uint missed = 0;
+
+	if (items == NULL || blendCreate(&ctx, 1) != 0){
+		perror("Creating the incremental check");
+		free(items);
+		return 1;
+	}
+	blendSetAutoTune(&ctx, false);
+	data_t *src = items, *filter = items + count, *dst = items + 2 * count, *ref = items + 3 * count;
+	blend_image_t srcImage = blendPlanarImage(src, CHECK_WIDTH, CHECK_HEIGHT);
+	blend_image_t filterImage = blendPlanarImage(filter, CHECK_WIDTH, CHECK_HEIGHT);
+	blend_image_t dstImage = blendPlanarImage(dst, CHECK_WIDTH, CHECK_HEIGHT);
+	blend_image_t refImage = blendPlanarImage(ref, CHECK_WIDTH, CHECK_HEIGHT);
+
+	printf("\nIncremental blend after changes that only move stripes of a tile\n");
+	for (int k = 0; k < KERNEL_COUNT; k++){
+		kernel_isa_t isa = (kernel_isa_t)k;
+		if (blendSetKernel(&ctx, isa) != 0){
+			continue;
+		}
+		for (int c = 0; c < CHANGE_COUNT; c++){
+			tile_change_t change = (tile_change_t)c;
+			blend_incremental_t state;
+
+			srand(c);
+			for (size_t i = 0; i < count; i++){
+				src[i] = rand() % 256;
+				filter[i] = rand() % 256;
+			}
+			if (change == CHANGE_SHIFT){
+				// Flat row with the object at its start
+				for (uint x = 64 / sizeof(data_t); x < CHECK_WIDTH; x++){
+					src[x] = 128;
+				}
+			}
+			if (blendIncrementalCreate(&state, CHECK_WIDTH, CHECK_HEIGHT, 0, 0) != 0){
+				perror("Allocating the tile fingerprints");
+				missed++;
+				continue;
+			}
+			blendImageIncremental(&ctx, &state, &srcImage, &filterImage, &dstImage);
+			uint64_t blended = state.tilesBlended;
+			changeTile(change, src, filter);
+			blendImageIncremental(&ctx, &state, &srcImage, &filterImage, &dstImage);
+			blendImage(&ctx, &srcImage, &filterImage, &refImage);
+
+			bool ok = state.tilesBlended - blended == 1 && memcmp(dst, ref, count * sizeof(data_t)) == 0;
+			printf("%-8s %-20s %s\n", kernelName(isa), CHANGE_NAMES[change], ok ? "blended again" : "STALE");
+			missed += ok ? 0 : 1;
+			blendIncrementalRelease(&state);
+		}
+	}
+
+	blendDestroy(&ctx);
+	free(items);
+	return missed;
+}
+
+// Temporary file for a check, closed (bmpCreate opens it again)
+static bool tempPath(char *path){
+	int fd;
+
+	strcpy(path, "/tmp/blend-check-XXXXXX");
+	fd = mkstemp(path);
+	if (fd == -1){
+		return false;
+	}
+	close(fd);
+	return true;
+}
+
+// A top-down file copied to a bottom-up one (the destination of --roi
+// before its rectangles are blended) must keep every row in its place.
+// Returns 0 when the copy reads back the same image.
+static int checkTopDownCopy(){
+	const uint width = 5, height = 4;
+	char srcPath[32], dstPath[32];
+	bmp_image_t file, src, dst;
+	int status = -1;
+
+	if (!tempPath(srcPath) || !tempPath(dstPath)){
+		perror("Creating the BMP check files");
+		return -1;
+	}
+
+	// Rows numbered in the order they are stored, then the height made
+	// negative: the file becomes top-down
+	if (bmpCreate(&file, srcPath, width, height, 3) == 0){
+		int32_t topDown = -(int32_t)height;
+		for (uint r = 0; r < height; r++){
+			for (uint i = 0; i < width * 3; i++){
+				file.pixels[r * file.rowBytes + i] = 16 * r + i;
+			}
+		}
+		memcpy(file.map + 22, &topDown, sizeof(topDown));
+		bmpClose(&file);
+
+		if (bmpOpen(&src, srcPath) == 0){
+			if (!src.bottomUp && bmpCreate(&dst, dstPath, width, height, 3) == 0){
+				blend_frame_t srcFrame = bmpFrame(&src);
+				blend_frame_t dstFrame = bmpFrame(&dst);
+				blendFrameCopy(&srcFrame, &dstFrame);
+				bmpClose(&dst);
+
+				if (bmpOpen(&dst, dstPath) == 0){
+					dstFrame = bmpFrame(&dst);
+					status = 0;
+					for (uint y = 0; y < height; y++){
+						if (memcmp(srcFrame.data + y * srcFrame.stride, dstFrame.data + y * dstFrame.stride, width * 3) != 0){
+							status = -1;
+						}
+					}
+					bmpClose(&dst);
+				}
+			}
+			bmpClose(&src);
+		}
+	}
+	unlink(srcPath);
+	unlink(dstPath);
+
+	printf("\nTop-down BMP copied to a bottom-up one: %s\n", (status == 0) ? "same image" : "FLIPPED");
+	return status;
+}
+
+// Components per call of the prepared kernels: not a multiple of any
+// packet, so every call also runs the scalar tail
+#define PREPARED_RUN 37
+
+// Overlap with the prepared filter of every kernel against the scalar
+// prepared kernel, which all of them must match. Returns the kernels
+// with mismatches.
+static uint checkPrepared(const data_t *src, const data_t *filter, data_t *ref, data_t *out){
+	float *coefficients = (float *) malloc(2 * PAIR_COUNT * sizeof(float));
+	kernel_error_t error;
+	uint failed = 0;
+
+	if (coefficients == NULL){
+		perror("Allocating the prepared filter");
+		return 1;
+	}
+	float *a = coefficients, *b = coefficients + PAIR_COUNT;
+	overlapPrepare(filter, a, b, PAIR_COUNT);
+	preparedKernelFunction(KERNEL_SCALAR)(src, a, b, ref, PAIR_COUNT);
+
+	printf("\nOverlap with a prepared filter against the scalar prepared kernel\n");
+	for (int k = 0; k < KERNEL_COUNT; k++){
+		kernel_isa_t isa = (kernel_isa_t)k;
+		if (!kernelSupported(isa)){
+			continue;
+		}
+		prepared_kernel_t prepared = preparedKernelFunction(isa);
+		for (uint i = 0; i < PAIR_COUNT; i += PREPARED_RUN){
+			uint count = (PAIR_COUNT - i < PREPARED_RUN) ? PAIR_COUNT - i : PREPARED_RUN;
+			prepared(src + i, a + i, b + i, out + i, count);
+		}
+		compareItems(out, ref, &error);
+		printError(kernelName(isa), PRECISION_EXACT, "prep", &error);
+		failed += (error.mismatches > 0) ? 1 : 0;
+	}
+
+	free(coefficients);
+	return failed;
+}
+
+int runValidation(blend_mode_t mode){
+	data_t *items = (data_t *) malloc(4 * PAIR_COUNT * sizeof(data_t));
+	uint8_t *bytes = (uint8_t *) malloc(4 * PAIR_COUNT);
+	kernel_error_t error;
+
+	if (items == NULL || bytes == NULL){
+		perror("Allocating the validation inputs");
+		free(items);
+		free(bytes);
+		return -1;
+	}
+
+	// Source, filter, reference and output of each type
+	data_t *src = items, *filter = items + PAIR_COUNT, *ref = items + 2 * PAIR_COUNT, *out = items + 3 * PAIR_COUNT;
+	uint8_t *srcBytes = bytes, *filterBytes = bytes + PAIR_COUNT, *refBytes = bytes + 2 * PAIR_COUNT, *outBytes = bytes + 3 * PAIR_COUNT;
+
+	for (uint i = 0; i < PAIR_COUNT; i++){
+		src[i] = srcBytes[i] = i % 256;
+		filter[i] = filterBytes[i] = i / 256;
+	}
+
+	// The reference is the exact scalar kernel
+	const kernel_set_t *exact = kernelSet(KERNEL_SCALAR, PRECISION_EXACT);
+	exact->plane[mode](src, filter, ref, PAIR_COUNT);
+	exact->bytes[mode](srcBytes, filterBytes, refBytes, PAIR_COUNT);
+
+	printf("Mode %s against the exact scalar kernel, %u input pairs\n", modeName(mode), PAIR_COUNT);
+	printf("Kernel   Precision Data   Max abs error    Max ULP Mismatches\n");
+	for (int k = 0; k < KERNEL_COUNT; k++){
+		kernel_isa_t isa = (kernel_isa_t)k;
+		if (!kernelSupported(isa)){
+			continue;
+		}
+		for (int p = 0; p < PRECISION_COUNT; p++){
+			kernel_precision_t precision = (kernel_precision_t)p;
+			const kernel_set_t *set = kernelSet(isa, precision);
+
+			set->plane[mode](src, filter, out, PAIR_COUNT);
+			compareItems(out, ref, &error);
+			printError(kernelName(isa), precision, (sizeof(data_t) == 1) ? "uint8" : "float", &error);
+
+			// Same as the data_t kernels in the 8-bit pipeline
+			if (sizeof(data_t) != 1){
+				set->bytes[mode](srcBytes, filterBytes, outBytes, PAIR_COUNT);
+				compareBytes(outBytes, refBytes, &error);
+				printError(kernelName(isa), precision, "bytes", &error);
+			}
+		}
+	}
+
+	uint failed = checkPrepared(src, filter, ref, out);
+	free(items);
+	free(bytes);
+	uint missed = checkIncremental();
+	return (checkTopDownCopy() == 0 && failed == 0 && missed == 0) ? 0 : -1;
+}
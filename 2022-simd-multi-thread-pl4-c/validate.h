@@ -0,0 +1,27 @@
+/*
+ * validate.h
+ *
+ *  Created on: Fall 2022
+ */
+
+#ifndef VALIDATE_H_
+#define VALIDATE_H_
+
+#include "kernels.h"
+
+// Error of every kernel supported by the host, exact and approximate,
+// against the exact scalar kernel of mode over all the 256 x 256 pairs of
+// source and filter components (--validate): the largest absolute error,
+// the largest error in ULPs (units of the last place of a float, or of
+// the byte) and the number of outputs that differ. Both the kernels of
+// data_t and the 8-bit ones (BMP files and frames) are checked. The
+// prepared Overlap kernels must store the values of the scalar one, tails
+// included (see blendImagePrepared). Then the
+// incremental blend of every kernel is checked to blend again a tile whose
+// rows, planes or stripes were only moved (see incremental.h), and a
+// top-down BMP copied to a bottom-up one (as --roi does) is checked to
+// keep its rows in place. Returns 0 on success and -1 on error or if a
+// check fails.
+int runValidation(blend_mode_t mode);
+
+#endif /* VALIDATE_H_ */
@@ -60,68 +60,50 @@ const __m256 V0  = _mm256_set1_ps(0.0f);
 const __m256 V255 = _mm256_set1_ps(255.0f);
 const __m256 V2 = _mm256_set1_ps(2.0f);
 
-void blendColor(int pixelCount, int nPackets, data_t *c, data_t *srcColor, data_t* filterColor, data_t* destColor) {
-	__m256 vSource, vFilter, va, vb;
-
-	for (int i = 0; i < nPackets; i++) {
-        vSource = _mm256_loadu_ps((srcColor + ITEMS_PER_PACKET * i));
-        vFilter = _mm256_loadu_ps((filterColor + ITEMS_PER_PACKET * i));
-        va = _mm256_sub_ps(V255, vFilter);
-        vb = _mm256_mul_ps(V2, vSource);
-        vb = _mm256_div_ps(vb, V255);
-        vb = _mm256_mul_ps(vb, va);
-        vb = _mm256_add_ps(vFilter, vb);
-        va = _mm256_div_ps(vFilter, V255);
-		va = _mm256_mul_ps(va, vb);
-
-		#ifdef CHECK_COLOR_SATURATION
-		va = _mm256_min_ps(va, V255); // Clamp value to assure that we do not have color saturation
-		va = _mm256_max_ps(va, V0);
-		#endif
-        
-		*(__m256 *)(c + ITEMS_PER_PACKET * i) = va;
-    }
-	// We want to differentiate the last iteration if we have excess data
-	if (((pixelCount * sizeof(data_t))%sizeof(__m256)) != 0) { // Check if we have excess data smaller than a packet
-		*(__m256 *)(c + ITEMS_PER_PACKET * nPackets) = _mm256_set1_ps(-1);
-        int dataInExcess = (pixelCount)%(sizeof(__m256)/sizeof(data_t));
-		vSource = _mm256_loadu_ps((srcColor + nPackets*ITEMS_PER_PACKET - (ITEMS_PER_PACKET- dataInExcess)));
-        vFilter = _mm256_loadu_ps((filterColor + nPackets*ITEMS_PER_PACKET - (ITEMS_PER_PACKET- dataInExcess)));
-        va = _mm256_sub_ps(V255, vFilter);
-        vb = _mm256_mul_ps(V2, vSource);
-        vb = _mm256_div_ps(vb, V255);
-        vb = _mm256_mul_ps(vb, va);
-        vb = _mm256_add_ps(vFilter, vb);
-        va = _mm256_div_ps(vFilter, V255);
-		va = _mm256_mul_ps(va, vb);
-
-		#ifdef CHECK_COLOR_SATURATION
-		va = _mm256_min_ps(va, V255); // Clamp value to assure that we do not have color saturation
-		va = _mm256_max_ps(va, V0);
-		#endif
-
-		__m256i vi;
-    	vi = _mm256_set1_epi64x(-1);
-    	_mm256_maskstore_ps((data_t *)(c + nPackets*ITEMS_PER_PACKET - (ITEMS_PER_PACKET- dataInExcess)),vi, va); 
-	}
-    memcpy(destColor, c, pixelCount * sizeof(data_t)); // Copy the memory from c to the color channel of the final image
+// Overlap of one packet: (Y / 255) * (Y + ((2 * X) / 255) * (255 - Y))
+static inline __m256 blendPacket(__m256 vSource, __m256 vFilter) {
+	__m256 va, vb;
+
+	va = _mm256_sub_ps(V255, vFilter);
+	vb = _mm256_mul_ps(V2, vSource);
+	vb = _mm256_div_ps(vb, V255);
+	vb = _mm256_mul_ps(vb, va);
+	vb = _mm256_add_ps(vFilter, vb);
+	va = _mm256_div_ps(vFilter, V255);
+	va = _mm256_mul_ps(va, vb);
+
+	#ifdef CHECK_COLOR_SATURATION
+	va = _mm256_min_ps(va, V255); // Clamp value to assure that we do not have color saturation
+	va = _mm256_max_ps(va, V0);
+	#endif
+
+	return va;
 }
 
+// The three channels are blended in the same sweep and the result is stored
+// straight into the destination planes (no intermediate buffer, no memcpy)
 void filter (filter_args_t args0, filter_Image args1) {
 	// Calculate the number of packets
-    int nPackets = (args0.pixelCount * sizeof(data_t)/sizeof(__m256));
-	data_t *c;
-
-	if (((args0.pixelCount * sizeof(data_t))%sizeof(__m256)) != 0)
-		c = (data_t *)_mm_malloc(sizeof(__m256) * (nPackets+1), sizeof(__m256));
-	else
-		c = (data_t *)_mm_malloc(sizeof(__m256) * nPackets, sizeof(__m256));
-	
-	blendColor(args0.pixelCount, nPackets, c, args0.pRsrc, args1.pRfilter, args0.pRdst);
-	blendColor(args0.pixelCount, nPackets, c, args0.pGsrc, args1.pGfilter, args0.pGdst);
-	blendColor(args0.pixelCount, nPackets, c, args0.pBsrc, args1.pBfilter, args0.pBdst);
+	uint nPackets = args0.pixelCount / ITEMS_PER_PACKET;
+	uint i;
+
+	for (uint p = 0; p < nPackets; p++) {
+		i = p * ITEMS_PER_PACKET;
+		_mm256_storeu_ps(args0.pRdst + i, blendPacket(_mm256_loadu_ps(args0.pRsrc + i), _mm256_loadu_ps(args1.pRfilter + i)));
+		_mm256_storeu_ps(args0.pGdst + i, blendPacket(_mm256_loadu_ps(args0.pGsrc + i), _mm256_loadu_ps(args1.pGfilter + i)));
+		_mm256_storeu_ps(args0.pBdst + i, blendPacket(_mm256_loadu_ps(args0.pBsrc + i), _mm256_loadu_ps(args1.pBfilter + i)));
+	}
 
-    _mm_free(c); // Free the memory that was being used by c
+	// We want to differentiate the last iteration if we have excess data
+	i = nPackets * ITEMS_PER_PACKET;
+	if (i < args0.pixelCount) { // Check if we have excess data smaller than a packet
+		// Only the lanes holding the excess data are loaded and stored
+		__m256i vMask = _mm256_castps_si256(_mm256_cmp_ps(_mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_ps(args0.pixelCount - i), _CMP_LT_OQ));
+
+		_mm256_maskstore_ps(args0.pRdst + i, vMask, blendPacket(_mm256_maskload_ps(args0.pRsrc + i, vMask), _mm256_maskload_ps(args1.pRfilter + i, vMask)));
+		_mm256_maskstore_ps(args0.pGdst + i, vMask, blendPacket(_mm256_maskload_ps(args0.pGsrc + i, vMask), _mm256_maskload_ps(args1.pGfilter + i, vMask)));
+		_mm256_maskstore_ps(args0.pBdst + i, vMask, blendPacket(_mm256_maskload_ps(args0.pBsrc + i, vMask), _mm256_maskload_ps(args1.pBfilter + i, vMask)));
+	}
 }
 
 int main() {
@@ -0,0 +1,533 @@
+/*
+ * blend.cpp
+ *
+ *  Created on: Fall 2022
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "blend.h"
+#include "engine.h"
+
+// Rows [rowInit, rowEnd) of a strided image for one worker
+typedef struct {
+	const blend_image_t *src;
+	const blend_image_t *filter;
+	const blend_image_t *dst;
+	blend_kernel_t kernel;
+	uint rowInit;
+	uint rowEnd;
+	const filter_sampler_t *sampler; // NULL when the filter has the size of src
+	plane_kernel_t planeKernel; // With sampler
+	data_t *scratch; // Three rows of the scaled filter, one per plane
+	const blend_prepared_t *prepared; // Instead of filter
+	prepared_kernel_t preparedKernel; // With prepared
+} rows_args_t;
+
+blend_image_t blendPlanarImage(data_t *data, uint width, uint height){
+	blend_image_t image;
+	size_t pixelCount = (size_t)width * height;
+
+	image.width = width;
+	image.height = height;
+	image.r.data = data;
+	image.g.data = data + pixelCount;
+	image.b.data = data + 2 * pixelCount;
+	image.r.stride = image.g.stride = image.b.stride = width;
+
+	return image;
+}
+
+// True when every row follows the previous one, so the image can be
+// blended as a single run of width * height pixels
+static bool isContiguous(const blend_image_t *image){
+	return image->r.stride == image->width && image->g.stride == image->width && image->b.stride == image->width;
+}
+
+// Kernel arguments for row y of the three images
+static void rowArgs(const blend_image_t *src, const blend_image_t *filter, const blend_image_t *dst, uint y,
+		filter_args_t *args0, filter_image *args1){
+
+	args0->pRsrc = src->r.data + y * src->r.stride;
+	args0->pGsrc = src->g.data + y * src->g.stride;
+	args0->pBsrc = src->b.data + y * src->b.stride;
+	args0->pRdst = dst->r.data + y * dst->r.stride;
+	args0->pGdst = dst->g.data + y * dst->g.stride;
+	args0->pBdst = dst->b.data + y * dst->b.stride;
+	args0->pixelCount = src->width;
+	args1->pRfilter = filter->r.data + y * filter->r.stride;
+	args1->pGfilter = filter->g.data + y * filter->g.stride;
+	args1->pBfilter = filter->b.data + y * filter->b.stride;
+	args1->filterPixelCount = filter->width;
+}
+
+static void blendRows(const blend_image_t *src, const blend_image_t *filter, const blend_image_t *dst,
+		blend_kernel_t kernel, uint rowInit, uint rowEnd){
+	filter_args_t args0;
+	filter_image args1;
+
+	for (uint y = rowInit; y < rowEnd; y++){
+		rowArgs(src, filter, dst, y, &args0, &args1);
+		kernel(args0, args1, 0, src->width);
+	}
+}
+
+// Rows of src blended with a filter of another size, read through the sampler
+static void blendRowsSampled(const rows_args_t *params){
+	const filter_sampler_t *sampler = params->sampler;
+	const blend_plane_t *srcPlanes[] = { &params->src->r, &params->src->g, &params->src->b };
+	const blend_plane_t *filterPlanes[] = { &params->filter->r, &params->filter->g, &params->filter->b };
+	const blend_plane_t *dstPlanes[] = { &params->dst->r, &params->dst->g, &params->dst->b };
+	uint width = params->src->width;
+	sampler_row_t last = { 0, 0, -1.0f }; // Rows in the scratch rows
+
+	for (uint y = params->rowInit; y < params->rowEnd; y++){
+		sampler_row_t rows = samplerRow(sampler, y);
+		bool filled = rows.row0 == last.row0 && rows.row1 == last.row1 && rows.weight == last.weight;
+
+		for (uint p = 0; p < 3; p++){
+			const data_t *src = srcPlanes[p]->data + y * srcPlanes[p]->stride;
+			data_t *dst = dstPlanes[p]->data + y * dstPlanes[p]->stride;
+
+			if (sampler->mode == BLEND_FILTER_WRAP){
+				// The filter row is read in place, once per repetition
+				const data_t *filter = filterPlanes[p]->data + rows.row0 * filterPlanes[p]->stride;
+				for (uint x = 0; x < width; x += sampler->filterWidth){
+					uint count = (width - x < sampler->filterWidth) ? width - x : sampler->filterWidth;
+					params->planeKernel(src + x, filter, dst + x, count);
+				}
+			} else {
+				data_t *filter = params->scratch + p * width;
+				if (!filled){
+					samplerFill(sampler, rows, filterPlanes[p]->data, filterPlanes[p]->stride, filter);
+				}
+				params->planeKernel(src, filter, dst, width);
+			}
+		}
+		last = rows;
+	}
+}
+
+// Rows of src blended with a prepared filter. Contiguous rows are one run
+static void blendRowsPrepared(const rows_args_t *params){
+	const blend_prepared_t *prepared = params->prepared;
+	const blend_plane_t *srcPlanes[] = { &params->src->r, &params->src->g, &params->src->b };
+	const blend_plane_t *dstPlanes[] = { &params->dst->r, &params->dst->g, &params->dst->b };
+	bool contiguous = isContiguous(params->src) && isContiguous(params->dst);
+	uint width = params->src->width;
+	uint count = contiguous ? (params->rowEnd - params->rowInit) * width : width;
+
+	for (uint y = params->rowInit; y < params->rowEnd; y = contiguous ? params->rowEnd : y + 1){
+		for (uint p = 0; p < 3; p++){
+			size_t offset = (size_t)y * width;
+			params->preparedKernel(srcPlanes[p]->data + y * srcPlanes[p]->stride, prepared->a[p] + offset,
+					prepared->b[p] + offset, dstPlanes[p]->data + y * dstPlanes[p]->stride, count);
+		}
+	}
+}
+
+static void *RowsThread(void *args){
+
+	rows_args_t *params = (rows_args_t *)args;
+
+	if (params->prepared != NULL){
+		blendRowsPrepared(params);
+	} else if (params->sampler != NULL){
+		blendRowsSampled(params);
+	} else {
+		blendRows(params->src, params->filter, params->dst, params->kernel, params->rowInit, params->rowEnd);
+	}
+
+	return NULL;
+}
+
+// Bands of whole rows of proto->src, one per worker of pool (or all of
+// them on the calling thread when pool is NULL). Every band gets its own
+// scratch rows.
+static void runBands(worker_pool_t *pool, const rows_args_t *proto){
+	rows_args_t params[MAX_THREADS];
+	uint nThreads = (pool != NULL) ? pool->nThreads : 1;
+	uint height = proto->src->height;
+	uint band = height / nThreads;
+	uint extra = height % nThreads;
+	uint row = 0;
+
+	for (uint i = 0; i < nThreads; i++){
+		params[i] = *proto;
+		params[i].rowInit = row;
+		row += band + ((i < extra) ? 1 : 0);
+		params[i].rowEnd = row;
+		if (proto->scratch != NULL){
+			params[i].scratch = proto->scratch + (size_t)i * 3 * proto->src->width;
+		}
+		if (pool == NULL){
+			RowsThread(&params[i]);
+		} else {
+			poolSubmit(pool, RowsThread, &params[i]);
+		}
+	}
+	if (pool != NULL){
+		poolWait(pool);
+	}
+}
+
+// Filter of another size than src and dst: rows in bands, the filter read
+// through the sampler of the filter mode of the context
+static int blendSampled(const blend_context_t *ctx, worker_pool_t *pool,
+		const blend_image_t *src, const blend_image_t *filter, const blend_image_t *dst){
+	filter_sampler_t sampler;
+	rows_args_t proto;
+
+	if (src->width != dst->width || src->height != dst->height || ctx->filterMode == BLEND_FILTER_EXACT){
+		errno = EINVAL;
+		return -1;
+	}
+	if (samplerCreate(&sampler, ctx->filterMode, src->width, src->height, filter->width, filter->height, ctx->buffers) != 0){
+		return -1;
+	}
+
+	proto.src = src;
+	proto.filter = filter;
+	proto.dst = dst;
+	proto.kernel = NULL;
+	proto.sampler = &sampler;
+	proto.planeKernel = ctx->planeKernel;
+	proto.scratch = NULL;
+	proto.prepared = NULL;
+
+	// Scaled modes: three rows per band
+	if (ctx->filterMode != BLEND_FILTER_WRAP){
+		uint nThreads = (pool != NULL) ? pool->nThreads : 1;
+		proto.scratch = (data_t *) bufferAcquire(ctx->buffers, (size_t)nThreads * 3 * src->width * sizeof(data_t));
+		if (proto.scratch == NULL){
+			samplerDestroy(&sampler);
+			return -1;
+		}
+	}
+
+	runBands(pool, &proto);
+
+	bufferRelease(ctx->buffers, proto.scratch);
+	samplerDestroy(&sampler);
+	return 0;
+}
+
+// Size of the last-level cache (or a common value when the system does not report it)
+static size_t lastLevelCache(){
+	long bytes = sysconf(_SC_LEVEL3_CACHE_SIZE);
+
+	if (bytes <= 0){
+		bytes = sysconf(_SC_LEVEL2_CACHE_SIZE);
+	}
+	return (bytes > 0) ? bytes : 8 * 1024 * 1024;
+}
+
+// Kernel for a destination of the size of image
+static blend_kernel_t storeKernel(const blend_context_t *ctx, const blend_image_t *image){
+	size_t bytes = (size_t)image->width * image->height * 3 * sizeof(data_t);
+
+	if (ctx->stores == BLEND_STORES_STREAM || (ctx->stores == BLEND_STORES_AUTO && bytes > ctx->cacheBytes)){
+		return ctx->streamKernel;
+	}
+	return ctx->kernel;
+}
+
+// Kernels of the instruction set, the precision and the mode of the context
+static void selectKernels(blend_context_t *ctx){
+	const kernel_set_t *set = kernelSet(ctx->isa, ctx->precision);
+
+	ctx->kernel = set->range[ctx->mode];
+	ctx->streamKernel = set->stream[ctx->mode];
+	ctx->planeKernel = set->plane[ctx->mode];
+	ctx->byteKernel = set->bytes[ctx->mode];
+	ctx->rgbaKernel = set->rgba[ctx->mode];
+	ctx->hashKernel = set->hash;
+	ctx->boxKernel = set->box;
+}
+
+static bool sameSize(const blend_image_t *src, const blend_image_t *filter, const blend_image_t *dst){
+	return src->width == filter->width && src->height == filter->height
+			&& src->width == dst->width && src->height == dst->height;
+}
+
+// Contiguous image run as the profile says for its size
+static void blendTuned(blend_context_t *ctx, filter_args_t args0, filter_image args1){
+	const tune_bucket_t *bucket = profileLookup(&ctx->profile, args0.pixelCount);
+	size_t bytes = (size_t)args0.pixelCount * 3 * sizeof(data_t);
+	bool stream = ctx->stores == BLEND_STORES_STREAM || (ctx->stores == BLEND_STORES_AUTO && bytes > ctx->cacheBytes);
+	const kernel_set_t *set = kernelSet(bucket->isa, ctx->precision);
+	blend_kernel_t kernel = stream ? set->stream[ctx->mode] : set->range[ctx->mode];
+
+	if (bucket->engine == TUNE_SERIAL){
+		filterSlice(kernel, args0, args1, 0, args0.pixelCount, bucket->tilePixels);
+	} else if (bucket->engine == TUNE_STEALING){
+		filterProcessStealing(&ctx->pool, kernel, args0, args1, bucket->tilePixels, &ctx->schedStats);
+	} else {
+		filterProcessTiled(&ctx->pool, kernel, args0, args1, bucket->tilePixels);
+	}
+}
+
+int blendCreate(blend_context_t *ctx, uint nThreads){
+
+	ctx->autoTune = (profileLoad(&ctx->profile, NULL) == 0);
+	if (!ctx->autoTune){
+		ctx->profile.nBuckets = 0;
+	}
+	if (nThreads == 0 && ctx->autoTune){
+		nThreads = ctx->profile.threads;
+	}
+	if (nThreads == 0){
+		long nProcessors = sysconf(_SC_NPROCESSORS_ONLN);
+		nThreads = (nProcessors < 1) ? 1 : ((nProcessors > MAX_THREADS) ? MAX_THREADS : nProcessors);
+	}
+	if (nThreads > MAX_THREADS){
+		nThreads = MAX_THREADS;
+	}
+
+	ctx->isa = kernelBest();
+	ctx->mode = BLEND_OVERLAP;
+	ctx->precision = PRECISION_EXACT;
+	selectKernels(ctx);
+	ctx->tilePixels = 0;
+	ctx->stores = BLEND_STORES_AUTO;
+	ctx->cacheBytes = lastLevelCache();
+	ctx->schedule = BLEND_SCHEDULE_STATIC;
+	schedStatsReset(&ctx->schedStats);
+	numaTopology(&ctx->topology);
+	ctx->filterMode = BLEND_FILTER_EXACT;
+
+	ctx->buffers = (buffer_pool_t *) malloc(sizeof(buffer_pool_t));
+	if (ctx->buffers == NULL){
+		return -1;
+	}
+	if (bufferPoolCreate(ctx->buffers) != 0){
+		free(ctx->buffers);
+		return -1;
+	}
+	if (poolCreate(&ctx->pool, nThreads, nThreads) != 0){
+		bufferPoolDestroy(ctx->buffers);
+		free(ctx->buffers);
+		return -1;
+	}
+	return 0;
+}
+
+void blendSetAutoTune(blend_context_t *ctx, bool enabled){
+	ctx->autoTune = enabled && ctx->profile.nBuckets > 0;
+}
+
+int blendSetKernel(blend_context_t *ctx, kernel_isa_t isa){
+
+	if (!kernelSupported(isa)){
+		return -1;
+	}
+	ctx->isa = isa;
+	selectKernels(ctx);
+
+	return 0;
+}
+
+void blendSetMode(blend_context_t *ctx, blend_mode_t mode){
+	ctx->mode = mode;
+	selectKernels(ctx);
+}
+
+void blendSetPrecision(blend_context_t *ctx, kernel_precision_t precision){
+	ctx->precision = precision;
+	selectKernels(ctx);
+}
+
+void blendSetTiling(blend_context_t *ctx, uint tilePixels, blend_stores_t stores){
+	ctx->tilePixels = tilePixels;
+	ctx->stores = stores;
+}
+
+int blendSetSchedule(blend_context_t *ctx, blend_schedule_t schedule){
+
+	if (schedule == BLEND_SCHEDULE_NUMA && numaPinPool(&ctx->pool, &ctx->topology) != 0){
+		return -1;
+	}
+	ctx->schedule = schedule;
+	schedStatsReset(&ctx->schedStats);
+
+	return 0;
+}
+
+// Arguments of the whole run of three contiguous images
+static bool contiguousArgs(const blend_image_t *src, const blend_image_t *filter, const blend_image_t *dst,
+		filter_args_t *args0, filter_image *args1){
+
+	if (!sameSize(src, filter, dst) || !isContiguous(src) || !isContiguous(filter) || !isContiguous(dst)){
+		errno = EINVAL;
+		return false;
+	}
+	rowArgs(src, filter, dst, 0, args0, args1);
+	args0->pixelCount = args1->filterPixelCount = src->width * src->height;
+
+	return true;
+}
+
+int blendPlaceImages(blend_context_t *ctx, const blend_image_t *src, const blend_image_t *filter, const blend_image_t *dst){
+	filter_args_t args0;
+	filter_image args1;
+
+	if (ctx->schedule != BLEND_SCHEDULE_NUMA){
+		errno = EINVAL;
+		return -1;
+	}
+	if (!contiguousArgs(src, filter, dst, &args0, &args1)){
+		return -1;
+	}
+	return filterPlaceNuma(&ctx->pool, args0, args1, &ctx->topology);
+}
+
+int blendNumaReport(blend_context_t *ctx, const blend_image_t *src, const blend_image_t *filter, const blend_image_t *dst,
+		numa_report_t *report){
+	filter_args_t args0;
+	filter_image args1;
+
+	if (!contiguousArgs(src, filter, dst, &args0, &args1)){
+		return -1;
+	}
+	numaReportReset(report, ctx->topology.nNodes);
+	filterReportNuma(&ctx->pool, args0, args1, &ctx->topology, report);
+
+	return 0;
+}
+
+void blendSetFilterMode(blend_context_t *ctx, blend_filter_mode_t mode){
+	ctx->filterMode = mode;
+}
+
+int blendImage(blend_context_t *ctx, const blend_image_t *src, const blend_image_t *filter, const blend_image_t *dst){
+
+	if (!sameSize(src, filter, dst)){
+		return blendSampled(ctx, &ctx->pool, src, filter, dst);
+	}
+
+	// Contiguous planes: one run of pixels, split by the engine in cache lines
+	if (isContiguous(src) && isContiguous(filter) && isContiguous(dst)){
+		filter_args_t args0;
+		filter_image args1;
+
+		rowArgs(src, filter, dst, 0, &args0, &args1);
+		args0.pixelCount = args1.filterPixelCount = src->width * src->height;
+		if (ctx->autoTune){
+			blendTuned(ctx, args0, args1);
+		} else if (ctx->schedule == BLEND_SCHEDULE_STEALING){
+			uint chunkPixels = (ctx->tilePixels > 0) ? ctx->tilePixels : DEFAULT_TILE_PIXELS;
+			filterProcessStealing(&ctx->pool, storeKernel(ctx, dst), args0, args1, chunkPixels, &ctx->schedStats);
+		} else if (ctx->schedule == BLEND_SCHEDULE_NUMA){
+			filterProcessNuma(&ctx->pool, storeKernel(ctx, dst), args0, args1, ctx->tilePixels, &ctx->topology);
+		} else {
+			filterProcessTiled(&ctx->pool, storeKernel(ctx, dst), args0, args1, ctx->tilePixels);
+		}
+		return 0;
+	}
+
+	// Padded rows: every worker gets a band of whole rows
+	rows_args_t proto;
+
+	proto.src = src;
+	proto.filter = filter;
+	proto.dst = dst;
+	proto.kernel = storeKernel(ctx, dst);
+	proto.sampler = NULL;
+	proto.planeKernel = NULL;
+	proto.scratch = NULL;
+	proto.prepared = NULL;
+	runBands(&ctx->pool, &proto);
+
+	return 0;
+}
+
+int blendImageSerial(const blend_context_t *ctx, const blend_image_t *src, const blend_image_t *filter, const blend_image_t *dst){
+
+	if (!sameSize(src, filter, dst)){
+		return blendSampled(ctx, NULL, src, filter, dst);
+	}
+
+	if (isContiguous(src) && isContiguous(filter) && isContiguous(dst)){
+		filter_args_t args0;
+		filter_image args1;
+
+		rowArgs(src, filter, dst, 0, &args0, &args1);
+		args0.pixelCount = args1.filterPixelCount = src->width * src->height;
+		filterSlice(storeKernel(ctx, dst), args0, args1, 0, args0.pixelCount, ctx->tilePixels);
+		return 0;
+	}
+
+	blendRows(src, filter, dst, storeKernel(ctx, dst), 0, src->height);
+
+	return 0;
+}
+
+int blendPrepareFilter(const blend_context_t *ctx, const blend_image_t *filter, blend_prepared_t *prepared){
+	const blend_plane_t *planes[] = { &filter->r, &filter->g, &filter->b };
+	size_t pixelCount = (size_t)filter->width * filter->height;
+
+	if (ctx->mode != BLEND_OVERLAP){
+		errno = EINVAL;
+		return -1;
+	}
+
+	prepared->width = filter->width;
+	prepared->height = filter->height;
+	prepared->coefficients = (float *) malloc(6 * pixelCount * sizeof(float));
+	if (prepared->coefficients == NULL){
+		return -1;
+	}
+
+	for (uint p = 0; p < 3; p++){
+		float *a = prepared->coefficients + p * pixelCount;
+		float *b = prepared->coefficients + (3 + p) * pixelCount;
+		for (uint y = 0; y < filter->height; y++){
+			overlapPrepare(planes[p]->data + y * planes[p]->stride, a + (size_t)y * filter->width, b + (size_t)y * filter->width, filter->width);
+		}
+		prepared->a[p] = a;
+		prepared->b[p] = b;
+	}
+	return 0;
+}
+
+int blendImagePrepared(blend_context_t *ctx, const blend_image_t *src, const blend_prepared_t *filter, const blend_image_t *dst){
+	rows_args_t proto;
+
+	if (src->width != filter->width || src->height != filter->height || src->width != dst->width || src->height != dst->height){
+		errno = EINVAL;
+		return -1;
+	}
+
+	proto.src = src;
+	proto.filter = NULL;
+	proto.dst = dst;
+	proto.kernel = NULL;
+	proto.sampler = NULL;
+	proto.planeKernel = NULL;
+	proto.scratch = NULL;
+	proto.prepared = filter;
+	proto.preparedKernel = preparedKernelFunction(ctx->isa);
+	runBands(&ctx->pool, &proto);
+
+	return 0;
+}
+
+void blendReleaseFilter(blend_prepared_t *prepared){
+	free(prepared->coefficients);
+	prepared->coefficients = NULL;
+}
+
+void *blendAcquire(const blend_context_t *ctx, size_t bytes){
+	return bufferAcquire(ctx->buffers, bytes);
+}
+
+void blendRelease(const blend_context_t *ctx, void *data){
+	bufferRelease(ctx->buffers, data);
+}
+
+void blendDestroy(blend_context_t *ctx){
+	poolDestroy(&ctx->pool);
+	bufferPoolDestroy(ctx->buffers);
+	free(ctx->buffers);
+}
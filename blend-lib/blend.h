@@ -0,0 +1,187 @@
+/*
+ * blend.h
+ *
+ *  Created on: Fall 2022
+ *
+ * Public interface of the blend library (libblend.a). The images are
+ * borrowed: the library reads and writes the caller's buffers in place
+ * and never allocates, copies or frees pixel data (a filter of another
+ * size only takes one scratch row per worker, from the buffer pool of the
+ * context, see buffer_pool.h). Build the library and the program with the
+ * same UINT8_PIPELINE setting (see kernels.h).
+ */
+
+#ifndef BLEND_H_
+#define BLEND_H_
+
+#include <stddef.h>
+#include "buffer_pool.h"
+#include "engine.h"
+#include "profile.h"
+#include "sampler.h"
+
+// One colour plane of a borrowed image
+typedef struct {
+	data_t *data; // Component of the top-left pixel
+	size_t stride; // Components from the start of a row to the start of the next one (>= width)
+} blend_plane_t;
+
+// Borrowed RGB image: three planes of width x height components
+typedef struct {
+	blend_plane_t r;
+	blend_plane_t g;
+	blend_plane_t b;
+	uint width;
+	uint height;
+} blend_image_t;
+
+// Filter prepared for Overlap: the coefficients a and b of every component
+// (see overlapPrepare in kernels.h), 8 bytes per component
+typedef struct {
+	uint width;
+	uint height;
+	float *coefficients; // The six planes below, in one allocation
+	const float *a[3]; // R, G and B planes, without padding
+	const float *b[3];
+} blend_prepared_t;
+
+// How the destination is written
+typedef enum {
+	BLEND_STORES_AUTO, // Streaming when the destination does not fit in the last-level cache
+	BLEND_STORES_CACHED, // Regular stores
+	BLEND_STORES_STREAM // Non-temporal stores, which bypass the caches
+} blend_stores_t;
+
+// How the pixels of a contiguous image are split between the workers
+typedef enum {
+	BLEND_SCHEDULE_STATIC, // One slice per worker, fixed before the blend
+	BLEND_SCHEDULE_STEALING, // Chunks taken on demand, idle workers steal from busy ones
+	BLEND_SCHEDULE_NUMA // Workers pinned to cores, slices blended on the node of their pages
+} blend_schedule_t;
+
+// Workers and kernel shared by all the blends of a program
+typedef struct {
+	worker_pool_t pool;
+	kernel_isa_t isa;
+	blend_mode_t mode;
+	kernel_precision_t precision;
+	blend_kernel_t kernel; // Kernel of isa for mode, with precision
+	blend_kernel_t streamKernel; // Same instruction set, with streaming stores
+	plane_kernel_t planeKernel; // Same instruction set, for rows of a filter of another size
+	byte_kernel_t byteKernel; // Same instruction set, for 8-bit frames (see frame.h)
+	rgba_kernel_t rgbaKernel; // Same, for 8-bit frames with alpha
+	hash_kernel_t hashKernel; // Same, for the fingerprints of incremental.h
+	box_kernel_t boxKernel; // Same, for the box averages of preview.h
+	uint tilePixels; // Tile of the tiled execution, 0 when disabled
+	blend_stores_t stores;
+	size_t cacheBytes; // Last-level cache of the host
+	blend_schedule_t schedule;
+	sched_stats_t schedStats; // Added by every blend with BLEND_SCHEDULE_STEALING
+	numa_topology_t topology; // Read by BLEND_SCHEDULE_NUMA
+	blend_filter_mode_t filterMode; // For filters of another size than the source
+	blend_profile_t profile; // Tuning of the host (see profile.h)
+	bool autoTune; // Kernel, engine and tile taken from profile
+	buffer_pool_t *buffers; // Scratch of the passes and buffers of the caller (a pointer: serial blends take a const context)
+} blend_context_t;
+
+// View of a planar buffer without padding: the R plane, then G, then B
+// (the layout used by CImg)
+blend_image_t blendPlanarImage(data_t *data, uint width, uint height);
+
+// Starts nThreads workers and selects the widest kernel supported by the
+// host and the Overlap mode. If the tuning profile of the host can be read
+// (see profile.h), nThreads = 0 means the workers of the profile and every
+// contiguous blend takes the kernel, engine and tile of its size bucket;
+// otherwise 0 means one worker per processor. Returns 0 on success and -1
+// on error.
+int blendCreate(blend_context_t *ctx, uint nThreads);
+
+// Enables or disables the tuning profile (only when one was loaded). The
+// kernel, tiling and schedule set by hand are used while it is disabled.
+void blendSetAutoTune(blend_context_t *ctx, bool enabled);
+
+// Forces a kernel. Returns -1 if the host does not support it.
+int blendSetKernel(blend_context_t *ctx, kernel_isa_t isa);
+
+// Selects the blend mode of the next blends (the kernels are looked up
+// here, never per pixel)
+void blendSetMode(blend_context_t *ctx, blend_mode_t mode);
+
+// Selects exact (the default) or approximate kernels for the next blends.
+// PRECISION_APPROX trades exactness for speed (see --validate for its
+// error). Prepared filters ignore it: every kernel stores the values of
+// the scalar one.
+void blendSetPrecision(blend_context_t *ctx, kernel_precision_t precision);
+
+// Tiled execution: every worker blends its pixels in tiles of tilePixels
+// pixels, all the planes of a tile before the next one (0 disables it;
+// DEFAULT_TILE_PIXELS in engine.h fits in L2). stores selects how the
+// destination is written. By default the execution is not tiled and the
+// stores are BLEND_STORES_AUTO.
+void blendSetTiling(blend_context_t *ctx, uint tilePixels, blend_stores_t stores);
+
+// Selects the scheduler of the next blends (BLEND_SCHEDULE_STATIC by
+// default) and clears ctx->schedStats. The chunks of the stealing scheduler
+// are the tiles of blendSetTiling, DEFAULT_TILE_PIXELS when it is disabled.
+// BLEND_SCHEDULE_NUMA pins every worker to a core, grouped by node; the
+// workers stay pinned afterwards. Images with padded rows are always split
+// in bands of rows. Returns 0 on success and -1 if the workers cannot be
+// pinned (errno set).
+int blendSetSchedule(blend_context_t *ctx, blend_schedule_t schedule);
+
+// With BLEND_SCHEDULE_NUMA: moves the slice of every worker of the three
+// images to the node of the worker (pages never touched are first touched
+// by it). Call it once the buffers are allocated, before the blends.
+// Returns 0 on success and -1 if the images are padded, the schedule is
+// another one or the kernel cannot move the pages (errno set).
+int blendPlaceImages(blend_context_t *ctx, const blend_image_t *src, const blend_image_t *filter, const blend_image_t *dst);
+
+// Pages of the three images on the node of the worker that blends them
+// (local) or on another one (remote), as split by BLEND_SCHEDULE_NUMA.
+// Returns -1 if the images are padded.
+int blendNumaReport(blend_context_t *ctx, const blend_image_t *src, const blend_image_t *filter, const blend_image_t *dst,
+		numa_report_t *report);
+
+// How a filter of another size than the source is read (see sampler.h).
+// BLEND_FILTER_EXACT by default: the sizes must match.
+void blendSetFilterMode(blend_context_t *ctx, blend_filter_mode_t mode);
+
+// dst = Overlap(src, filter), split between the workers of the context.
+// src and dst must have the same size; filter too, unless the filter mode
+// of the context is not BLEND_FILTER_EXACT. dst may be src (in place).
+// Returns 0 on success and -1 if the sizes do not match or the scratch
+// rows cannot be allocated (errno set).
+int blendImage(blend_context_t *ctx, const blend_image_t *src, const blend_image_t *filter, const blend_image_t *dst);
+
+// Same as blendImage but on the calling thread, for callers that already
+// run one image per thread (it must not be called from a job of ctx->pool
+// expecting the pool to help)
+int blendImageSerial(const blend_context_t *ctx, const blend_image_t *src, const blend_image_t *filter, const blend_image_t *dst);
+
+// Computes the Overlap coefficients of a filter once, for filters applied
+// to many sources. The coefficients live until blendReleaseFilter; the
+// filter image itself is no longer needed. Returns 0 on success and -1
+// if the mode of the context is not BLEND_OVERLAP or there is no memory
+// (errno set).
+int blendPrepareFilter(const blend_context_t *ctx, const blend_image_t *filter, blend_prepared_t *prepared);
+
+// Same as blendImage with a prepared filter: one multiply-add per
+// component. src and dst must have the size of the filter. Returns 0 on
+// success and -1 if the sizes do not match (errno is EINVAL).
+int blendImagePrepared(blend_context_t *ctx, const blend_image_t *src, const blend_prepared_t *filter, const blend_image_t *dst);
+
+// Frees the coefficients
+void blendReleaseFilter(blend_prepared_t *prepared);
+
+// Buffer of at least bytes from the pool of the context, 64-byte aligned
+// and on huge pages, kept mapped for the next call once released (see
+// buffer_pool.h). Returns NULL if there is no memory.
+void *blendAcquire(const blend_context_t *ctx, size_t bytes);
+
+// Gives back a buffer of blendAcquire
+void blendRelease(const blend_context_t *ctx, void *data);
+
+// Stops the workers and unmaps the buffers of the pool
+void blendDestroy(blend_context_t *ctx);
+
+#endif /* BLEND_H_ */
@@ -0,0 +1,211 @@
+/*
+ * bmp.cpp
+ *
+ *  Created on: Fall 2022
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "bmp.h"
+
+// Sizes of BITMAPFILEHEADER and BITMAPINFOHEADER
+#define BMP_FILE_HEADER 14
+#define BMP_INFO_HEADER 40
+
+// Values of the compression field
+#define BMP_RGB 0
+#define BMP_BITFIELDS 3
+
+// The fields of the headers are little endian and not aligned
+static uint32_t readU32(const uint8_t *p){
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint16_t readU16(const uint8_t *p){
+	return p[0] | (p[1] << 8);
+}
+
+static void writeU32(uint8_t *p, uint32_t value){
+	p[0] = value;
+	p[1] = value >> 8;
+	p[2] = value >> 16;
+	p[3] = value >> 24;
+}
+
+static void writeU16(uint8_t *p, uint16_t value){
+	p[0] = value;
+	p[1] = value >> 8;
+}
+
+static size_t rowSize(uint width, uint channels){
+	return ((size_t)width * channels + 3) & ~(size_t)3;
+}
+
+// Row y of the image, counted from the top
+static uint8_t *bmpRow(const bmp_image_t *image, uint y){
+	return image->pixels + (image->bottomUp ? image->height - 1 - y : y) * image->rowBytes;
+}
+
+// Checks the headers and fills the geometry of a mapped file
+static int parseHeaders(bmp_image_t *image){
+	const uint8_t *map = image->map;
+
+	if (image->mapSize < BMP_FILE_HEADER + BMP_INFO_HEADER || map[0] != 'B' || map[1] != 'M'){
+		return -1;
+	}
+
+	uint32_t dataOffset = readU32(map + 10);
+	uint32_t headerSize = readU32(map + 14);
+	int32_t width = (int32_t)readU32(map + 18);
+	int32_t height = (int32_t)readU32(map + 22);
+	uint16_t bitsPerPixel = readU16(map + 28);
+	uint32_t compression = readU32(map + 30);
+
+	if (headerSize < BMP_INFO_HEADER || width <= 0 || height == 0 || height == INT32_MIN
+			|| readU16(map + 26) != 1 || (bitsPerPixel != 24 && bitsPerPixel != 32)){
+		return -1;
+	}
+
+	// BI_BITFIELDS is only accepted with the usual BGRA masks, which follow
+	// the info header (or are inside it, for the V4 and V5 headers)
+	if (compression == BMP_BITFIELDS){
+		if (bitsPerPixel != 32 || image->mapSize < BMP_FILE_HEADER + BMP_INFO_HEADER + 12
+				|| readU32(map + 54) != 0x00ff0000 || readU32(map + 58) != 0x0000ff00
+				|| readU32(map + 62) != 0x000000ff){
+			return -1;
+		}
+	}
+	else if (compression != BMP_RGB){
+		return -1;
+	}
+
+	image->width = width;
+	image->height = (height < 0) ? -height : height;
+	image->bottomUp = height > 0;
+	image->channels = bitsPerPixel / 8;
+	image->rowBytes = rowSize(image->width, image->channels);
+
+	if (dataOffset > image->mapSize || (image->mapSize - dataOffset) / image->rowBytes < image->height){
+		return -1;
+	}
+	image->pixels = image->map + dataOffset;
+
+	return 0;
+}
+
+int bmpOpen(bmp_image_t *image, const char *path){
+	struct stat info;
+
+	image->fd = open(path, O_RDONLY);
+	if (image->fd == -1){
+		return -1;
+	}
+	if (fstat(image->fd, &info) != 0){
+		close(image->fd);
+		return -1;
+	}
+
+	image->mapSize = info.st_size;
+	image->map = (image->mapSize == 0) ? (uint8_t *)MAP_FAILED
+			: (uint8_t *) mmap(NULL, image->mapSize, PROT_READ, MAP_PRIVATE, image->fd, 0);
+	if (image->map == MAP_FAILED){
+		errno = (image->mapSize == 0) ? EINVAL : errno;
+		close(image->fd);
+		return -1;
+	}
+
+	if (parseHeaders(image) != 0){
+		bmpClose(image);
+		errno = EINVAL;
+		return -1;
+	}
+	// The rows are read once, in order
+	madvise(image->map, image->mapSize, MADV_SEQUENTIAL);
+
+	return 0;
+}
+
+int bmpCreate(bmp_image_t *image, const char *path, uint width, uint height, uint channels){
+
+	if (width == 0 || height == 0 || width > INT32_MAX || height > INT32_MAX || (channels != 3 && channels != 4)){
+		errno = EINVAL;
+		return -1;
+	}
+
+	image->width = width;
+	image->height = height;
+	image->channels = channels;
+	image->rowBytes = rowSize(width, channels);
+	image->bottomUp = true;
+	image->mapSize = BMP_FILE_HEADER + BMP_INFO_HEADER + image->rowBytes * height;
+
+	image->fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (image->fd == -1){
+		return -1;
+	}
+	// The file gets its final size before it is mapped
+	if (ftruncate(image->fd, image->mapSize) != 0){
+		close(image->fd);
+		return -1;
+	}
+	image->map = (uint8_t *) mmap(NULL, image->mapSize, PROT_READ | PROT_WRITE, MAP_SHARED, image->fd, 0);
+	if (image->map == MAP_FAILED){
+		close(image->fd);
+		return -1;
+	}
+	image->pixels = image->map + BMP_FILE_HEADER + BMP_INFO_HEADER;
+
+	// BITMAPFILEHEADER and BITMAPINFOHEADER (the rest of the fields are zero)
+	uint8_t *header = image->map;
+	header[0] = 'B';
+	header[1] = 'M';
+	writeU32(header + 2, image->mapSize);
+	writeU32(header + 10, BMP_FILE_HEADER + BMP_INFO_HEADER);
+	writeU32(header + 14, BMP_INFO_HEADER);
+	writeU32(header + 18, width);
+	writeU32(header + 22, height);
+	writeU16(header + 26, 1);
+	writeU16(header + 28, channels * 8);
+	writeU32(header + 30, BMP_RGB);
+	writeU32(header + 34, image->rowBytes * height);
+	writeU32(header + 38, 2835); // 72 DPI
+	writeU32(header + 42, 2835);
+
+	return 0;
+}
+
+blend_frame_t bmpFrame(const bmp_image_t *image){
+	blend_frame_t frame;
+
+	frame.data = bmpRow(image, 0);
+	frame.stride = image->bottomUp ? -(ptrdiff_t)image->rowBytes : (ptrdiff_t)image->rowBytes;
+	frame.width = image->width;
+	frame.height = image->height;
+	frame.channels = image->channels;
+	return frame;
+}
+
+int blendBmp(blend_context_t *ctx, const bmp_image_t *src, const bmp_image_t *filter, const bmp_image_t *dst){
+	blend_frame_t srcFrame = bmpFrame(src);
+	blend_frame_t filterFrame = bmpFrame(filter);
+	blend_frame_t dstFrame = bmpFrame(dst);
+
+	return blendFrame(ctx, &srcFrame, &filterFrame, &dstFrame);
+}
+
+int blendBmpSerial(const blend_context_t *ctx, const bmp_image_t *src, const bmp_image_t *filter, const bmp_image_t *dst){
+	blend_frame_t srcFrame = bmpFrame(src);
+	blend_frame_t filterFrame = bmpFrame(filter);
+	blend_frame_t dstFrame = bmpFrame(dst);
+
+	return blendFrameSerial(ctx, &srcFrame, &filterFrame, &dstFrame);
+}
+
+void bmpClose(bmp_image_t *image){
+	munmap(image->map, image->mapSize);
+	close(image->fd);
+}
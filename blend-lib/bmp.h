@@ -0,0 +1,59 @@
+/*
+ * bmp.h
+ *
+ *  Created on: Fall 2022
+ *
+ * Native BMP files for the blend, without CImg: the files are mapped in
+ * memory and the kernels read and write the pixel rows of the mappings,
+ * so the pixels are never copied between the page cache and the blend.
+ * Only uncompressed 24-bit (BGR) and 32-bit (BGRA) images are accepted.
+ */
+
+#ifndef BMP_H_
+#define BMP_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "frame.h"
+
+// Mapped BMP file
+typedef struct {
+	int fd;
+	uint8_t *map; // Whole file
+	size_t mapSize;
+	uint width;
+	uint height;
+	uint channels; // 3 (BGR) or 4 (BGRA)
+	uint8_t *pixels; // First row stored in the file
+	size_t rowBytes; // Bytes from a row to the next one (padded to 4)
+	bool bottomUp; // Rows are stored from the bottom of the image
+} bmp_image_t;
+
+// Maps an existing file read-only. Returns 0 on success and -1 on error
+// (errno is EINVAL when the file is not a supported BMP).
+int bmpOpen(bmp_image_t *image, const char *path);
+
+// Creates (or truncates) path with the size of a width x height image and
+// maps it for writing. The header is written; the pixels are left for the
+// blend. Returns 0 on success and -1 on error.
+int bmpCreate(bmp_image_t *image, const char *path, uint width, uint height, uint channels);
+
+// View of the mapped pixels as a frame, from the top row of the image
+// (the stride is negative for bottom-up files)
+blend_frame_t bmpFrame(const bmp_image_t *image);
+
+// dst = Overlap(src, filter) on the mapped pixels, split between the
+// workers of the context (see blendFrame): the rows are read and written
+// in the layout of the files, top-down or bottom-up. The alpha of 32-bit
+// images is taken from src. Returns 0 on success and -1 if the sizes or
+// the channels do not match.
+int blendBmp(blend_context_t *ctx, const bmp_image_t *src, const bmp_image_t *filter, const bmp_image_t *dst);
+
+// Same as blendBmp but on the calling thread (see blendImageSerial)
+int blendBmpSerial(const blend_context_t *ctx, const bmp_image_t *src, const bmp_image_t *filter, const bmp_image_t *dst);
+
+// Unmaps and closes the file (the pixels of a created file are written
+// back by the kernel)
+void bmpClose(bmp_image_t *image);
+
+#endif /* BMP_H_ */
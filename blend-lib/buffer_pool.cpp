@@ -0,0 +1,203 @@
+/*
+ * buffer_pool.cpp
+ *
+ *  Created on: Fall 2022
+ */
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "buffer_pool.h"
+
+// bytes rounded up to whole huge pages, or to whole pages when small
+static size_t poolRound(size_t bytes){
+	size_t page = (bytes < SMALL_BUFFER_BYTES) ? sysconf(_SC_PAGESIZE) : HUGE_PAGE_BYTES;
+
+	return (bytes + page - 1) / page * page;
+}
+
+// Small buffers: regular pages. Large ones: explicit huge pages when some
+// are reserved; otherwise a regular mapping trimmed to a huge page
+// boundary, which the kernel can back with transparent huge pages
+static void *mapBuffer(size_t bytes, bool *huge){
+	void *data;
+
+	*huge = false;
+	if (bytes < SMALL_BUFFER_BYTES){
+		data = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		return (data != MAP_FAILED) ? data : NULL;
+	}
+
+	data = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+
+	if (data != MAP_FAILED){
+		*huge = true;
+		return data;
+	}
+
+	size_t span = bytes + HUGE_PAGE_BYTES;
+	char *raw = (char *) mmap(NULL, span, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (raw == MAP_FAILED){
+		return NULL;
+	}
+	char *aligned = (char *)(((uintptr_t)raw + HUGE_PAGE_BYTES - 1) & ~(uintptr_t)(HUGE_PAGE_BYTES - 1));
+	if (aligned > raw){
+		munmap(raw, aligned - raw);
+	}
+	if (raw + span > aligned + bytes){
+		munmap(aligned + bytes, raw + span - (aligned + bytes));
+	}
+	// Only a hint: the pages stay regular ones when THP is disabled
+	madvise(aligned, bytes, MADV_HUGEPAGE);
+	return aligned;
+}
+
+static void unmapBuffer(buffer_pool_t *pool, uint i){
+	munmap(pool->buffers[i].data, pool->buffers[i].bytes);
+	pool->stats.unmappings++;
+	pool->stats.mappedBytes -= pool->buffers[i].bytes;
+	pool->buffers[i] = pool->buffers[--pool->nBuffers];
+}
+
+int bufferPoolCreate(buffer_pool_t *pool){
+
+	pool->buffers = NULL;
+	pool->nBuffers = 0;
+	pool->capacity = 0;
+	pool->stats = buffer_stats_t();
+	if (pthread_mutex_init(&pool->lock, NULL) != 0){
+		return -1;
+	}
+	return 0;
+}
+
+// Room for one more buffer in the table. Returns false if there is no memory.
+static bool reserveBuffer(buffer_pool_t *pool){
+
+	if (pool->nBuffers < pool->capacity){
+		return true;
+	}
+	uint capacity = (pool->capacity > 0) ? 2 * pool->capacity : POOL_INITIAL_BUFFERS;
+	pool_buffer_t *buffers = (pool_buffer_t *) realloc(pool->buffers, capacity * sizeof(pool_buffer_t));
+	if (buffers == NULL){
+		return false;
+	}
+	pool->buffers = buffers;
+	pool->capacity = capacity;
+	return true;
+}
+
+// Unmaps free buffers, the smallest first, until the idle bytes are at
+// most the bytes in use plus the ones of a request being mapped
+static void trimIdle(buffer_pool_t *pool, size_t requested){
+	size_t idleBytes = 0;
+
+	for (uint i = 0; i < pool->nBuffers; i++){
+		idleBytes += pool->buffers[i].inUse ? 0 : pool->buffers[i].bytes;
+	}
+	while (idleBytes > pool->stats.mappedBytes - idleBytes + requested){
+		int smallest = -1;
+		for (uint i = 0; i < pool->nBuffers; i++){
+			if (!pool->buffers[i].inUse && (smallest < 0 || pool->buffers[i].bytes < pool->buffers[smallest].bytes)){
+				smallest = i;
+			}
+		}
+		idleBytes -= pool->buffers[smallest].bytes;
+		unmapBuffer(pool, smallest);
+	}
+}
+
+void *bufferAcquire(buffer_pool_t *pool, size_t bytes){
+	size_t rounded = poolRound((bytes > 0) ? bytes : 1);
+	int best = -1;
+
+	pthread_mutex_lock(&pool->lock);
+	pool->stats.requests++;
+
+	for (uint i = 0; i < pool->nBuffers; i++){
+		pool_buffer_t *buffer = &pool->buffers[i];
+
+		if (!buffer->inUse && buffer->bytes >= rounded && (best < 0 || buffer->bytes < pool->buffers[best].bytes)){
+			best = i;
+		}
+	}
+	if (best >= 0){
+		pool->buffers[best].inUse = true;
+		pool->stats.reuses++;
+		pthread_mutex_unlock(&pool->lock);
+		return pool->buffers[best].data;
+	}
+
+	// None fits: sizes that grow (a sweep, a larger image) replace their
+	// buffers, while sizes that alternate (a preview and its destination)
+	// keep theirs
+	trimIdle(pool, rounded);
+
+	bool huge;
+	void *data = reserveBuffer(pool) ? mapBuffer(rounded, &huge) : NULL;
+	if (data == NULL){
+		pthread_mutex_unlock(&pool->lock);
+		errno = ENOMEM;
+		return NULL;
+	}
+	pool_buffer_t *buffer = &pool->buffers[pool->nBuffers++];
+	buffer->data = data;
+	buffer->bytes = rounded;
+	buffer->inUse = true;
+	buffer->huge = huge;
+	pool->stats.mappings++;
+	pool->stats.hugeMappings += huge ? 1 : 0;
+	pool->stats.mappedBytes += rounded;
+	if (pool->stats.mappedBytes > pool->stats.peakBytes){
+		pool->stats.peakBytes = pool->stats.mappedBytes;
+	}
+	pthread_mutex_unlock(&pool->lock);
+	return data;
+}
+
+void bufferRelease(buffer_pool_t *pool, void *data){
+
+	if (data == NULL){
+		return;
+	}
+	pthread_mutex_lock(&pool->lock);
+	for (uint i = 0; i < pool->nBuffers; i++){
+		if (pool->buffers[i].data == data){
+			pool->buffers[i].inUse = false;
+			break;
+		}
+	}
+	pthread_mutex_unlock(&pool->lock);
+}
+
+buffer_stats_t bufferPoolStats(buffer_pool_t *pool){
+	buffer_stats_t stats;
+
+	pthread_mutex_lock(&pool->lock);
+	stats = pool->stats;
+	pthread_mutex_unlock(&pool->lock);
+	return stats;
+}
+
+void bufferPoolTrim(buffer_pool_t *pool){
+
+	pthread_mutex_lock(&pool->lock);
+	for (uint i = pool->nBuffers; i > 0; i--){
+		if (!pool->buffers[i - 1].inUse){
+			unmapBuffer(pool, i - 1);
+		}
+	}
+	pthread_mutex_unlock(&pool->lock);
+}
+
+void bufferPoolDestroy(buffer_pool_t *pool){
+
+	while (pool->nBuffers > 0){
+		unmapBuffer(pool, pool->nBuffers - 1);
+	}
+	free(pool->buffers);
+	pool->buffers = NULL;
+	pthread_mutex_destroy(&pool->lock);
+}
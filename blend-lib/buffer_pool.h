@@ -0,0 +1,81 @@
+/*
+ * buffer_pool.h
+ *
+ *  Created on: Fall 2022
+ *
+ * Pool of buffers (planes, scratch rows, destinations) kept mapped
+ * between passes and images. Large buffers are whole 2 MiB pages: explicit
+ * huge pages when the system has some reserved, otherwise transparent huge
+ * pages requested with madvise, so a 4K image spans a few dozen TLB
+ * entries instead of thousands. Small ones (column tables, scratch rows)
+ * are regular pages, which a huge page would mostly leave unused. A
+ * released buffer goes back to the pool and is handed out again to the
+ * next request it fits, so a steady sequence of blends of the same sizes
+ * maps nothing after the first one.
+ */
+
+#ifndef BUFFER_POOL_H_
+#define BUFFER_POOL_H_
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#define HUGE_PAGE_BYTES (2 * 1024 * 1024)
+#define SMALL_BUFFER_BYTES (HUGE_PAGE_BYTES / 2) // Smaller requests take regular pages
+#define POOL_INITIAL_BUFFERS 16 // The table doubles when it is full
+
+// One mapping of the pool
+typedef struct {
+	void *data; // Aligned to HUGE_PAGE_BYTES (large) or to a page (small)
+	size_t bytes; // Multiple of HUGE_PAGE_BYTES or of the page size
+	bool inUse;
+	bool huge; // Explicit huge pages (MAP_HUGETLB), otherwise transparent or regular
+} pool_buffer_t;
+
+// Counters since the pool was created
+typedef struct {
+	uint64_t requests; // bufferAcquire calls
+	uint64_t reuses; // Requests served by a mapped buffer
+	uint64_t mappings; // Requests that mapped a new buffer
+	uint64_t unmappings;
+	uint64_t hugeMappings; // Mappings with explicit huge pages
+	size_t mappedBytes; // Now
+	size_t peakBytes;
+} buffer_stats_t;
+
+// Shared by every thread of a context: the list is under a mutex, taken
+// once per request, never inside a pass
+typedef struct {
+	pool_buffer_t *buffers;
+	uint nBuffers;
+	uint capacity;
+	pthread_mutex_t lock;
+	buffer_stats_t stats;
+} buffer_pool_t;
+
+// Empty pool. Returns 0 on success and -1 on error.
+int bufferPoolCreate(buffer_pool_t *pool);
+
+// Buffer of at least bytes, aligned to 64 bytes (to a whole page in fact):
+// the smallest free one that fits, or a new mapping. Before mapping, free
+// buffers (all too small) are unmapped, the smallest first, only until the
+// pool keeps idle at most the bytes it has in use. Returns NULL if there
+// is no memory (errno is ENOMEM).
+void *bufferAcquire(buffer_pool_t *pool, size_t bytes);
+
+// Gives back a buffer of bufferAcquire (NULL does nothing). The memory
+// stays mapped for the next request.
+void bufferRelease(buffer_pool_t *pool, void *data);
+
+// Copy of the counters
+buffer_stats_t bufferPoolStats(buffer_pool_t *pool);
+
+// Unmaps the free buffers
+void bufferPoolTrim(buffer_pool_t *pool);
+
+// Unmaps every buffer. None may be in use.
+void bufferPoolDestroy(buffer_pool_t *pool);
+
+#endif /* BUFFER_POOL_H_ */
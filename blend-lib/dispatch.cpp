@@ -0,0 +1,145 @@
+/*
+ * dispatch.cpp
+ *
+ *  Created on: Fall 2022
+ */
+
+#include <string.h>
+#include "kernels.h"
+
+static const char *KERNEL_NAMES[KERNEL_COUNT] = { "scalar", "sse2", "avx2", "avx512" };
+
+static const kernel_set_t *const KERNEL_SETS[KERNEL_COUNT] = {
+	&KERNELS_SCALAR,
+	&KERNELS_SSE2,
+	&KERNELS_AVX2,
+	&KERNELS_AVX512
+};
+
+static const kernel_set_t *const KERNEL_SETS_APPROX[KERNEL_COUNT] = {
+	&KERNELS_SCALAR_APPROX,
+	&KERNELS_SSE2_APPROX,
+	&KERNELS_AVX2_APPROX,
+	&KERNELS_AVX512_APPROX
+};
+
+// Odd 64-bit constants (from the digits of pi), one per lane
+const uint64_t HASH_KEY[HASH_LANES] = {
+	0x243F6A8885A308D3ull, 0x13198A2E03707345ull, 0xA4093822299F31D1ull, 0x082EFA98EC4E6C89ull,
+	0x452821E638D01377ull, 0xBE5466CF34E90C6Dull, 0xC0AC29B7C97C50DDull, 0x3F84D5B5B5470917ull
+};
+
+static const char *PRECISION_NAMES[PRECISION_COUNT] = { "exact", "approx" };
+
+static const char *MODE_NAMES[BLEND_MODE_COUNT] = {
+	"overlap", "multiply", "screen", "overlay", "darken", "lighten",
+	"dodge", "burn", "soft-light", "hard-light", "difference", "exclusion"
+};
+
+const char *kernelName(kernel_isa_t isa){
+	return KERNEL_NAMES[isa];
+}
+
+int kernelFromName(const char *name, kernel_isa_t *isa){
+
+	for (uint i = 0; i < KERNEL_COUNT; i++){
+		if (strcmp(name, KERNEL_NAMES[i]) == 0){
+			*isa = (kernel_isa_t)i;
+			return 0;
+		}
+	}
+	return -1;
+}
+
+bool kernelSupported(kernel_isa_t isa){
+
+	__builtin_cpu_init();
+	switch (isa){
+	case KERNEL_SCALAR:
+		return true;
+	case KERNEL_SSE2:
+		return __builtin_cpu_supports("sse2");
+	case KERNEL_AVX2:
+		return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+	case KERNEL_AVX512:
+		return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw") && __builtin_cpu_supports("avx512vl");
+	default:
+		return false;
+	}
+}
+
+kernel_isa_t kernelBest(){
+
+	for (int i = KERNEL_COUNT - 1; i > KERNEL_SCALAR; i--){
+		if (kernelSupported((kernel_isa_t)i)){
+			return (kernel_isa_t)i;
+		}
+	}
+	return KERNEL_SCALAR;
+}
+
+const kernel_set_t *kernelSet(kernel_isa_t isa, kernel_precision_t precision){
+	return (precision == PRECISION_APPROX) ? KERNEL_SETS_APPROX[isa] : KERNEL_SETS[isa];
+}
+
+blend_kernel_t kernelFunction(kernel_isa_t isa, blend_mode_t mode){
+	return KERNEL_SETS[isa]->range[mode];
+}
+
+blend_kernel_t kernelStreamFunction(kernel_isa_t isa, blend_mode_t mode){
+	return KERNEL_SETS[isa]->stream[mode];
+}
+
+plane_kernel_t planeKernelFunction(kernel_isa_t isa, blend_mode_t mode){
+	return KERNEL_SETS[isa]->plane[mode];
+}
+
+byte_kernel_t byteKernelFunction(kernel_isa_t isa, blend_mode_t mode){
+	return KERNEL_SETS[isa]->bytes[mode];
+}
+
+rgba_kernel_t rgbaKernelFunction(kernel_isa_t isa, blend_mode_t mode){
+	return KERNEL_SETS[isa]->rgba[mode];
+}
+
+prepared_kernel_t preparedKernelFunction(kernel_isa_t isa){
+	return KERNEL_SETS[isa]->prepared;
+}
+
+hash_kernel_t hashKernelFunction(kernel_isa_t isa){
+	return KERNEL_SETS[isa]->hash;
+}
+
+box_kernel_t boxKernelFunction(kernel_isa_t isa){
+	return KERNEL_SETS[isa]->box;
+}
+
+const char *modeName(blend_mode_t mode){
+	return MODE_NAMES[mode];
+}
+
+int modeFromName(const char *name, blend_mode_t *mode){
+
+	for (uint i = 0; i < BLEND_MODE_COUNT; i++){
+		if (strcmp(name, MODE_NAMES[i]) == 0){
+			*mode = (blend_mode_t)i;
+			return 0;
+		}
+	}
+	return -1;
+}
+
+const char *precisionName(kernel_precision_t precision){
+	return PRECISION_NAMES[precision];
+}
+
+int precisionFromName(const char *name, kernel_precision_t *precision){
+
+	for (uint i = 0; i < PRECISION_COUNT; i++){
+		if (strcmp(name, PRECISION_NAMES[i]) == 0){
+			*precision = (kernel_precision_t)i;
+			return 0;
+		}
+	}
+	return -1;
+}
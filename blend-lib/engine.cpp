@@ -0,0 +1,426 @@
+/*
+ * engine.cpp
+ *
+ *  Created on: Fall 2022
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+#include "engine.h"
+
+typedef struct {
+	filter_args_t imageSrc;
+	filter_image filterImage;
+	uint pixelInit;
+	uint pixelEnd;
+	uint id;
+	uint tilePixels; // 0 for the whole slice at once
+	blend_kernel_t kernel; // Kernel chosen for the host
+} thread_args;
+
+/***********************************************
+ *
+ * Algorithm. Image filter.
+ * Blend: Overlap Mode #10
+ *
+ * The kernels are in kernels_*.cpp, one per instruction set
+ *
+ * *********************************************/
+
+static void* FilterThread(void* args){
+
+	thread_args params = *((thread_args *)args);
+
+	filterSlice(params.kernel, params.imageSrc, params.filterImage, params.pixelInit, params.pixelEnd, params.tilePixels);
+
+	return NULL;
+}
+
+void filterSlice(blend_kernel_t kernel, filter_args_t filter_args, filter_image filter_components,
+		uint pixelInit, uint pixelEnd, uint tilePixels){
+
+	if (tilePixels == 0){
+		kernel(filter_args, filter_components, pixelInit, pixelEnd);
+		return;
+	}
+
+	for (uint tile = pixelInit; tile < pixelEnd; tile += tilePixels){
+		uint tileEnd = (pixelEnd - tile > tilePixels) ? tile + tilePixels : pixelEnd;
+		kernel(filter_args, filter_components, tile, tileEnd);
+	}
+}
+
+void filterProcess(worker_pool_t *pool, blend_kernel_t kernel, filter_args_t filter_args, filter_image filter_components){
+	filterProcessTiled(pool, kernel, filter_args, filter_components, 0);
+}
+
+void filterProcessTiled(worker_pool_t *pool, blend_kernel_t kernel, filter_args_t filter_args, filter_image filter_components,
+		uint tilePixels){
+
+	// Params of every job. They must outlive the pass, poolWait below guarantees it
+	thread_args params[MAX_THREADS];
+	uint nThreads = (pool->nThreads < MAX_THREADS) ? pool->nThreads : MAX_THREADS;
+
+	// Tiles start on a cache line too
+	tilePixels = (tilePixels + ITEMS_PER_LINE - 1) / ITEMS_PER_LINE * ITEMS_PER_LINE;
+
+	// Pixels per thread, rounded down to a whole number of cache lines
+	uint slice = (filter_args.pixelCount / nThreads) / ITEMS_PER_LINE * ITEMS_PER_LINE;
+
+	// Submit one job per thread
+	for (uint i = 0; i < nThreads; i++){
+
+		// Set the data for each thread. Each thread will process a specific part of the array
+		params[i].id = i;
+		params[i].imageSrc = filter_args;
+		params[i].filterImage = filter_components;
+		params[i].kernel = kernel;
+		params[i].tilePixels = tilePixels;
+
+		// Part of the array to be processed by the thread. The last thread takes the remainder
+		params[i].pixelInit = i * slice;
+		params[i].pixelEnd = (i == nThreads - 1) ? filter_args.pixelCount : (i + 1) * slice;
+
+		// Wake up a worker of the pool
+		poolSubmit(pool, FilterThread, &(params[i]));
+	}
+
+	// Wait untill all jobs are done
+	poolWait(pool);
+}
+
+/***********************************************
+ *
+ * Stealing scheduler
+ *
+ * *********************************************/
+
+// Chunks [next, end) still owned by a slot, packed in one word (next in
+// the low half) so that the owner and the thieves update them with a
+// single compare-and-swap. One cache line per slot.
+typedef struct {
+	uint64_t range;
+} __attribute__((aligned(64))) steal_range_t;
+
+// State shared by the slots of one pass
+typedef struct {
+	steal_range_t ranges[MAX_THREADS];
+	uint nWorkers;
+	uint chunkPixels;
+	uint pixelCount;
+	blend_kernel_t kernel;
+	filter_args_t imageSrc;
+	filter_image filterImage;
+} steal_pass_t;
+
+typedef struct {
+	steal_pass_t *pass;
+	uint id;
+	uint64_t chunks;
+	uint64_t stolen;
+	struct timespec tStart;
+	struct timespec tEnd;
+} steal_args_t;
+
+static inline uint64_t packRange(uint next, uint end){
+	return ((uint64_t)end << 32) | next;
+}
+
+// Takes the first chunk of the own range. Returns false when it is empty
+static bool takeChunk(steal_range_t *own, uint *chunk){
+	uint64_t range = __atomic_load_n(&own->range, __ATOMIC_ACQUIRE);
+
+	while ((uint)range < (uint)(range >> 32)){
+		if (__atomic_compare_exchange_n(&own->range, &range, range + 1, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)){
+			*chunk = (uint)range;
+			return true;
+		}
+	}
+	return false;
+}
+
+// Moves the second half of the fullest range to the own one. Returns the
+// number of chunks stolen, 0 when there was nothing left anywhere
+static uint stealChunks(steal_pass_t *pass, uint id){
+
+	while (true){
+		uint victim = id;
+		uint most = 0;
+		uint64_t range = 0;
+
+		for (uint i = 0; i < pass->nWorkers; i++){
+			uint64_t r = __atomic_load_n(&pass->ranges[i].range, __ATOMIC_ACQUIRE);
+			uint left = (uint)(r >> 32) - (uint)r;
+			if (i != id && (uint)r < (uint)(r >> 32) && left > most){
+				victim = i;
+				most = left;
+				range = r;
+			}
+		}
+		if (most == 0){
+			return 0;
+		}
+
+		uint next = (uint)range, end = (uint)(range >> 32);
+		uint middle = end - (most + 1) / 2;
+		if (__atomic_compare_exchange_n(&pass->ranges[victim].range, &range, packRange(next, middle), false,
+				__ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)){
+			// The own range is empty, nobody else changes it
+			__atomic_store_n(&pass->ranges[id].range, packRange(middle, end), __ATOMIC_RELEASE);
+			return end - middle;
+		}
+		// The victim changed in the meantime: look again
+	}
+}
+
+static void *StealThread(void *args){
+
+	steal_args_t *params = (steal_args_t *)args;
+	steal_pass_t *pass = params->pass;
+	uint chunk;
+
+	uint stolen;
+
+	clock_gettime(CLOCK_MONOTONIC, &params->tStart);
+	do {
+		while (takeChunk(&pass->ranges[params->id], &chunk)){
+			uint pixelInit = chunk * pass->chunkPixels;
+			uint pixelEnd = (pass->pixelCount - pixelInit > pass->chunkPixels) ? pixelInit + pass->chunkPixels : pass->pixelCount;
+
+			pass->kernel(pass->imageSrc, pass->filterImage, pixelInit, pixelEnd);
+			params->chunks++;
+		}
+		stolen = stealChunks(pass, params->id);
+		params->stolen += stolen;
+	} while (stolen > 0);
+	clock_gettime(CLOCK_MONOTONIC, &params->tEnd);
+
+	return NULL;
+}
+
+static double elapsedMs(struct timespec tStart, struct timespec tEnd){
+	return (tEnd.tv_sec - tStart.tv_sec) * 1e+3 + (tEnd.tv_nsec - tStart.tv_nsec) / 1e+6;
+}
+
+void filterProcessStealing(worker_pool_t *pool, blend_kernel_t kernel, filter_args_t filter_args, filter_image filter_components,
+		uint chunkPixels, sched_stats_t *stats){
+
+	steal_pass_t pass;
+	steal_args_t params[MAX_THREADS];
+	struct timespec tStart, tEnd;
+
+	pass.nWorkers = (pool->nThreads < MAX_THREADS) ? pool->nThreads : MAX_THREADS;
+	pass.chunkPixels = (chunkPixels + ITEMS_PER_LINE - 1) / ITEMS_PER_LINE * ITEMS_PER_LINE;
+	pass.chunkPixels = (pass.chunkPixels == 0) ? ITEMS_PER_LINE : pass.chunkPixels;
+	pass.pixelCount = filter_args.pixelCount;
+	pass.kernel = kernel;
+	pass.imageSrc = filter_args;
+	pass.filterImage = filter_components;
+
+	// Every slot starts with a contiguous run of chunks, as the static split
+	uint nChunks = (pass.pixelCount + pass.chunkPixels - 1) / pass.chunkPixels;
+	for (uint i = 0; i < pass.nWorkers; i++){
+		pass.ranges[i].range = packRange((uint64_t)i * nChunks / pass.nWorkers, (uint64_t)(i + 1) * nChunks / pass.nWorkers);
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &tStart);
+	for (uint i = 0; i < pass.nWorkers; i++){
+		params[i].pass = &pass;
+		params[i].id = i;
+		params[i].chunks = 0;
+		params[i].stolen = 0;
+		poolSubmit(pool, StealThread, &params[i]);
+	}
+	poolWait(pool);
+	clock_gettime(CLOCK_MONOTONIC, &tEnd);
+
+	if (stats == NULL){
+		return;
+	}
+
+	double passMs = elapsedMs(tStart, tEnd);
+	stats->passes++;
+	stats->nWorkers = (pass.nWorkers > stats->nWorkers) ? pass.nWorkers : stats->nWorkers;
+	for (uint i = 0; i < pass.nWorkers; i++){
+		double busyMs = elapsedMs(params[i].tStart, params[i].tEnd);
+		stats->workers[i].chunks += params[i].chunks;
+		stats->workers[i].stolen += params[i].stolen;
+		stats->workers[i].busyMs += busyMs;
+		stats->workers[i].idleMs += passMs - busyMs;
+	}
+}
+
+void schedStatsReset(sched_stats_t *stats){
+	memset(stats, 0, sizeof(sched_stats_t));
+}
+
+/***********************************************
+ *
+ * NUMA-aware split
+ *
+ * *********************************************/
+
+// Slices [next, end) of one node, claimed by its jobs. One cache line per node
+typedef struct {
+	uint next;
+	uint end;
+} __attribute__((aligned(64))) numa_slices_t;
+
+// Slices of the pass, node by node
+typedef struct {
+	numa_slices_t nodes[NUMA_MAX_NODES];
+	int nodeOfSlice[MAX_THREADS];
+	uint nNodes;
+	uint nSlices;
+	uint slice; // Pixels per slice, the last one takes the remainder
+	uint pixelCount;
+} numa_split_t;
+
+typedef struct {
+	numa_split_t *split;
+	const numa_topology_t *topology;
+	filter_args_t imageSrc;
+	filter_image filterImage;
+	blend_kernel_t kernel; // NULL to place the pages instead
+	uint tilePixels;
+	int error; // errno of the first failed move
+} numa_pass_t;
+
+static void numaSplit(worker_pool_t *pool, uint pixelCount, const numa_topology_t *topology, numa_split_t *split){
+	uint perNode[NUMA_MAX_NODES] = { 0 };
+
+	split->nSlices = (pool->nThreads < MAX_THREADS) ? pool->nThreads : MAX_THREADS;
+	split->nNodes = topology->nNodes;
+	split->slice = (pixelCount / split->nSlices) / ITEMS_PER_LINE * ITEMS_PER_LINE;
+	split->pixelCount = pixelCount;
+
+	for (uint i = 0; i < split->nSlices; i++){
+		perNode[numaWorkerNode(topology, i)]++;
+	}
+	uint first = 0;
+	for (uint node = 0; node < split->nNodes; node++){
+		split->nodes[node].next = first;
+		split->nodes[node].end = first + perNode[node];
+		for (uint i = first; i < split->nodes[node].end; i++){
+			split->nodeOfSlice[i] = node;
+		}
+		first = split->nodes[node].end;
+	}
+}
+
+static void sliceRange(const numa_split_t *split, uint i, uint *pixelInit, uint *pixelEnd){
+	*pixelInit = i * split->slice;
+	*pixelEnd = (i == split->nSlices - 1) ? split->pixelCount : (i + 1) * split->slice;
+}
+
+// Takes a slice of node, or of any node when it has none left
+static uint claimSlice(numa_split_t *split, int node){
+
+	for (uint n = 0; n < split->nNodes; n++){
+		numa_slices_t *slices = &split->nodes[(node + n) % split->nNodes];
+		if (__atomic_load_n(&slices->next, __ATOMIC_RELAXED) < slices->end){
+			uint i = __atomic_fetch_add(&slices->next, 1, __ATOMIC_RELAXED);
+			if (i < slices->end){
+				return i;
+			}
+		}
+	}
+	return split->nSlices; // Never reached: there are as many jobs as slices
+}
+
+// Every plane of the three images in one slice
+static void placeSlice(numa_pass_t *pass, uint pixelInit, uint pixelEnd, int node){
+	data_t *planes[] = {
+		pass->imageSrc.pRsrc, pass->imageSrc.pGsrc, pass->imageSrc.pBsrc,
+		pass->filterImage.pRfilter, pass->filterImage.pGfilter, pass->filterImage.pBfilter,
+		pass->imageSrc.pRdst, pass->imageSrc.pGdst, pass->imageSrc.pBdst
+	};
+	size_t bytes = (size_t)(pixelEnd - pixelInit) * sizeof(data_t);
+
+	for (uint i = 0; i < sizeof(planes) / sizeof(planes[0]); i++){
+		numaTouch(planes[i] + pixelInit, bytes);
+		if (numaMove(planes[i] + pixelInit, bytes, node) != 0){
+			int none = 0;
+			__atomic_compare_exchange_n(&pass->error, &none, errno, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+		}
+	}
+}
+
+static void *NumaThread(void *args){
+
+	numa_pass_t *pass = (numa_pass_t *)args;
+	uint i = claimSlice(pass->split, numaCurrentNode(pass->topology));
+	uint pixelInit, pixelEnd;
+
+	sliceRange(pass->split, i, &pixelInit, &pixelEnd);
+	if (pass->kernel != NULL){
+		filterSlice(pass->kernel, pass->imageSrc, pass->filterImage, pixelInit, pixelEnd, pass->tilePixels);
+	} else {
+		placeSlice(pass, pixelInit, pixelEnd, pass->split->nodeOfSlice[i]);
+	}
+
+	return NULL;
+}
+
+// One job per slice, all sharing pass
+static void numaPass(worker_pool_t *pool, numa_pass_t *pass){
+	numa_split_t split;
+
+	numaSplit(pool, pass->imageSrc.pixelCount, pass->topology, &split);
+	pass->split = &split;
+	pass->error = 0;
+	for (uint i = 0; i < split.nSlices; i++){
+		poolSubmit(pool, NumaThread, pass);
+	}
+	poolWait(pool);
+}
+
+void filterProcessNuma(worker_pool_t *pool, blend_kernel_t kernel, filter_args_t filter_args, filter_image filter_components,
+		uint tilePixels, const numa_topology_t *topology){
+	numa_pass_t pass;
+
+	pass.topology = topology;
+	pass.imageSrc = filter_args;
+	pass.filterImage = filter_components;
+	pass.kernel = kernel;
+	pass.tilePixels = (tilePixels + ITEMS_PER_LINE - 1) / ITEMS_PER_LINE * ITEMS_PER_LINE;
+	numaPass(pool, &pass);
+}
+
+int filterPlaceNuma(worker_pool_t *pool, filter_args_t filter_args, filter_image filter_components,
+		const numa_topology_t *topology){
+	numa_pass_t pass;
+
+	pass.topology = topology;
+	pass.imageSrc = filter_args;
+	pass.filterImage = filter_components;
+	pass.kernel = NULL;
+	pass.tilePixels = 0;
+	numaPass(pool, &pass);
+
+	if (pass.error != 0){
+		errno = pass.error;
+		return -1;
+	}
+	return 0;
+}
+
+void filterReportNuma(worker_pool_t *pool, filter_args_t filter_args, filter_image filter_components,
+		const numa_topology_t *topology, numa_report_t *report){
+	numa_split_t split;
+	const data_t *planes[] = {
+		filter_args.pRsrc, filter_args.pGsrc, filter_args.pBsrc,
+		filter_components.pRfilter, filter_components.pGfilter, filter_components.pBfilter,
+		filter_args.pRdst, filter_args.pGdst, filter_args.pBdst
+	};
+
+	numaSplit(pool, filter_args.pixelCount, topology, &split);
+	for (uint i = 0; i < split.nSlices; i++){
+		uint pixelInit, pixelEnd;
+		sliceRange(&split, i, &pixelInit, &pixelEnd);
+		for (uint p = 0; p < sizeof(planes) / sizeof(planes[0]); p++){
+			numaCount(planes[p] + pixelInit, (size_t)(pixelEnd - pixelInit) * sizeof(data_t), split.nodeOfSlice[i], report);
+		}
+	}
+}
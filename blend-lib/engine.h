@@ -0,0 +1,87 @@
+/*
+ * engine.h
+ *
+ *  Created on: Fall 2022
+ */
+
+#ifndef ENGINE_H_
+#define ENGINE_H_
+
+#include <stdint.h>
+#include "kernels.h"
+#include "numa.h"
+#include "worker_pool.h"
+
+// Maximum number of threads a pass can be split between
+#define MAX_THREADS 256
+
+// Slices given to the threads start at a multiple of this number of pixels
+// (one cache line of data_t), so two threads never write the same line
+#define ITEMS_PER_LINE (64/sizeof(data_t))
+
+// Default tile of the tiled execution, in pixels: with float data the
+// nine streams of a tile (R, G and B of source, filter and destination)
+// take 144 KiB, which stay in the L2 cache of current processors
+#define DEFAULT_TILE_PIXELS 4096
+
+// Blends the whole image once. The pixels are split in one slice per
+// worker of the pool (at most MAX_THREADS) and every slice goes through kernel.
+void filterProcess(worker_pool_t *pool, blend_kernel_t kernel, filter_args_t filter_args, filter_image filter_components);
+
+// Same as filterProcess, but every worker blends its slice in tiles of
+// tilePixels pixels (rounded up to whole cache lines): the R, G and B
+// planes of a tile are done while they are in cache, before the next tile.
+// A tilePixels of 0 blends every slice in a single call.
+void filterProcessTiled(worker_pool_t *pool, blend_kernel_t kernel, filter_args_t filter_args, filter_image filter_components,
+		uint tilePixels);
+
+// Work of one job slot of the stealing scheduler, added over the passes
+typedef struct {
+	uint64_t chunks; // Chunks blended
+	uint64_t stolen; // Chunks taken from other slots
+	double busyMs; // From the start of the job to its end
+	double idleMs; // Rest of the pass: waiting for a worker, or for the other slots
+} worker_stats_t;
+
+// Statistics of the stealing scheduler
+typedef struct {
+	uint64_t passes;
+	uint nWorkers; // Slots with data in workers
+	worker_stats_t workers[MAX_THREADS];
+} sched_stats_t;
+
+// Same as filterProcessTiled, but the image is split in chunks of
+// chunkPixels pixels (rounded up to whole cache lines). Every worker starts
+// with a contiguous run of chunks and, once it is done, steals half of
+// the chunks left to the busiest worker. A slow or preempted thread
+// only delays the chunk it is blending, not the whole pass. If stats is
+// not NULL the work and idle time of every slot is added to it.
+void filterProcessStealing(worker_pool_t *pool, blend_kernel_t kernel, filter_args_t filter_args, filter_image filter_components,
+		uint chunkPixels, sched_stats_t *stats);
+
+// Clears the statistics
+void schedStatsReset(sched_stats_t *stats);
+
+// NUMA-aware version of filterProcessTiled for a pool pinned with
+// numaPinPool. The slices are grouped by node: every node gets one slice
+// per worker pinned to it, and every job blends a slice of the node it
+// runs on (of another node only when those are taken).
+void filterProcessNuma(worker_pool_t *pool, blend_kernel_t kernel, filter_args_t filter_args, filter_image filter_components,
+		uint tilePixels, const numa_topology_t *topology);
+
+// Places the pages of the slices of filterProcessNuma on their nodes: the
+// workers first touch them and then move the ones already allocated
+// elsewhere. Returns 0 on success and -1 if the pages cannot be moved
+// (errno set).
+int filterPlaceNuma(worker_pool_t *pool, filter_args_t filter_args, filter_image filter_components,
+		const numa_topology_t *topology);
+
+// Adds to report the pages of every slice, local or remote to its node
+void filterReportNuma(worker_pool_t *pool, filter_args_t filter_args, filter_image filter_components,
+		const numa_topology_t *topology, numa_report_t *report);
+
+// Pixels [pixelInit, pixelEnd) in tiles on the calling thread
+void filterSlice(blend_kernel_t kernel, filter_args_t filter_args, filter_image filter_components,
+		uint pixelInit, uint pixelEnd, uint tilePixels);
+
+#endif /* ENGINE_H_ */
@@ -0,0 +1,149 @@
+/*
+ * frame.cpp
+ *
+ *  Created on: Fall 2022
+ */
+
+#include <errno.h>
+#include <string.h>
+#include "frame.h"
+#include "engine.h"
+
+// Rows [rowInit, rowEnd) of dst, counted from the top, for one worker
+typedef struct {
+	const blend_frame_t *src;
+	const blend_frame_t *filter;
+	const blend_frame_t *dst;
+	byte_kernel_t bytes;
+	rgba_kernel_t rgba;
+	uint rowInit;
+	uint rowEnd;
+} frame_rows_args_t;
+
+static uint8_t *frameRow(const blend_frame_t *frame, uint y){
+	return frame->data + (ptrdiff_t)y * frame->stride;
+}
+
+// Overlap treats the components alike, so BGR pixels are blended as runs
+// of bytes and BGRA pixels as runs of 4-byte pixels whose alpha the kernel
+// keeps: no component is ever moved to another position
+static void blendRun(const frame_rows_args_t *params, const uint8_t *src, const uint8_t *filter, uint8_t *dst, size_t bytes){
+
+	if (params->dst->channels == 4){
+		params->rgba(src, filter, dst, bytes / 4);
+	} else {
+		params->bytes(src, filter, dst, bytes);
+	}
+}
+
+static void blendFrameRows(const frame_rows_args_t *params){
+	const blend_frame_t *src = params->src;
+	const blend_frame_t *filter = params->filter;
+	const blend_frame_t *dst = params->dst;
+	size_t rowBytes = (size_t)dst->width * dst->channels;
+
+	if (params->rowInit == params->rowEnd){
+		return;
+	}
+
+	// Same stride in the three frames (a multiple of the pixel with alpha):
+	// the band is a single run from its lowest row in memory, row padding
+	// included
+	ptrdiff_t stride = dst->stride;
+	if (src->stride == stride && filter->stride == stride && (dst->channels == 3 || stride % 4 == 0)){
+		uint first = (stride > 0) ? params->rowInit : params->rowEnd - 1;
+		size_t step = (stride > 0) ? stride : -stride;
+		size_t bytes = (params->rowEnd - params->rowInit - 1) * step + rowBytes;
+
+		blendRun(params, frameRow(src, first), frameRow(filter, first), frameRow(dst, first), bytes);
+		return;
+	}
+
+	for (uint y = params->rowInit; y < params->rowEnd; y++){
+		blendRun(params, frameRow(src, y), frameRow(filter, y), frameRow(dst, y), rowBytes);
+	}
+}
+
+static void *FrameRowsThread(void *args){
+
+	blendFrameRows((frame_rows_args_t *)args);
+
+	return NULL;
+}
+
+static bool frameValid(const blend_frame_t *frame){
+	size_t step = (frame->stride > 0) ? frame->stride : -frame->stride;
+
+	return (frame->channels == 3 || frame->channels == 4) && step >= (size_t)frame->width * frame->channels;
+}
+
+bool blendFramesMatch(const blend_frame_t *src, const blend_frame_t *filter, const blend_frame_t *dst){
+	return frameValid(src) && frameValid(filter) && frameValid(dst)
+			&& src->width == filter->width && src->height == filter->height
+			&& src->width == dst->width && src->height == dst->height
+			&& src->channels == filter->channels && src->channels == dst->channels;
+}
+
+static void rowsArgs(const blend_context_t *ctx, const blend_frame_t *src, const blend_frame_t *filter, const blend_frame_t *dst,
+		frame_rows_args_t *params){
+	params->src = src;
+	params->filter = filter;
+	params->dst = dst;
+	params->bytes = ctx->byteKernel;
+	params->rgba = ctx->rgbaKernel;
+	params->rowInit = 0;
+	params->rowEnd = dst->height;
+}
+
+int blendFrame(blend_context_t *ctx, const blend_frame_t *src, const blend_frame_t *filter, const blend_frame_t *dst){
+
+	if (!blendFramesMatch(src, filter, dst)){
+		errno = EINVAL;
+		return -1;
+	}
+
+	// Every worker gets a band of whole rows
+	frame_rows_args_t params[MAX_THREADS];
+	uint nThreads = ctx->pool.nThreads;
+	uint band = dst->height / nThreads;
+	uint extra = dst->height % nThreads;
+	uint row = 0;
+
+	for (uint i = 0; i < nThreads; i++){
+		rowsArgs(ctx, src, filter, dst, &params[i]);
+		params[i].rowInit = row;
+		row += band + ((i < extra) ? 1 : 0);
+		params[i].rowEnd = row;
+		poolSubmit(&ctx->pool, FrameRowsThread, &params[i]);
+	}
+	poolWait(&ctx->pool);
+
+	return 0;
+}
+
+int blendFrameSerial(const blend_context_t *ctx, const blend_frame_t *src, const blend_frame_t *filter, const blend_frame_t *dst){
+	frame_rows_args_t params;
+
+	if (!blendFramesMatch(src, filter, dst)){
+		errno = EINVAL;
+		return -1;
+	}
+
+	rowsArgs(ctx, src, filter, dst, &params);
+	blendFrameRows(&params);
+
+	return 0;
+}
+
+int blendFrameCopy(const blend_frame_t *src, const blend_frame_t *dst){
+
+	if (!frameValid(src) || !frameValid(dst) || src->width != dst->width || src->height != dst->height
+			|| src->channels != dst->channels){
+		errno = EINVAL;
+		return -1;
+	}
+	for (uint y = 0; y < dst->height; y++){
+		memmove(frameRow(dst, y), frameRow(src, y), (size_t)dst->width * dst->channels);
+	}
+	return 0;
+}
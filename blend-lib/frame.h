@@ -0,0 +1,47 @@
+/*
+ * frame.h
+ *
+ *  Created on: Fall 2022
+ *
+ * Interleaved 8-bit frames (BGR or BGRA, as in BMP files and most video
+ * buffers) blended in their own layout: the kernels read and write the
+ * pixels as stored, without splitting them in planes and joining them back.
+ */
+
+#ifndef FRAME_H_
+#define FRAME_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "blend.h"
+
+// Borrowed interleaved image
+typedef struct {
+	uint8_t *data; // First component of the top row
+	ptrdiff_t stride; // Bytes from a row to the one below it, negative for bottom-up buffers
+	uint width;
+	uint height;
+	uint channels; // 3 (BGR/RGB) or 4 (BGRA/RGBA, alpha last)
+} blend_frame_t;
+
+// True when the three frames can be blended together: 3 or 4 channels,
+// rows that fit in their stride and the same size and channels
+bool blendFramesMatch(const blend_frame_t *src, const blend_frame_t *filter, const blend_frame_t *dst);
+
+// dst = Overlap(src, filter) on the interleaved pixels, split in bands of
+// rows between the workers of the context. The alpha of 4-channel frames
+// is taken from src. The three frames must have the same size and
+// channels; the strides may differ. dst may be src (in place). Returns 0
+// on success and -1 if the frames do not match (errno is EINVAL).
+int blendFrame(blend_context_t *ctx, const blend_frame_t *src, const blend_frame_t *filter, const blend_frame_t *dst);
+
+// Same as blendFrame but on the calling thread (see blendImageSerial)
+int blendFrameSerial(const blend_context_t *ctx, const blend_frame_t *src, const blend_frame_t *filter, const blend_frame_t *dst);
+
+// Copies the pixels of src to dst row by row, from the top, so a bottom-up
+// frame and a top-down one hold the same image after it. The frames must
+// have the same size and channels. Returns 0 on success and -1 if they do
+// not match (errno is EINVAL).
+int blendFrameCopy(const blend_frame_t *src, const blend_frame_t *dst);
+
+#endif /* FRAME_H_ */
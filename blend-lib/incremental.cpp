@@ -0,0 +1,199 @@
+/*
+ * incremental.cpp
+ *
+ *  Created on: Fall 2022
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include "incremental.h"
+#include "engine.h"
+
+// Odd constant of the multiplicative hash (2^64 / golden ratio)
+const uint64_t HASH_K = 0x9E3779B97F4A7C15ull;
+
+// Tiles of one worker: worker, worker + nWorkers...
+typedef struct {
+	blend_incremental_t *state;
+	const blend_image_t *src;
+	const blend_image_t *filter;
+	const blend_image_t *dst;
+	plane_kernel_t planeKernel;
+	hash_kernel_t hashKernel;
+	uint worker;
+	uint nWorkers;
+	uint64_t blended; // Tiles of this worker
+} incremental_args_t;
+
+static uint64_t rotl(uint64_t x, uint bits){
+	return (x << bits) | (x >> (64 - bits));
+}
+
+// Running fingerprint of a tile: the lanes of the hash kernel
+typedef struct {
+	uint64_t acc[HASH_LANES];
+	uint64_t calls; // hashBytes calls so far
+} hash_state_t;
+
+static void hashInit(hash_state_t *hash, uint64_t seed){
+
+	for (uint i = 0; i < HASH_LANES; i++){
+		hash->acc[i] = HASH_KEY[i] ^ (seed * HASH_K);
+	}
+	hash->calls = 0;
+}
+
+// Whole stripes through the kernel, the last bytes one by one. The lanes
+// are scrambled with the number of the call after every call: the kernel
+// only tells apart the stripes of one call, and the rows, planes and
+// images of a tile are hashed in separate calls.
+static void hashBytes(hash_state_t *hash, hash_kernel_t kernel, const uint8_t *data, size_t bytes){
+	size_t done = kernel(data, bytes, hash->acc);
+
+	for (uint i = 0; done < bytes; i++, done++){
+		hash->acc[i % HASH_LANES] = rotl(hash->acc[i % HASH_LANES] ^ data[done], 31) * HASH_K;
+	}
+	hash->calls++;
+	for (uint i = 0; i < HASH_LANES; i++){
+		uint64_t acc = hash->acc[i];
+		hash->acc[i] = (acc ^ (acc >> 47) ^ HASH_KEY[i] ^ (hash->calls * HASH_STEP)) * HASH_K;
+	}
+}
+
+// Mixes the lanes so that every bit of them reaches every bit of the result
+static uint64_t hashFinal(const hash_state_t *hash){
+	uint64_t value = 0;
+
+	for (uint i = 0; i < HASH_LANES; i++){
+		value = rotl(value ^ hash->acc[i], 31) * HASH_K;
+	}
+	value ^= value >> 29;
+	value *= HASH_K;
+	return value ^ (value >> 32);
+}
+
+static void tileBounds(const blend_incremental_t *state, uint tile, uint *x0, uint *x1, uint *y0, uint *y1){
+	*x0 = (tile % state->tilesX) * state->tileWidth;
+	*y0 = (tile / state->tilesX) * state->tileHeight;
+	*x1 = (state->width - *x0 < state->tileWidth) ? state->width : *x0 + state->tileWidth;
+	*y1 = (state->height - *y0 < state->tileHeight) ? state->height : *y0 + state->tileHeight;
+}
+
+static void *IncrementalThread(void *args){
+	incremental_args_t *params = (incremental_args_t *)args;
+	blend_incremental_t *state = params->state;
+	const blend_plane_t *srcPlanes[] = { &params->src->r, &params->src->g, &params->src->b };
+	const blend_plane_t *filterPlanes[] = { &params->filter->r, &params->filter->g, &params->filter->b };
+	const blend_plane_t *dstPlanes[] = { &params->dst->r, &params->dst->g, &params->dst->b };
+	uint nTiles = state->tilesX * state->tilesY;
+	uint x0, x1, y0, y1;
+
+	for (uint tile = params->worker; tile < nTiles; tile += params->nWorkers){
+		hash_state_t hash;
+
+		hashInit(&hash, tile);
+		tileBounds(state, tile, &x0, &x1, &y0, &y1);
+		size_t rowBytes = (x1 - x0) * sizeof(data_t);
+		for (uint p = 0; p < 3; p++){
+			for (uint y = y0; y < y1; y++){
+				hashBytes(&hash, params->hashKernel, (const uint8_t *)(srcPlanes[p]->data + y * srcPlanes[p]->stride + x0), rowBytes);
+				hashBytes(&hash, params->hashKernel, (const uint8_t *)(filterPlanes[p]->data + y * filterPlanes[p]->stride + x0), rowBytes);
+			}
+		}
+		uint64_t fingerprint = hashFinal(&hash);
+		if (state->valid && state->fingerprints[tile] == fingerprint){
+			continue;
+		}
+
+		// The inputs of the tile were just read, so they are in cache
+		for (uint p = 0; p < 3; p++){
+			for (uint y = y0; y < y1; y++){
+				params->planeKernel(srcPlanes[p]->data + y * srcPlanes[p]->stride + x0,
+						filterPlanes[p]->data + y * filterPlanes[p]->stride + x0,
+						dstPlanes[p]->data + y * dstPlanes[p]->stride + x0, x1 - x0);
+			}
+		}
+		state->fingerprints[tile] = fingerprint;
+		params->blended++;
+	}
+
+	return NULL;
+}
+
+int blendIncrementalCreate(blend_incremental_t *state, uint width, uint height, uint tileWidth, uint tileHeight){
+
+	memset(state, 0, sizeof(*state));
+	state->width = width;
+	state->height = height;
+	state->tileWidth = (tileWidth > 0) ? tileWidth : DEFAULT_INCREMENTAL_WIDTH;
+	state->tileHeight = (tileHeight > 0) ? tileHeight : DEFAULT_INCREMENTAL_HEIGHT;
+	state->tilesX = (width + state->tileWidth - 1) / state->tileWidth;
+	state->tilesY = (height + state->tileHeight - 1) / state->tileHeight;
+	state->fingerprints = (uint64_t *) calloc((size_t)state->tilesX * state->tilesY, sizeof(uint64_t));
+
+	return (state->fingerprints != NULL || state->tilesX * state->tilesY == 0) ? 0 : -1;
+}
+
+static bool sharesPlanes(const blend_image_t *a, const blend_image_t *b){
+	return a->r.data == b->r.data || a->g.data == b->g.data || a->b.data == b->b.data;
+}
+
+int blendImageIncremental(blend_context_t *ctx, blend_incremental_t *state, const blend_image_t *src,
+		const blend_image_t *filter, const blend_image_t *dst){
+	incremental_args_t params[MAX_THREADS];
+	uint nThreads = ctx->pool.nThreads;
+	uint nTiles = state->tilesX * state->tilesY;
+
+	if (src->width != state->width || src->height != state->height || filter->width != state->width
+			|| filter->height != state->height || dst->width != state->width || dst->height != state->height
+			|| sharesPlanes(dst, src) || sharesPlanes(dst, filter)){
+		errno = EINVAL;
+		return -1;
+	}
+	if (dst->r.data != state->dstData || ctx->mode != state->mode || ctx->precision != state->precision){
+		state->valid = false;
+	}
+
+	for (uint i = 0; i < nThreads; i++){
+		params[i].state = state;
+		params[i].src = src;
+		params[i].filter = filter;
+		params[i].dst = dst;
+		params[i].planeKernel = ctx->planeKernel;
+		params[i].hashKernel = ctx->hashKernel;
+		params[i].worker = i;
+		params[i].nWorkers = nThreads;
+		params[i].blended = 0;
+		poolSubmit(&ctx->pool, IncrementalThread, &params[i]);
+	}
+	poolWait(&ctx->pool);
+
+	uint64_t blended = 0;
+	for (uint i = 0; i < nThreads; i++){
+		blended += params[i].blended;
+	}
+	state->tilesBlended += blended;
+	state->tilesReused += nTiles - blended;
+	state->valid = true;
+	state->dstData = dst->r.data;
+	state->mode = ctx->mode;
+	state->precision = ctx->precision;
+
+	return 0;
+}
+
+void blendIncrementalInvalidate(blend_incremental_t *state){
+	state->valid = false;
+}
+
+double blendIncrementalReuse(const blend_incremental_t *state){
+	uint64_t tiles = state->tilesBlended + state->tilesReused;
+
+	return (tiles > 0) ? (double)state->tilesReused / tiles : 0.0;
+}
+
+void blendIncrementalRelease(blend_incremental_t *state){
+	free(state->fingerprints);
+	state->fingerprints = NULL;
+}
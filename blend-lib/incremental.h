@@ -0,0 +1,68 @@
+/*
+ * incremental.h
+ *
+ *  Created on: Fall 2022
+ *
+ * Incremental blend for sequences of frames that differ in small areas:
+ * the image is split in tiles and a 64-bit fingerprint of the
+ * source and filter components of every tile is kept between calls. A
+ * call blends only the tiles whose fingerprint changed and leaves the rest
+ * of the destination as the previous call wrote it, so a near-static
+ * scene costs one read of its inputs (the hashes) instead of a full blend.
+ */
+
+#ifndef INCREMENTAL_H_
+#define INCREMENTAL_H_
+
+#include <stdint.h>
+#include "blend.h"
+
+// Default tile, in pixels: rows of 4 KiB of float components, long
+// enough for the prefetchers (square tiles read a short run of every row
+// and take longer to hash than a full blend), and 4096 pixels whose six
+// input planes are still in L2 when the tile is blended after being hashed
+#define DEFAULT_INCREMENTAL_WIDTH 1024
+#define DEFAULT_INCREMENTAL_HEIGHT 4
+
+// Fingerprints of the last blend of one destination
+typedef struct {
+	uint width;
+	uint height;
+	uint tileWidth; // In pixels
+	uint tileHeight;
+	uint tilesX;
+	uint tilesY;
+	uint64_t *fingerprints; // tilesX * tilesY, row by row
+	bool valid; // The destination holds the blend of the fingerprints
+	const data_t *dstData; // Destination of the fingerprints
+	blend_mode_t mode; // Mode and precision of the fingerprints
+	kernel_precision_t precision;
+	uint64_t tilesBlended; // Over every call
+	uint64_t tilesReused;
+} blend_incremental_t;
+
+// Allocates the fingerprints of width x height images in tiles of
+// tileWidth x tileHeight pixels (0: the defaults above). The first blend
+// does every tile. Returns 0 on success and -1 if there is no memory.
+int blendIncrementalCreate(blend_incremental_t *state, uint width, uint height, uint tileWidth, uint tileHeight);
+
+// dst = Overlap(src, filter), reusing the tiles of dst whose source and
+// filter did not change since the last call with state. The three images
+// must have the size of state, and dst must not be src or filter (it keeps
+// the previous output). A change of destination buffer, blend mode or
+// precision blends every tile again, and so does the call after
+// blendIncrementalInvalidate (for a dst written by something else).
+// Returns 0 on success and -1 if the images do not match (errno is EINVAL).
+int blendImageIncremental(blend_context_t *ctx, blend_incremental_t *state, const blend_image_t *src,
+		const blend_image_t *filter, const blend_image_t *dst);
+
+// The next call blends every tile
+void blendIncrementalInvalidate(blend_incremental_t *state);
+
+// Fraction of the tiles reused over every call (0 before the first one)
+double blendIncrementalReuse(const blend_incremental_t *state);
+
+// Frees the fingerprints
+void blendIncrementalRelease(blend_incremental_t *state);
+
+#endif /* INCREMENTAL_H_ */
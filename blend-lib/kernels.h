@@ -0,0 +1,214 @@
+/*
+ * kernels.h
+ *
+ *  Created on: Fall 2022
+ */
+
+#ifndef KERNELS_H_
+#define KERNELS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+// Uncomment to keep the images as 8-bit integers from the BMP file to the
+// blend and back (1 byte per component instead of the 4 bytes of a float)
+
+//#define UINT8_PIPELINE
+
+// Data type for image components
+#ifdef UINT8_PIPELINE
+typedef uint8_t data_t;
+#else
+typedef float data_t;
+#endif
+
+// Our algorithm (Overlap) does not output saturated colors
+// given that the input images are also in the [0, 255] range,
+// however the definition below can be uncommented in order to
+// check the output. (note that the performance can be affected).
+
+//#define CHECK_COLOR_SATURATION
+
+// Filter argument data type (Includes source Image and Destination)
+typedef struct{
+	data_t *pRsrc; // Pointers to the R, G and B components
+	data_t *pGsrc;
+	data_t *pBsrc;
+	data_t *pRdst;
+	data_t *pGdst;
+	data_t *pBdst;
+	uint pixelCount; // Size of the image in pixels
+} filter_args_t;
+
+// Filter Image argument data type
+typedef struct{
+	data_t *pRfilter;
+	data_t *pGfilter;
+	data_t *pBfilter;
+	uint filterPixelCount; // Size of the filter in pixels
+} filter_image;
+
+// Arithmetic of the kernels of the blend modes
+typedef enum {
+	PRECISION_EXACT, // IEEE divisions, the reference output
+	PRECISION_APPROX, // Divisions replaced by refined reciprocal estimates (previews, thumbnails)
+	PRECISION_COUNT
+} kernel_precision_t;
+
+// Blends the pixels [pixelInit, pixelEnd) of the three channels.
+// Kernels never read or write outside that range.
+typedef void (*blend_kernel_t)(filter_args_t args0, filter_image args1, uint pixelInit, uint pixelEnd);
+
+// Instruction sets with a kernel, from the narrowest to the widest
+typedef enum {
+	KERNEL_SCALAR,
+	KERNEL_SSE2,
+	KERNEL_AVX2, // AVX2 + FMA
+	KERNEL_AVX512, // AVX-512 F + BW + VL
+	KERNEL_COUNT
+} kernel_isa_t;
+
+// Blend modes (see modes.h for the formulas)
+typedef enum {
+	BLEND_OVERLAP, // Overlap mode #10, the mode of the project
+	BLEND_MULTIPLY,
+	BLEND_SCREEN,
+	BLEND_OVERLAY,
+	BLEND_DARKEN,
+	BLEND_LIGHTEN,
+	BLEND_DODGE,
+	BLEND_BURN,
+	BLEND_SOFT_LIGHT,
+	BLEND_HARD_LIGHT,
+	BLEND_DIFFERENCE,
+	BLEND_EXCLUSION,
+	BLEND_MODE_COUNT
+} blend_mode_t;
+
+// Blends count components of one plane: dst[i] = Mode(src[i], filter[i])
+typedef void (*plane_kernel_t)(const data_t *src, const data_t *filter, data_t *dst, uint count);
+
+// Blends count 8-bit components. Every component goes through the same
+// formula, so this is valid for a plane as well as for interleaved BGR
+// data. Compiled whatever data_t is (used for the BMP files, which are
+// always 8-bit).
+typedef void (*byte_kernel_t)(const uint8_t *src, const uint8_t *filter, uint8_t *dst, uint count);
+
+// Blends count pixels of 4 interleaved 8-bit components, the fourth one
+// being alpha: the colour components are blended and the alpha of src is
+// kept, both in the same pass (BGRA or RGBA, see blend_frame_t in blend.h)
+typedef void (*rgba_kernel_t)(const uint8_t *src, const uint8_t *filter, uint8_t *dst, uint count);
+
+// Overlap of count components of one plane with a prepared filter (see
+// overlapPrepare): one multiply-add per component instead of two divisions.
+// With floats the multiply and the add are separate in every kernel, so
+// all of them store the values of the scalar one.
+typedef void (*prepared_kernel_t)(const data_t *src, const float *a, const float *b, data_t *dst, uint count);
+
+// Lanes of the fingerprints of hash_kernel_t, their keys and the step of
+// the keys from one stripe to the next (odd, from the digits of pi)
+#define HASH_LANES 8
+#define HASH_STEP 0x9216D5D98979FB1Bull
+
+extern const uint64_t HASH_KEY[HASH_LANES];
+
+// Adds the whole 64-byte stripes of bytes to the eight 64-bit lanes of acc
+// (for incremental.h): the word w of lane i of stripe s adds lo32(k) *
+// hi32(k), with k = w ^ (HASH_KEY[i] + s * HASH_STEP), to acc[i] and w to
+// acc[i ^ 1]. The key of every stripe differs, so moving a stripe changes
+// the lanes. Every instruction set gives the same lanes. Returns the bytes
+// added (a multiple of 64).
+typedef size_t (*hash_kernel_t)(const uint8_t *data, size_t bytes, uint64_t *acc);
+
+// Averages of count boxes of factor x rows components (factor 2, 4 or 8,
+// rows 1 to factor) for preview.h: box i starts at row[i * factor] and its
+// rows are stride components apart. The rows are added in order and then
+// the columns in pairs, so every instruction set gives the same averages
+// (rounded to the nearest integer in the 8-bit pipeline).
+typedef void (*box_kernel_t)(const data_t *row, size_t stride, uint rows, uint factor, data_t *boxes, uint count);
+
+// Kernels of one instruction set, one per blend mode (indexed by blend_mode_t)
+typedef struct {
+	blend_kernel_t range[BLEND_MODE_COUNT];
+	// Same as range, but the destination is written with non-temporal
+	// (streaming) stores that bypass the caches. Faster when the destination
+	// is much larger than the last-level cache: its lines are not read
+	// before being written and do not evict the source and filter. Slower
+	// when the destination is read again soon (it is no longer cached).
+	blend_kernel_t stream[BLEND_MODE_COUNT];
+	plane_kernel_t plane[BLEND_MODE_COUNT];
+	byte_kernel_t bytes[BLEND_MODE_COUNT];
+	rgba_kernel_t rgba[BLEND_MODE_COUNT];
+	prepared_kernel_t prepared; // Overlap only
+	hash_kernel_t hash; // Same for every mode and precision
+	box_kernel_t box; // Same
+} kernel_set_t;
+
+// One set per instruction set. Each one lives in its own file, compiled
+// with the flags of its instruction set (see the Makefile), so the rest of
+// the program runs on any x86-64 host. The scalar set has no streaming
+// stores (its stream kernels are the range ones).
+extern const kernel_set_t KERNELS_SCALAR;
+extern const kernel_set_t KERNELS_SSE2;
+extern const kernel_set_t KERNELS_AVX2;
+extern const kernel_set_t KERNELS_AVX512;
+
+// Same sets with PRECISION_APPROX (the prepared kernels, which do not
+// divide, are the exact ones)
+extern const kernel_set_t KERNELS_SCALAR_APPROX;
+extern const kernel_set_t KERNELS_SSE2_APPROX;
+extern const kernel_set_t KERNELS_AVX2_APPROX;
+extern const kernel_set_t KERNELS_AVX512_APPROX;
+
+// Name of the instruction set, as accepted by kernelFromName
+const char *kernelName(kernel_isa_t isa);
+
+// Parses a name ("scalar", "sse2", "avx2", "avx512"). Returns 0 on success and -1 otherwise
+int kernelFromName(const char *name, kernel_isa_t *isa);
+
+// Checks with cpuid whether the host can run the kernel
+bool kernelSupported(kernel_isa_t isa);
+
+// Widest kernel supported by the host
+kernel_isa_t kernelBest();
+
+// Kernels of an instruction set with a precision
+const kernel_set_t *kernelSet(kernel_isa_t isa, kernel_precision_t precision);
+
+// Kernels of an instruction set for a blend mode (see kernel_set_t), exact
+blend_kernel_t kernelFunction(kernel_isa_t isa, blend_mode_t mode);
+
+blend_kernel_t kernelStreamFunction(kernel_isa_t isa, blend_mode_t mode);
+
+plane_kernel_t planeKernelFunction(kernel_isa_t isa, blend_mode_t mode);
+
+byte_kernel_t byteKernelFunction(kernel_isa_t isa, blend_mode_t mode);
+
+rgba_kernel_t rgbaKernelFunction(kernel_isa_t isa, blend_mode_t mode);
+
+prepared_kernel_t preparedKernelFunction(kernel_isa_t isa);
+
+hash_kernel_t hashKernelFunction(kernel_isa_t isa);
+
+box_kernel_t boxKernelFunction(kernel_isa_t isa);
+
+// Overlap is affine in the source component X: a(Y) + b(Y) * X. Writes the
+// coefficients of count filter components. With UINT8_PIPELINE they are
+// scaled by 65025 (exact integers) and the kernels store
+// floor((a + b * X) / 65025), as the other 8-bit Overlap kernels.
+void overlapPrepare(const data_t *filter, float *a, float *b, uint count);
+
+// Name of the mode, as accepted by modeFromName
+const char *modeName(blend_mode_t mode);
+
+// Parses a name ("overlap", "multiply", "soft-light"...). Returns 0 on success and -1 otherwise
+int modeFromName(const char *name, blend_mode_t *mode);
+
+// Name of the precision, as accepted by precisionFromName
+const char *precisionName(kernel_precision_t precision);
+
+// Parses a name ("exact", "approx"). Returns 0 on success and -1 otherwise
+int precisionFromName(const char *name, kernel_precision_t *precision);
+
+#endif /* KERNELS_H_ */
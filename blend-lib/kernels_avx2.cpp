@@ -0,0 +1,415 @@
+/*
+ * kernels_avx2.cpp
+ *
+ *  Created on: Fall 2022
+ */
+
+#include <immintrin.h> // Required to use intrinsic functions
+#include "kernels.h"
+#include "modes.h"
+
+// Compiled with -mavx2 -mfma. Only called when the host supports both.
+// Note: vector constants are built inside the functions. A global
+// initialized with an intrinsic would run at start-up on every host.
+
+// Operations of the blend modes on packets of 8 floats (see modes.h).
+// fmadd is fused; the exact modes use separate operations instead (see
+// modes.h).
+struct OpsAVX2 {
+	typedef __m256 vec;
+	typedef __m256 mask;
+
+	static vec set1(float f){ return _mm256_set1_ps(f); }
+	static vec add(vec a, vec b){ return _mm256_add_ps(a, b); }
+	static vec sub(vec a, vec b){ return _mm256_sub_ps(a, b); }
+	static vec mul(vec a, vec b){ return _mm256_mul_ps(a, b); }
+	static vec div(vec a, vec b){ return _mm256_div_ps(a, b); }
+	static vec min(vec a, vec b){ return _mm256_min_ps(a, b); }
+	static vec max(vec a, vec b){ return _mm256_max_ps(a, b); }
+	static vec fmadd(vec a, vec b, vec c){ return _mm256_fmadd_ps(a, b, c); }
+	static mask lt(vec a, vec b){ return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+	static mask gt(vec a, vec b){ return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+	static vec select(mask m, vec a, vec b){ return _mm256_blendv_ps(b, a, m); }
+	// 12-bit estimate, r * (2 - a * r) (fused) doubles its bits
+	static vec rcp(vec a){
+		vec r = _mm256_rcp_ps(a);
+		return _mm256_mul_ps(r, _mm256_fnmadd_ps(a, r, _mm256_set1_ps(2.0f)));
+	}
+};
+
+#ifndef UINT8_PIPELINE
+
+#define ITEMS_PER_PACKET (sizeof(__m256)/sizeof(data_t))
+
+// Whole packets use unaligned loads/stores; the tail (less than a packet)
+// uses masked loads/stores so nothing outside the range is read or written.
+template<class Mode> static void blendRangeAVX2(filter_args_t args0, filter_image args1, uint pixelInit, uint pixelEnd){
+	uint i = pixelInit;
+
+	for (; i + ITEMS_PER_PACKET <= pixelEnd; i += ITEMS_PER_PACKET){
+		_mm256_storeu_ps(args0.pRdst + i, blendVec<Mode, OpsAVX2>(_mm256_loadu_ps(args0.pRsrc + i), _mm256_loadu_ps(args1.pRfilter + i)));
+		_mm256_storeu_ps(args0.pGdst + i, blendVec<Mode, OpsAVX2>(_mm256_loadu_ps(args0.pGsrc + i), _mm256_loadu_ps(args1.pGfilter + i)));
+		_mm256_storeu_ps(args0.pBdst + i, blendVec<Mode, OpsAVX2>(_mm256_loadu_ps(args0.pBsrc + i), _mm256_loadu_ps(args1.pBfilter + i)));
+	}
+
+	if (i < pixelEnd){
+		// Lanes with an index lower than the number of pixels left are enabled
+		__m256i vMask = _mm256_cmpgt_epi32(_mm256_set1_epi32(pixelEnd - i), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+
+		_mm256_maskstore_ps(args0.pRdst + i, vMask, blendVec<Mode, OpsAVX2>(_mm256_maskload_ps(args0.pRsrc + i, vMask), _mm256_maskload_ps(args1.pRfilter + i, vMask)));
+		_mm256_maskstore_ps(args0.pGdst + i, vMask, blendVec<Mode, OpsAVX2>(_mm256_maskload_ps(args0.pGsrc + i, vMask), _mm256_maskload_ps(args1.pGfilter + i, vMask)));
+		_mm256_maskstore_ps(args0.pBdst + i, vMask, blendVec<Mode, OpsAVX2>(_mm256_maskload_ps(args0.pBsrc + i, vMask), _mm256_maskload_ps(args1.pBfilter + i, vMask)));
+	}
+}
+
+template<class Mode> static void blendPlaneAVX2(const data_t *src, const data_t *filter, data_t *dst, uint count){
+	uint i = 0;
+
+	for (; i + ITEMS_PER_PACKET <= count; i += ITEMS_PER_PACKET){
+		_mm256_storeu_ps(dst + i, blendVec<Mode, OpsAVX2>(_mm256_loadu_ps(src + i), _mm256_loadu_ps(filter + i)));
+	}
+
+	SCALAR_KERNELS(Mode).plane[Mode::ID](src + i, filter + i, dst + i, count - i);
+}
+
+#endif
+
+// Bytes of a 8-bit packet: 16 bytes are widened to 16-bit lanes
+#define BYTES_PER_PACKET (sizeof(__m128i))
+
+// Mode of one packet of 16 pixels: widened to floats, blended as in the
+// float pipeline and truncated
+template<class Mode> static inline __m128i blendBytePacket(__m128i vSource, __m128i vFilter){
+	__m256 vLo = blendVec<Mode, OpsAVX2>(_mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(vSource)), _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(vFilter)));
+	__m256 vHi = blendVec<Mode, OpsAVX2>(_mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_srli_si128(vSource, 8))),
+			_mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_srli_si128(vFilter, 8))));
+
+	// The pack works inside each 128-bit lane: the permute restores the order
+	__m256i v16 = _mm256_permute4x64_epi64(_mm256_packus_epi32(_mm256_cvttps_epi32(vLo), _mm256_cvttps_epi32(vHi)), 0xD8);
+
+	return _mm_packus_epi16(_mm256_castsi256_si128(v16), _mm256_extracti128_si256(v16, 1));
+}
+
+// With integer inputs the Overlap formula is exactly N / 65025, where
+// N = Y * (255 * Y + 2 * X * (255 - Y)) = (15Y)(17Y) + (2X)(Y(255 - Y)).
+// Every factor of the second form fits in a signed 16-bit lane, so one
+// _mm256_madd_epi16 gives N in 32 bits (N < 2^24, exact as a float).
+// Truncating N * (1 / 65025) gives floor(N / 65025) for all 256x256 inputs,
+// which is also what the float version stores in the BMP file.
+static inline __m256i overlapQuotient(__m256i vA, __m256i vB){
+	__m256i vN = _mm256_madd_epi16(vA, vB);
+
+	return _mm256_cvttps_epi32(_mm256_mul_ps(_mm256_cvtepi32_ps(vN), _mm256_set1_ps(1.0f / 65025.0f)));
+}
+
+// Overlap of one packet of 16 pixels, with the exact integer form
+template<> inline __m128i blendBytePacket<ModeOverlap>(__m128i vSource, __m128i vFilter){
+	__m256i vX = _mm256_cvtepu8_epi16(vSource);
+	__m256i vY = _mm256_cvtepu8_epi16(vFilter);
+	__m256i vY15 = _mm256_mullo_epi16(vY, _mm256_set1_epi16(15));
+	__m256i vY17 = _mm256_mullo_epi16(vY, _mm256_set1_epi16(17));
+	__m256i vX2 = _mm256_add_epi16(vX, vX);
+	__m256i vYY = _mm256_mullo_epi16(vY, _mm256_sub_epi16(_mm256_set1_epi16(255), vY));
+
+	// Pairs (15Y, 2X) and (17Y, Y(255 - Y)) for the multiply-add
+	__m256i vLo = overlapQuotient(_mm256_unpacklo_epi16(vY15, vX2), _mm256_unpacklo_epi16(vY17, vYY));
+	__m256i vHi = overlapQuotient(_mm256_unpackhi_epi16(vY15, vX2), _mm256_unpackhi_epi16(vY17, vYY));
+
+	// Back to 16 and then 8 bits (saturating) in the original order
+	__m256i v16 = _mm256_packus_epi32(vLo, vHi);
+	__m256i v8 = _mm256_permute4x64_epi64(_mm256_packus_epi16(v16, v16), 0x08);
+
+	return _mm256_castsi256_si128(v8);
+}
+
+// Flat run of count 8-bit components (planar, or interleaved without alpha)
+template<class Mode> static void blendBytesAVX2(const uint8_t *src, const uint8_t *filter, uint8_t *dst, uint count){
+	uint i = 0;
+
+	for (; i + BYTES_PER_PACKET <= count; i += BYTES_PER_PACKET){
+		_mm_storeu_si128((__m128i *)(dst + i), blendBytePacket<Mode>(_mm_loadu_si128((const __m128i *)(src + i)), _mm_loadu_si128((const __m128i *)(filter + i))));
+	}
+
+	// The tail goes through the scalar kernel
+	SCALAR_KERNELS(Mode).bytes[Mode::ID](src + i, filter + i, dst + i, count - i);
+}
+
+// Interleaved pixels with alpha, 4 per packet: the alpha bytes of the
+// source are selected back by a byte blend
+template<class Mode> static void blendRgbaAVX2(const uint8_t *src, const uint8_t *filter, uint8_t *dst, uint count){
+	const __m128i vAlpha = _mm_set1_epi32(0xFF000000);
+	uint i = 0;
+
+	for (; i + BYTES_PER_PACKET / 4 <= count; i += BYTES_PER_PACKET / 4){
+		__m128i vSource = _mm_loadu_si128((const __m128i *)(src + 4 * i));
+		__m128i vColor = blendBytePacket<Mode>(vSource, _mm_loadu_si128((const __m128i *)(filter + 4 * i)));
+		_mm_storeu_si128((__m128i *)(dst + 4 * i), _mm_blendv_epi8(vColor, vSource, vAlpha));
+	}
+
+	SCALAR_KERNELS(Mode).rgba[Mode::ID](src + 4 * i, filter + 4 * i, dst + 4 * i, count - i);
+}
+
+#ifdef UINT8_PIPELINE
+
+// Packets of 16 bytes go through AVX2; the tail goes through the scalar kernel
+template<class Mode> static void blendRangeAVX2(filter_args_t args0, filter_image args1, uint pixelInit, uint pixelEnd){
+	uint i = pixelInit;
+
+	for (; i + BYTES_PER_PACKET <= pixelEnd; i += BYTES_PER_PACKET){
+		_mm_storeu_si128((__m128i *)(args0.pRdst + i), blendBytePacket<Mode>(_mm_loadu_si128((__m128i *)(args0.pRsrc + i)), _mm_loadu_si128((__m128i *)(args1.pRfilter + i))));
+		_mm_storeu_si128((__m128i *)(args0.pGdst + i), blendBytePacket<Mode>(_mm_loadu_si128((__m128i *)(args0.pGsrc + i)), _mm_loadu_si128((__m128i *)(args1.pGfilter + i))));
+		_mm_storeu_si128((__m128i *)(args0.pBdst + i), blendBytePacket<Mode>(_mm_loadu_si128((__m128i *)(args0.pBsrc + i)), _mm_loadu_si128((__m128i *)(args1.pBfilter + i))));
+	}
+
+	SCALAR_KERNELS(Mode).range[Mode::ID](args0, args1, i, pixelEnd);
+}
+
+// 8-bit planes are flat runs of bytes
+template<class Mode> static void blendPlaneAVX2(const data_t *src, const data_t *filter, data_t *dst, uint count){
+	blendBytesAVX2<Mode>(src, filter, dst, count);
+}
+
+#endif
+
+// Non-temporal version (see kernels.h). Every plane of the range is
+// blended on its own so that the stores can be aligned; the items before
+// the first aligned one and the tail go through the scalar kernel.
+#ifndef UINT8_PIPELINE
+#define STREAM_ITEMS ITEMS_PER_PACKET
+#else
+#define STREAM_ITEMS BYTES_PER_PACKET
+#endif
+
+template<class Mode> static inline void streamPacket(data_t *dst, const data_t *src, const data_t *filter){
+#ifndef UINT8_PIPELINE
+	_mm256_stream_ps(dst, blendVec<Mode, OpsAVX2>(_mm256_loadu_ps(src), _mm256_loadu_ps(filter)));
+#else
+	_mm_stream_si128((__m128i *)dst, blendBytePacket<Mode>(_mm_loadu_si128((const __m128i *)src), _mm_loadu_si128((const __m128i *)filter)));
+#endif
+}
+
+template<class Mode> static void streamPlane(const data_t *src, const data_t *filter, data_t *dst, uint count){
+	const uintptr_t alignment = STREAM_ITEMS * sizeof(data_t);
+	uint i = (alignment - (uintptr_t)dst % alignment) % alignment / sizeof(data_t);
+
+	i = (i < count) ? i : count;
+	SCALAR_KERNELS(Mode).plane[Mode::ID](src, filter, dst, i);
+
+	for (; i + STREAM_ITEMS <= count; i += STREAM_ITEMS){
+		streamPacket<Mode>(dst + i, src + i, filter + i);
+	}
+
+	SCALAR_KERNELS(Mode).plane[Mode::ID](src + i, filter + i, dst + i, count - i);
+}
+
+template<class Mode> static void blendRangeStreamAVX2(filter_args_t args0, filter_image args1, uint pixelInit, uint pixelEnd){
+	uint count = pixelEnd - pixelInit;
+
+	streamPlane<Mode>(args0.pRsrc + pixelInit, args1.pRfilter + pixelInit, args0.pRdst + pixelInit, count);
+	streamPlane<Mode>(args0.pGsrc + pixelInit, args1.pGfilter + pixelInit, args0.pGdst + pixelInit, count);
+	streamPlane<Mode>(args0.pBsrc + pixelInit, args1.pBfilter + pixelInit, args0.pBdst + pixelInit, count);
+
+	// Streaming stores are weakly ordered: they must be complete before
+	// the job is reported as done
+	_mm_sfence();
+}
+
+// Overlap with a prepared filter (see kernels.h)
+#ifndef UINT8_PIPELINE
+
+static void blendPreparedAVX2(const data_t *src, const float *a, const float *b, data_t *dst, uint count){
+	uint i = 0;
+
+	for (; i + ITEMS_PER_PACKET <= count; i += ITEMS_PER_PACKET){
+		// Not fused: the same values as the scalar tail
+		__m256 vZ = _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(b + i), _mm256_loadu_ps(src + i)), _mm256_loadu_ps(a + i));
+		#ifdef CHECK_COLOR_SATURATION
+		vZ = _mm256_max_ps(_mm256_min_ps(vZ, _mm256_set1_ps(255.0f)), _mm256_setzero_ps());
+		#endif
+		_mm256_storeu_ps(dst + i, vZ);
+	}
+
+	KERNELS_SCALAR.prepared(src + i, a + i, b + i, dst + i, count - i);
+}
+
+#else
+
+// floor((a + b * X) / 65025) of eight components, as 16-bit lanes
+static inline __m128i preparedHalf(const uint8_t *src, const float *a, const float *b){
+	__m256 vX = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)src)));
+	__m256 vN = OpsAVX2::fmadd(_mm256_loadu_ps(b), vX, _mm256_loadu_ps(a));
+	__m256i vZ = _mm256_cvttps_epi32(_mm256_mul_ps(vN, _mm256_set1_ps(1.0f / 65025.0f)));
+
+	return _mm_packus_epi32(_mm256_castsi256_si128(vZ), _mm256_extracti128_si256(vZ, 1));
+}
+
+static void blendPreparedAVX2(const data_t *src, const float *a, const float *b, data_t *dst, uint count){
+	uint i = 0;
+
+	for (; i + BYTES_PER_PACKET <= count; i += BYTES_PER_PACKET){
+		__m128i vLo = preparedHalf(src + i, a + i, b + i);
+		__m128i vHi = preparedHalf(src + i + 8, a + i + 8, b + i + 8);
+		_mm_storeu_si128((__m128i *)(dst + i), _mm_packus_epi16(vLo, vHi));
+	}
+
+	KERNELS_SCALAR.prepared(src + i, a + i, b + i, dst + i, count - i);
+}
+
+#endif
+
+// Fingerprint stripes (see hash_kernel_t): four lanes per register
+static size_t hashAVX2(const uint8_t *data, size_t bytes, uint64_t *acc){
+	size_t stripes = bytes / (HASH_LANES * sizeof(uint64_t));
+	__m256i vAcc[2], vKey[2];
+	__m256i vStep = _mm256_set1_epi64x(HASH_STEP);
+
+	for (uint j = 0; j < 2; j++){
+		vAcc[j] = _mm256_loadu_si256((const __m256i *)(acc + 4 * j));
+		vKey[j] = _mm256_loadu_si256((const __m256i *)(HASH_KEY + 4 * j));
+	}
+	for (size_t s = 0; s < stripes; s++, data += HASH_LANES * sizeof(uint64_t)){
+		for (uint j = 0; j < 2; j++){
+			__m256i vW = _mm256_loadu_si256((const __m256i *)data + j);
+			__m256i vK = _mm256_xor_si256(vW, vKey[j]);
+			__m256i vProduct = _mm256_mul_epu32(vK, _mm256_srli_epi64(vK, 32));
+			// Words of the neighbour lanes: acc[i ^ 1] += w
+			__m256i vSwapped = _mm256_shuffle_epi32(vW, _MM_SHUFFLE(1, 0, 3, 2));
+			vAcc[j] = _mm256_add_epi64(vAcc[j], _mm256_add_epi64(vProduct, vSwapped));
+			vKey[j] = _mm256_add_epi64(vKey[j], vStep);
+		}
+	}
+	for (uint j = 0; j < 2; j++){
+		_mm256_storeu_si256((__m256i *)(acc + 4 * j), vAcc[j]);
+	}
+	return stripes * HASH_LANES * sizeof(uint64_t);
+}
+
+// Sums of the neighbour lanes: a0 + a1, a2 + a3... then b0 + b1... The
+// shuffles add within 128-bit halves, the permutation puts them in order
+static inline __m256 pairSums(__m256 a, __m256 b){
+	__m256 vSum = _mm256_add_ps(_mm256_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)), _mm256_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+
+	return _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(vSum), _MM_SHUFFLE(3, 1, 2, 0)));
+}
+
+// Box averages (see box_kernel_t) of blocks of 64 components, four
+// registers of sums once the neighbours of every lane are added
+template<uint FACTOR> static void boxFactorAVX2(const data_t *row, size_t stride, uint rows, data_t *boxes, uint count){
+	const uint boxesPerBlock = 64 / FACTOR;
+	__m256 vScale = _mm256_set1_ps(1.0f / (FACTOR * rows));
+	uint i = 0;
+
+	for (; i + boxesPerBlock <= count; i += boxesPerBlock){
+		const data_t *block = row + i * FACTOR;
+		__m256 vSum[4];
+	#ifndef UINT8_PIPELINE
+		__m256 vRows[8];
+
+		for (uint j = 0; j < 8; j++){
+			vRows[j] = _mm256_loadu_ps(block + 8 * j);
+		}
+		for (uint y = 1; y < rows; y++){
+			for (uint j = 0; j < 8; j++){
+				vRows[j] = _mm256_add_ps(vRows[j], _mm256_loadu_ps(block + y * stride + 8 * j));
+			}
+		}
+		for (uint j = 0; j < 4; j++){
+			vSum[j] = pairSums(vRows[2 * j], vRows[2 * j + 1]);
+		}
+		uint width = 2, n = 4; // Columns per lane, registers
+	#else
+		// Sums of the pairs of columns in 16 bits (8 rows of 2 * 255)
+		const __m256i vOnes = _mm256_set1_epi8(1);
+		__m256i vPairs[2];
+
+		for (uint j = 0; j < 2; j++){
+			vPairs[j] = _mm256_maddubs_epi16(_mm256_loadu_si256((const __m256i *)(block + 32 * j)), vOnes);
+		}
+		for (uint y = 1; y < rows; y++){
+			for (uint j = 0; j < 2; j++){
+				vPairs[j] = _mm256_add_epi16(vPairs[j], _mm256_maddubs_epi16(_mm256_loadu_si256((const __m256i *)(block + y * stride + 32 * j)), vOnes));
+			}
+		}
+		if (FACTOR == 2){
+			// 2 * rows is a power of two: the rounded shift gives the
+			// average of the floats, without converting to them
+			uint shift = (rows == 2) ? 2 : 1;
+			__m256i vRound = _mm256_set1_epi16(1 << (shift - 1));
+			__m256i vLo = _mm256_srli_epi16(_mm256_add_epi16(vPairs[0], vRound), shift);
+			__m256i vHi = _mm256_srli_epi16(_mm256_add_epi16(vPairs[1], vRound), shift);
+			// The pack works inside each 128-bit lane: the permute restores the order
+			_mm256_storeu_si256((__m256i *)(boxes + i), _mm256_permute4x64_epi64(_mm256_packus_epi16(vLo, vHi), 0xD8));
+			continue;
+		}
+		// Pairs of pairs in 32 bits, in two registers
+		for (uint j = 0; j < 2; j++){
+			vSum[j] = _mm256_cvtepi32_ps(_mm256_madd_epi16(vPairs[j], _mm256_set1_epi16(1)));
+		}
+		uint width = 4, n = 2;
+	#endif
+		// Pairs of pairs up to the width of a box (exact for 8-bit sums)
+		for (; width < FACTOR; width *= 2, n /= 2){
+			for (uint j = 0; j < n / 2; j++){
+				vSum[j] = pairSums(vSum[2 * j], vSum[2 * j + 1]);
+			}
+		}
+	#ifndef UINT8_PIPELINE
+		for (uint j = 0; j < n; j++){
+			_mm256_storeu_ps(boxes + i + 8 * j, _mm256_mul_ps(vSum[j], vScale));
+		}
+	#else
+		__m256i vBox[4];
+		for (uint j = 0; j < 4; j++){
+			vBox[j] = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(vSum[(j < n) ? j : 0], vScale), _mm256_set1_ps(0.5f)));
+		}
+		// The packs work within 128-bit halves: groups of 4 bytes back in order
+		__m256i vBytes = _mm256_packus_epi16(_mm256_packs_epi32(vBox[0], vBox[1]), _mm256_packs_epi32(vBox[2], vBox[3]));
+		vBytes = _mm256_permutevar8x32_epi32(vBytes, _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7));
+		if (n == 4){
+			_mm256_storeu_si256((__m256i *)(boxes + i), vBytes);
+		} else if (n == 2){
+			_mm_storeu_si128((__m128i *)(boxes + i), _mm256_castsi256_si128(vBytes));
+		} else {
+			_mm_storel_epi64((__m128i *)(boxes + i), _mm256_castsi256_si128(vBytes));
+		}
+	#endif
+	}
+
+	KERNELS_SCALAR.box(row + i * FACTOR, stride, rows, FACTOR, boxes + i, count - i);
+}
+
+static void boxAVX2(const data_t *row, size_t stride, uint rows, uint factor, data_t *boxes, uint count){
+
+	switch (factor){
+	case 2:
+		boxFactorAVX2<2>(row, stride, rows, boxes, count);
+		break;
+	case 4:
+		boxFactorAVX2<4>(row, stride, rows, boxes, count);
+		break;
+	default:
+		boxFactorAVX2<8>(row, stride, rows, boxes, count);
+	}
+}
+
+const kernel_set_t KERNELS_AVX2 = {
+	MODE_TABLE(blendRangeAVX2),
+	MODE_TABLE(blendRangeStreamAVX2),
+	MODE_TABLE(blendPlaneAVX2),
+	MODE_TABLE(blendBytesAVX2),
+	MODE_TABLE(blendRgbaAVX2),
+	blendPreparedAVX2,
+	hashAVX2,
+	boxAVX2
+};
+
+const kernel_set_t KERNELS_AVX2_APPROX = {
+	MODE_TABLE_APPROX(blendRangeAVX2),
+	MODE_TABLE_APPROX(blendRangeStreamAVX2),
+	MODE_TABLE_APPROX(blendPlaneAVX2),
+	MODE_TABLE_APPROX(blendBytesAVX2),
+	MODE_TABLE_APPROX(blendRgbaAVX2),
+	blendPreparedAVX2,
+	hashAVX2,
+	boxAVX2
+};
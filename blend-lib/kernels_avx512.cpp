@@ -0,0 +1,413 @@
+/*
+ * kernels_avx512.cpp
+ *
+ *  Created on: Fall 2022
+ */
+
+#include <immintrin.h> // Required to use intrinsic functions
+#include "kernels.h"
+#include "modes.h"
+
+// Compiled with -mavx512f -mavx512bw -mavx512vl. Only called when the host
+// supports the three of them. The tail of every range uses mask registers,
+// so there is no scalar loop at all.
+// Note: vector constants are built inside the functions. A global
+// initialized with an intrinsic would run at start-up on every host.
+
+// Operations of the blend modes on packets of 16 floats (see modes.h)
+struct OpsAVX512 {
+	typedef __m512 vec;
+	typedef __mmask16 mask;
+
+	static vec set1(float f){ return _mm512_set1_ps(f); }
+	static vec add(vec a, vec b){ return _mm512_add_ps(a, b); }
+	static vec sub(vec a, vec b){ return _mm512_sub_ps(a, b); }
+	static vec mul(vec a, vec b){ return _mm512_mul_ps(a, b); }
+	static vec div(vec a, vec b){ return _mm512_div_ps(a, b); }
+	static vec min(vec a, vec b){ return _mm512_min_ps(a, b); }
+	static vec max(vec a, vec b){ return _mm512_max_ps(a, b); }
+	static vec fmadd(vec a, vec b, vec c){ return _mm512_fmadd_ps(a, b, c); }
+	static mask lt(vec a, vec b){ return _mm512_cmp_ps_mask(a, b, _CMP_LT_OQ); }
+	static mask gt(vec a, vec b){ return _mm512_cmp_ps_mask(a, b, _CMP_GT_OQ); }
+	static vec select(mask m, vec a, vec b){ return _mm512_mask_blend_ps(m, b, a); }
+	// 14-bit estimate, r * (2 - a * r) (fused) brings it to the float precision
+	static vec rcp(vec a){
+		vec r = _mm512_rcp14_ps(a);
+		return _mm512_mul_ps(r, _mm512_fnmadd_ps(a, r, _mm512_set1_ps(2.0f)));
+	}
+};
+
+#ifndef UINT8_PIPELINE
+
+#define ITEMS_PER_PACKET (sizeof(__m512)/sizeof(data_t))
+
+template<class Mode> static void blendRangeAVX512(filter_args_t args0, filter_image args1, uint pixelInit, uint pixelEnd){
+	uint i = pixelInit;
+
+	for (; i + ITEMS_PER_PACKET <= pixelEnd; i += ITEMS_PER_PACKET){
+		_mm512_storeu_ps(args0.pRdst + i, blendVec<Mode, OpsAVX512>(_mm512_loadu_ps(args0.pRsrc + i), _mm512_loadu_ps(args1.pRfilter + i)));
+		_mm512_storeu_ps(args0.pGdst + i, blendVec<Mode, OpsAVX512>(_mm512_loadu_ps(args0.pGsrc + i), _mm512_loadu_ps(args1.pGfilter + i)));
+		_mm512_storeu_ps(args0.pBdst + i, blendVec<Mode, OpsAVX512>(_mm512_loadu_ps(args0.pBsrc + i), _mm512_loadu_ps(args1.pBfilter + i)));
+	}
+
+	if (i < pixelEnd){
+		// One bit per pixel left
+		__mmask16 mask = (__mmask16)((1u << (pixelEnd - i)) - 1);
+
+		_mm512_mask_storeu_ps(args0.pRdst + i, mask, blendVec<Mode, OpsAVX512>(_mm512_maskz_loadu_ps(mask, args0.pRsrc + i), _mm512_maskz_loadu_ps(mask, args1.pRfilter + i)));
+		_mm512_mask_storeu_ps(args0.pGdst + i, mask, blendVec<Mode, OpsAVX512>(_mm512_maskz_loadu_ps(mask, args0.pGsrc + i), _mm512_maskz_loadu_ps(mask, args1.pGfilter + i)));
+		_mm512_mask_storeu_ps(args0.pBdst + i, mask, blendVec<Mode, OpsAVX512>(_mm512_maskz_loadu_ps(mask, args0.pBsrc + i), _mm512_maskz_loadu_ps(mask, args1.pBfilter + i)));
+	}
+}
+
+template<class Mode> static void blendPlaneAVX512(const data_t *src, const data_t *filter, data_t *dst, uint count){
+	uint i = 0;
+
+	for (; i + ITEMS_PER_PACKET <= count; i += ITEMS_PER_PACKET){
+		_mm512_storeu_ps(dst + i, blendVec<Mode, OpsAVX512>(_mm512_loadu_ps(src + i), _mm512_loadu_ps(filter + i)));
+	}
+
+	if (i < count){
+		__mmask16 mask = (__mmask16)((1u << (count - i)) - 1);
+
+		_mm512_mask_storeu_ps(dst + i, mask, blendVec<Mode, OpsAVX512>(_mm512_maskz_loadu_ps(mask, src + i), _mm512_maskz_loadu_ps(mask, filter + i)));
+	}
+}
+
+#endif
+
+// Bytes of a 8-bit packet: 32 bytes are widened to 16-bit lanes
+#define BYTES_PER_PACKET (sizeof(__m256i))
+
+// Mode of 16 pixels: widened to floats, blended as in the float pipeline
+// and truncated (negative values saturate to 0, not to 255)
+template<class Mode> static inline __m128i blendByteQuarter(__m128i vSource, __m128i vFilter){
+	__m512 vZ = blendVec<Mode, OpsAVX512>(_mm512_cvtepi32_ps(_mm512_cvtepu8_epi32(vSource)), _mm512_cvtepi32_ps(_mm512_cvtepu8_epi32(vFilter)));
+
+	return _mm512_cvtusepi32_epi8(_mm512_max_epi32(_mm512_cvttps_epi32(vZ), _mm512_setzero_si512()));
+}
+
+// Mode of one packet of 32 pixels
+template<class Mode> static inline __m256i blendBytePacket(__m256i vSource, __m256i vFilter){
+	__m128i vLo = blendByteQuarter<Mode>(_mm256_castsi256_si128(vSource), _mm256_castsi256_si128(vFilter));
+	__m128i vHi = blendByteQuarter<Mode>(_mm256_extracti128_si256(vSource, 1), _mm256_extracti128_si256(vFilter, 1));
+
+	return _mm256_inserti128_si256(_mm256_castsi128_si256(vLo), vHi, 1);
+}
+
+// floor(N / 65025) of sixteen 32-bit numerators (see kernels_avx2.cpp)
+static inline __m512i overlapQuotient(__m512i vA, __m512i vB){
+	__m512i vN = _mm512_madd_epi16(vA, vB);
+
+	return _mm512_cvttps_epi32(_mm512_mul_ps(_mm512_cvtepi32_ps(vN), _mm512_set1_ps(1.0f / 65025.0f)));
+}
+
+// Overlap of one packet of 32 pixels, with the exact integer form
+template<> inline __m256i blendBytePacket<ModeOverlap>(__m256i vSource, __m256i vFilter){
+	__m512i vX = _mm512_cvtepu8_epi16(vSource);
+	__m512i vY = _mm512_cvtepu8_epi16(vFilter);
+	__m512i vY15 = _mm512_mullo_epi16(vY, _mm512_set1_epi16(15));
+	__m512i vY17 = _mm512_mullo_epi16(vY, _mm512_set1_epi16(17));
+	__m512i vX2 = _mm512_add_epi16(vX, vX);
+	__m512i vYY = _mm512_mullo_epi16(vY, _mm512_sub_epi16(_mm512_set1_epi16(255), vY));
+
+	// Pairs (15Y, 2X) and (17Y, Y(255 - Y)) for the multiply-add
+	__m512i vLo = overlapQuotient(_mm512_unpacklo_epi16(vY15, vX2), _mm512_unpacklo_epi16(vY17, vYY));
+	__m512i vHi = overlapQuotient(_mm512_unpackhi_epi16(vY15, vX2), _mm512_unpackhi_epi16(vY17, vYY));
+
+	// The pack undoes the in-lane interleaving of the unpacks
+	return _mm512_cvtepi16_epi8(_mm512_packus_epi32(vLo, vHi));
+}
+
+// Flat run of count 8-bit components (planar, or interleaved without alpha)
+template<class Mode> static void blendBytesAVX512(const uint8_t *src, const uint8_t *filter, uint8_t *dst, uint count){
+	uint i = 0;
+
+	for (; i + BYTES_PER_PACKET <= count; i += BYTES_PER_PACKET){
+		_mm256_storeu_si256((__m256i *)(dst + i), blendBytePacket<Mode>(_mm256_loadu_si256((const __m256i *)(src + i)), _mm256_loadu_si256((const __m256i *)(filter + i))));
+	}
+
+	if (i < count){
+		// One bit per byte left
+		__mmask32 mask = (__mmask32)((1u << (count - i)) - 1);
+
+		_mm256_mask_storeu_epi8(dst + i, mask, blendBytePacket<Mode>(_mm256_maskz_loadu_epi8(mask, src + i), _mm256_maskz_loadu_epi8(mask, filter + i)));
+	}
+}
+
+// Interleaved pixels with alpha, 8 per packet: the alpha bytes of the
+// source are selected back through a mask register
+template<class Mode> static void blendRgbaAVX512(const uint8_t *src, const uint8_t *filter, uint8_t *dst, uint count){
+	const __mmask32 alpha = 0x88888888;
+	uint i = 0;
+
+	for (; i + BYTES_PER_PACKET / 4 <= count; i += BYTES_PER_PACKET / 4){
+		__m256i vSource = _mm256_loadu_si256((const __m256i *)(src + 4 * i));
+		__m256i vColor = blendBytePacket<Mode>(vSource, _mm256_loadu_si256((const __m256i *)(filter + 4 * i)));
+		_mm256_storeu_si256((__m256i *)(dst + 4 * i), _mm256_mask_blend_epi8(alpha, vColor, vSource));
+	}
+
+	if (i < count){
+		// One bit per byte left
+		__mmask32 mask = (__mmask32)((1u << (4 * (count - i))) - 1);
+		__m256i vSource = _mm256_maskz_loadu_epi8(mask, src + 4 * i);
+		__m256i vColor = blendBytePacket<Mode>(vSource, _mm256_maskz_loadu_epi8(mask, filter + 4 * i));
+
+		_mm256_mask_storeu_epi8(dst + 4 * i, mask, _mm256_mask_blend_epi8(alpha, vColor, vSource));
+	}
+}
+
+#ifdef UINT8_PIPELINE
+
+template<class Mode> static void blendRangeAVX512(filter_args_t args0, filter_image args1, uint pixelInit, uint pixelEnd){
+	uint i = pixelInit;
+
+	for (; i + BYTES_PER_PACKET <= pixelEnd; i += BYTES_PER_PACKET){
+		_mm256_storeu_si256((__m256i *)(args0.pRdst + i), blendBytePacket<Mode>(_mm256_loadu_si256((__m256i *)(args0.pRsrc + i)), _mm256_loadu_si256((__m256i *)(args1.pRfilter + i))));
+		_mm256_storeu_si256((__m256i *)(args0.pGdst + i), blendBytePacket<Mode>(_mm256_loadu_si256((__m256i *)(args0.pGsrc + i)), _mm256_loadu_si256((__m256i *)(args1.pGfilter + i))));
+		_mm256_storeu_si256((__m256i *)(args0.pBdst + i), blendBytePacket<Mode>(_mm256_loadu_si256((__m256i *)(args0.pBsrc + i)), _mm256_loadu_si256((__m256i *)(args1.pBfilter + i))));
+	}
+
+	if (i < pixelEnd){
+		// One bit per pixel left
+		__mmask32 mask = (__mmask32)((1u << (pixelEnd - i)) - 1);
+
+		_mm256_mask_storeu_epi8(args0.pRdst + i, mask, blendBytePacket<Mode>(_mm256_maskz_loadu_epi8(mask, args0.pRsrc + i), _mm256_maskz_loadu_epi8(mask, args1.pRfilter + i)));
+		_mm256_mask_storeu_epi8(args0.pGdst + i, mask, blendBytePacket<Mode>(_mm256_maskz_loadu_epi8(mask, args0.pGsrc + i), _mm256_maskz_loadu_epi8(mask, args1.pGfilter + i)));
+		_mm256_mask_storeu_epi8(args0.pBdst + i, mask, blendBytePacket<Mode>(_mm256_maskz_loadu_epi8(mask, args0.pBsrc + i), _mm256_maskz_loadu_epi8(mask, args1.pBfilter + i)));
+	}
+}
+
+// 8-bit planes are flat runs of bytes
+template<class Mode> static void blendPlaneAVX512(const data_t *src, const data_t *filter, data_t *dst, uint count){
+	blendBytesAVX512<Mode>(src, filter, dst, count);
+}
+
+#endif
+
+// Non-temporal version (see kernels.h). Every plane of the range is
+// blended on its own so that the stores can be aligned; the items before
+// the first aligned one and the tail go through the scalar kernel.
+#ifndef UINT8_PIPELINE
+#define STREAM_ITEMS ITEMS_PER_PACKET
+#else
+#define STREAM_ITEMS BYTES_PER_PACKET
+#endif
+
+template<class Mode> static inline void streamPacket(data_t *dst, const data_t *src, const data_t *filter){
+#ifndef UINT8_PIPELINE
+	_mm512_stream_ps(dst, blendVec<Mode, OpsAVX512>(_mm512_loadu_ps(src), _mm512_loadu_ps(filter)));
+#else
+	_mm256_stream_si256((__m256i *)dst, blendBytePacket<Mode>(_mm256_loadu_si256((const __m256i *)src), _mm256_loadu_si256((const __m256i *)filter)));
+#endif
+}
+
+template<class Mode> static void streamPlane(const data_t *src, const data_t *filter, data_t *dst, uint count){
+	const uintptr_t alignment = STREAM_ITEMS * sizeof(data_t);
+	uint i = (alignment - (uintptr_t)dst % alignment) % alignment / sizeof(data_t);
+
+	i = (i < count) ? i : count;
+	SCALAR_KERNELS(Mode).plane[Mode::ID](src, filter, dst, i);
+
+	for (; i + STREAM_ITEMS <= count; i += STREAM_ITEMS){
+		streamPacket<Mode>(dst + i, src + i, filter + i);
+	}
+
+	SCALAR_KERNELS(Mode).plane[Mode::ID](src + i, filter + i, dst + i, count - i);
+}
+
+template<class Mode> static void blendRangeStreamAVX512(filter_args_t args0, filter_image args1, uint pixelInit, uint pixelEnd){
+	uint count = pixelEnd - pixelInit;
+
+	streamPlane<Mode>(args0.pRsrc + pixelInit, args1.pRfilter + pixelInit, args0.pRdst + pixelInit, count);
+	streamPlane<Mode>(args0.pGsrc + pixelInit, args1.pGfilter + pixelInit, args0.pGdst + pixelInit, count);
+	streamPlane<Mode>(args0.pBsrc + pixelInit, args1.pBfilter + pixelInit, args0.pBdst + pixelInit, count);
+
+	// Streaming stores are weakly ordered: they must be complete before
+	// the job is reported as done
+	_mm_sfence();
+}
+
+// Overlap with a prepared filter (see kernels.h)
+#ifndef UINT8_PIPELINE
+
+static void blendPreparedAVX512(const data_t *src, const float *a, const float *b, data_t *dst, uint count){
+	uint i = 0;
+
+	for (; i + ITEMS_PER_PACKET <= count; i += ITEMS_PER_PACKET){
+		// Not fused: the same values as the scalar tail
+		__m512 vZ = _mm512_add_ps(_mm512_mul_ps(_mm512_loadu_ps(b + i), _mm512_loadu_ps(src + i)), _mm512_loadu_ps(a + i));
+		#ifdef CHECK_COLOR_SATURATION
+		vZ = _mm512_max_ps(_mm512_min_ps(vZ, _mm512_set1_ps(255.0f)), _mm512_setzero_ps());
+		#endif
+		_mm512_storeu_ps(dst + i, vZ);
+	}
+
+	KERNELS_SCALAR.prepared(src + i, a + i, b + i, dst + i, count - i);
+}
+
+#else
+
+// 16 components per step: floor((a + b * X) / 65025) narrowed to bytes
+static void blendPreparedAVX512(const data_t *src, const float *a, const float *b, data_t *dst, uint count){
+	uint i = 0;
+
+	for (; i + 16 <= count; i += 16){
+		__m512 vX = _mm512_cvtepi32_ps(_mm512_cvtepu8_epi32(_mm_loadu_si128((const __m128i *)(src + i))));
+		__m512 vN = OpsAVX512::fmadd(_mm512_loadu_ps(b + i), vX, _mm512_loadu_ps(a + i));
+		__m512i vZ = _mm512_cvttps_epi32(_mm512_mul_ps(vN, _mm512_set1_ps(1.0f / 65025.0f)));
+		_mm_storeu_si128((__m128i *)(dst + i), _mm512_cvtusepi32_epi8(vZ));
+	}
+
+	KERNELS_SCALAR.prepared(src + i, a + i, b + i, dst + i, count - i);
+}
+
+#endif
+
+// Fingerprint stripes (see hash_kernel_t): the eight lanes in one register
+static size_t hashAVX512(const uint8_t *data, size_t bytes, uint64_t *acc){
+	size_t stripes = bytes / (HASH_LANES * sizeof(uint64_t));
+	__m512i vAcc = _mm512_loadu_si512(acc);
+	__m512i vKey = _mm512_loadu_si512(HASH_KEY);
+	__m512i vStep = _mm512_set1_epi64(HASH_STEP);
+
+	for (size_t s = 0; s < stripes; s++, data += HASH_LANES * sizeof(uint64_t)){
+		__m512i vW = _mm512_loadu_si512(data);
+		__m512i vK = _mm512_xor_si512(vW, vKey);
+		__m512i vProduct = _mm512_mul_epu32(vK, _mm512_srli_epi64(vK, 32));
+		// Words of the neighbour lanes: acc[i ^ 1] += w
+		__m512i vSwapped = _mm512_shuffle_epi32(vW, (_MM_PERM_ENUM)_MM_SHUFFLE(1, 0, 3, 2));
+		vAcc = _mm512_add_epi64(vAcc, _mm512_add_epi64(vProduct, vSwapped));
+		vKey = _mm512_add_epi64(vKey, vStep);
+	}
+	_mm512_storeu_si512(acc, vAcc);
+	return stripes * HASH_LANES * sizeof(uint64_t);
+}
+
+// Sums of the neighbour lanes: a0 + a1, a2 + a3... then b0 + b1...
+static inline __m512 pairSums(__m512 a, __m512 b){
+	const __m512i vEven = _mm512_setr_epi32(0, 2, 4, 6, 8, 10, 12, 14, 16, 18, 20, 22, 24, 26, 28, 30);
+	const __m512i vOdd = _mm512_add_epi32(vEven, _mm512_set1_epi32(1));
+
+	return _mm512_add_ps(_mm512_permutex2var_ps(a, vEven, b), _mm512_permutex2var_ps(a, vOdd, b));
+}
+
+// Mask of the lanes [first, first + lanes) below end, from bit 0
+static inline uint64_t laneMask(uint end, uint first, uint lanes){
+	uint n = (end <= first) ? 0 : ((end - first < lanes) ? end - first : lanes);
+
+	return (n >= 64) ? ~0ull : (1ull << n) - 1;
+}
+
+// Box averages (see box_kernel_t) of blocks of 128 components, four
+// registers of sums once the neighbours of every lane are added. The last
+// block is loaded and stored with masks.
+template<uint FACTOR> static void boxFactorAVX512(const data_t *row, size_t stride, uint rows, data_t *boxes, uint count){
+	const uint boxesPerBlock = 128 / FACTOR;
+	__m512 vScale = _mm512_set1_ps(1.0f / (FACTOR * rows));
+
+	for (uint i = 0; i < count; i += boxesPerBlock){
+		const data_t *block = row + i * FACTOR;
+		uint items = ((count - i < boxesPerBlock) ? count - i : boxesPerBlock) * FACTOR;
+		__m512 vSum[4];
+	#ifndef UINT8_PIPELINE
+		__mmask16 loads[8];
+		__m512 vRows[8];
+
+		for (uint j = 0; j < 8; j++){
+			loads[j] = (__mmask16)laneMask(items, 16 * j, 16);
+			vRows[j] = _mm512_maskz_loadu_ps(loads[j], block + 16 * j);
+		}
+		for (uint y = 1; y < rows; y++){
+			for (uint j = 0; j < 8; j++){
+				vRows[j] = _mm512_add_ps(vRows[j], _mm512_maskz_loadu_ps(loads[j], block + y * stride + 16 * j));
+			}
+		}
+		for (uint j = 0; j < 4; j++){
+			vSum[j] = pairSums(vRows[2 * j], vRows[2 * j + 1]);
+		}
+		uint width = 2, n = 4; // Columns per lane, registers
+	#else
+		// Sums of the pairs of columns in 16 bits (8 rows of 2 * 255)
+		const __m512i vOnes = _mm512_set1_epi8(1);
+		__mmask64 loads[2];
+		__m512i vPairs[2];
+
+		for (uint j = 0; j < 2; j++){
+			loads[j] = laneMask(items, 64 * j, 64);
+			vPairs[j] = _mm512_maddubs_epi16(_mm512_maskz_loadu_epi8(loads[j], block + 64 * j), vOnes);
+		}
+		for (uint y = 1; y < rows; y++){
+			for (uint j = 0; j < 2; j++){
+				vPairs[j] = _mm512_add_epi16(vPairs[j], _mm512_maddubs_epi16(_mm512_maskz_loadu_epi8(loads[j], block + y * stride + 64 * j), vOnes));
+			}
+		}
+		if (FACTOR == 2){
+			// 2 * rows is a power of two: the rounded shift gives the
+			// average of the floats, without converting to them
+			uint shift = (rows == 2) ? 2 : 1;
+			for (uint j = 0; j < 2; j++){
+				__m512i vBox = _mm512_srli_epi16(_mm512_add_epi16(vPairs[j], _mm512_set1_epi16(1 << (shift - 1))), shift);
+				_mm256_mask_storeu_epi8(boxes + i + 32 * j, (__mmask32)laneMask(items / 2, 32 * j, 32), _mm512_cvtepi16_epi8(vBox));
+			}
+			continue;
+		}
+		// Pairs of pairs in 32 bits, in two registers
+		for (uint j = 0; j < 2; j++){
+			vSum[j] = _mm512_cvtepi32_ps(_mm512_madd_epi16(vPairs[j], _mm512_set1_epi16(1)));
+		}
+		uint width = 4, n = 2;
+	#endif
+		// Pairs of pairs up to the width of a box (exact for 8-bit sums)
+		for (; width < FACTOR; width *= 2, n /= 2){
+			for (uint j = 0; j < n / 2; j++){
+				vSum[j] = pairSums(vSum[2 * j], vSum[2 * j + 1]);
+			}
+		}
+		for (uint j = 0; j < n; j++){
+			__mmask16 store = (__mmask16)laneMask(items / FACTOR, 16 * j, 16);
+		#ifndef UINT8_PIPELINE
+			_mm512_mask_storeu_ps(boxes + i + 16 * j, store, _mm512_mul_ps(vSum[j], vScale));
+		#else
+			__m512i vBox = _mm512_cvttps_epi32(_mm512_add_ps(_mm512_mul_ps(vSum[j], vScale), _mm512_set1_ps(0.5f)));
+			_mm512_mask_cvtepi32_storeu_epi8(boxes + i + 16 * j, store, vBox);
+		#endif
+		}
+	}
+}
+
+static void boxAVX512(const data_t *row, size_t stride, uint rows, uint factor, data_t *boxes, uint count){
+
+	switch (factor){
+	case 2:
+		boxFactorAVX512<2>(row, stride, rows, boxes, count);
+		break;
+	case 4:
+		boxFactorAVX512<4>(row, stride, rows, boxes, count);
+		break;
+	default:
+		boxFactorAVX512<8>(row, stride, rows, boxes, count);
+	}
+}
+
+const kernel_set_t KERNELS_AVX512 = {
+	MODE_TABLE(blendRangeAVX512),
+	MODE_TABLE(blendRangeStreamAVX512),
+	MODE_TABLE(blendPlaneAVX512),
+	MODE_TABLE(blendBytesAVX512),
+	MODE_TABLE(blendRgbaAVX512),
+	blendPreparedAVX512,
+	hashAVX512,
+	boxAVX512
+};
+
+const kernel_set_t KERNELS_AVX512_APPROX = {
+	MODE_TABLE_APPROX(blendRangeAVX512),
+	MODE_TABLE_APPROX(blendRangeStreamAVX512),
+	MODE_TABLE_APPROX(blendPlaneAVX512),
+	MODE_TABLE_APPROX(blendBytesAVX512),
+	MODE_TABLE_APPROX(blendRgbaAVX512),
+	blendPreparedAVX512,
+	hashAVX512,
+	boxAVX512
+};
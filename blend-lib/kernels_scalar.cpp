@@ -0,0 +1,186 @@
+/*
+ * kernels_scalar.cpp
+ *
+ *  Created on: Fall 2022
+ */
+
+#include <string.h>
+#include "kernels.h"
+#include "modes.h"
+
+// Operations of the blend modes on one float (see modes.h)
+struct OpsScalar {
+	typedef float vec;
+	typedef bool mask;
+
+	static vec set1(float f){ return f; }
+	static vec add(vec a, vec b){ return a + b; }
+	static vec sub(vec a, vec b){ return a - b; }
+	static vec mul(vec a, vec b){ return a * b; }
+	static vec div(vec a, vec b){ return a / b; }
+	static vec min(vec a, vec b){ return (a < b) ? a : b; }
+	static vec max(vec a, vec b){ return (a > b) ? a : b; }
+	static vec fmadd(vec a, vec b, vec c){ return a * b + c; }
+	static mask lt(vec a, vec b){ return a < b; }
+	static mask gt(vec a, vec b){ return a > b; }
+	static vec select(mask m, vec a, vec b){ return m ? a : b; }
+	// No estimate instruction: a division, folded into a constant for the divisions by 255
+	static vec rcp(vec a){ return 1.0f / a; }
+};
+
+// Mode of one 8-bit component: computed with floats, as the SIMD kernels
+// do, and truncated
+template<class Mode> static inline uint8_t blendByte(uint8_t x, uint8_t y){
+	int z = (int)blendVec<Mode, OpsScalar>(x, y);
+
+	return (z < 0) ? 0 : ((z > 255) ? 255 : z);
+}
+
+// Exact integer form of the Overlap formula for 8-bit components,
+// floor(N / 65025) (see kernels_avx2.cpp)
+template<> inline uint8_t blendByte<ModeOverlap>(uint8_t x, uint8_t y){
+	return (uint32_t)y * (255 * y + 2 * x * (255 - y)) / 65025;
+}
+
+// Mode of one component
+template<class Mode> static inline data_t blendItem(data_t x, data_t y){
+#ifndef UINT8_PIPELINE
+	return blendVec<Mode, OpsScalar>(x, y);
+#else
+	return blendByte<Mode>(x, y);
+#endif
+}
+
+// Fallback for hosts without any of the supported vector extensions
+template<class Mode> static void blendRangeScalar(filter_args_t args0, filter_image args1, uint pixelInit, uint pixelEnd){
+
+	for (uint i = pixelInit; i < pixelEnd; i++){
+		*(args0.pRdst + i) = blendItem<Mode>(*(args0.pRsrc + i), *(args1.pRfilter + i));
+		*(args0.pGdst + i) = blendItem<Mode>(*(args0.pGsrc + i), *(args1.pGfilter + i));
+		*(args0.pBdst + i) = blendItem<Mode>(*(args0.pBsrc + i), *(args1.pBfilter + i));
+	}
+}
+
+// Also the head and tail of the SIMD plane kernels
+template<class Mode> static void blendPlaneScalar(const data_t *src, const data_t *filter, data_t *dst, uint count){
+
+	for (uint i = 0; i < count; i++){
+		dst[i] = blendItem<Mode>(src[i], filter[i]);
+	}
+}
+
+template<class Mode> static void blendBytesScalar(const uint8_t *src, const uint8_t *filter, uint8_t *dst, uint count){
+
+	for (uint i = 0; i < count; i++){
+		dst[i] = blendByte<Mode>(src[i], filter[i]);
+	}
+}
+
+// Also the tail of the SIMD RGBA kernels
+template<class Mode> static void blendRgbaScalar(const uint8_t *src, const uint8_t *filter, uint8_t *dst, uint count){
+
+	for (uint i = 0; i < 4 * count; i += 4){
+		dst[i] = blendByte<Mode>(src[i], filter[i]);
+		dst[i + 1] = blendByte<Mode>(src[i + 1], filter[i + 1]);
+		dst[i + 2] = blendByte<Mode>(src[i + 2], filter[i + 2]);
+		dst[i + 3] = src[i + 3];
+	}
+}
+
+void overlapPrepare(const data_t *filter, float *a, float *b, uint count){
+
+	for (uint i = 0; i < count; i++){
+		double y = filter[i];
+	#ifndef UINT8_PIPELINE
+		a[i] = (float)(y * y / 255.0);
+		b[i] = (float)(2.0 * y * (255.0 - y) / 65025.0);
+	#else
+		a[i] = (float)(255.0 * y * y);
+		b[i] = (float)(2.0 * y * (255.0 - y));
+	#endif
+	}
+}
+
+// Also the tail of the SIMD prepared kernels
+static void blendPreparedScalar(const data_t *src, const float *a, const float *b, data_t *dst, uint count){
+
+	for (uint i = 0; i < count; i++){
+	#ifndef UINT8_PIPELINE
+		float z = OpsScalar::fmadd(b[i], src[i], a[i]);
+		#ifdef CHECK_COLOR_SATURATION
+		z = (z < 0.0f) ? 0.0f : ((z > 255.0f) ? 255.0f : z);
+		#endif
+		dst[i] = z;
+	#else
+		// a + b * X is an integer below 2^24, exact as a float
+		dst[i] = (uint32_t)(b[i] * src[i] + a[i]) / 65025;
+	#endif
+	}
+}
+
+// Fingerprint stripes (see hash_kernel_t)
+static size_t hashScalar(const uint8_t *data, size_t bytes, uint64_t *acc){
+	size_t stripes = bytes / (HASH_LANES * sizeof(uint64_t));
+	uint64_t words[HASH_LANES];
+
+	for (size_t s = 0; s < stripes; s++){
+		memcpy(words, data + s * sizeof(words), sizeof(words));
+		for (uint i = 0; i < HASH_LANES; i++){
+			uint64_t k = words[i] ^ (HASH_KEY[i] + s * HASH_STEP);
+			acc[i] += (k & 0xFFFFFFFF) * (k >> 32);
+			acc[i ^ 1] += words[i];
+		}
+	}
+	return stripes * sizeof(words);
+}
+
+// Box averages (see box_kernel_t). The 8-bit sums are integers, exact in
+// any order; the float ones follow the pairs of the vector kernels.
+static void boxScalar(const data_t *row, size_t stride, uint rows, uint factor, data_t *boxes, uint count){
+	float scale = 1.0f / (factor * rows);
+
+	for (uint i = 0; i < count; i++){
+		const data_t *box = row + i * factor;
+		float sums[8];
+
+		for (uint x = 0; x < factor; x++){
+			float sum = box[x];
+			for (uint y = 1; y < rows; y++){
+				sum += box[y * stride + x];
+			}
+			sums[x] = sum;
+		}
+		for (uint n = factor; n > 1; n /= 2){
+			for (uint x = 0; x < n / 2; x++){
+				sums[x] = sums[2 * x] + sums[2 * x + 1];
+			}
+		}
+	#ifndef UINT8_PIPELINE
+		boxes[i] = sums[0] * scale;
+	#else
+		boxes[i] = (uint32_t)(sums[0] * scale + 0.5f);
+	#endif
+	}
+}
+
+const kernel_set_t KERNELS_SCALAR = {
+	MODE_TABLE(blendRangeScalar),
+	MODE_TABLE(blendRangeScalar),
+	MODE_TABLE(blendPlaneScalar),
+	MODE_TABLE(blendBytesScalar),
+	MODE_TABLE(blendRgbaScalar),
+	blendPreparedScalar,
+	hashScalar,
+	boxScalar
+};
+
+const kernel_set_t KERNELS_SCALAR_APPROX = {
+	MODE_TABLE_APPROX(blendRangeScalar),
+	MODE_TABLE_APPROX(blendRangeScalar),
+	MODE_TABLE_APPROX(blendPlaneScalar),
+	MODE_TABLE_APPROX(blendBytesScalar),
+	MODE_TABLE_APPROX(blendRgbaScalar),
+	blendPreparedScalar,
+	hashScalar,
+	boxScalar
+};
@@ -0,0 +1,393 @@
+/*
+ * kernels_sse2.cpp
+ *
+ *  Created on: Fall 2022
+ */
+
+#include <emmintrin.h> // SSE2, part of every x86-64 processor
+#include <string.h>
+#include "kernels.h"
+#include "modes.h"
+
+// Note: vector constants are built inside the functions. A global
+// initialized with an intrinsic would run at start-up on every host.
+
+// Operations of the blend modes on packets of 4 floats (see modes.h)
+struct OpsSSE2 {
+	typedef __m128 vec;
+	typedef __m128 mask;
+
+	static vec set1(float f){ return _mm_set1_ps(f); }
+	static vec add(vec a, vec b){ return _mm_add_ps(a, b); }
+	static vec sub(vec a, vec b){ return _mm_sub_ps(a, b); }
+	static vec mul(vec a, vec b){ return _mm_mul_ps(a, b); }
+	static vec div(vec a, vec b){ return _mm_div_ps(a, b); }
+	static vec min(vec a, vec b){ return _mm_min_ps(a, b); }
+	static vec max(vec a, vec b){ return _mm_max_ps(a, b); }
+	static vec fmadd(vec a, vec b, vec c){ return _mm_add_ps(_mm_mul_ps(a, b), c); }
+	static mask lt(vec a, vec b){ return _mm_cmplt_ps(a, b); }
+	static mask gt(vec a, vec b){ return _mm_cmpgt_ps(a, b); }
+	// SSE2 has no blendv: and / andnot / or
+	static vec select(mask m, vec a, vec b){ return _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b)); }
+	// 12-bit estimate, r * (2 - a * r) doubles its bits
+	static vec rcp(vec a){
+		vec r = _mm_rcp_ps(a);
+		return _mm_mul_ps(r, _mm_sub_ps(_mm_set1_ps(2.0f), _mm_mul_ps(a, r)));
+	}
+};
+
+#ifndef UINT8_PIPELINE
+
+#define ITEMS_PER_PACKET (sizeof(__m128)/sizeof(data_t))
+
+template<class Mode> static void blendRangeSSE2(filter_args_t args0, filter_image args1, uint pixelInit, uint pixelEnd){
+	uint i = pixelInit;
+
+	for (; i + ITEMS_PER_PACKET <= pixelEnd; i += ITEMS_PER_PACKET){
+		_mm_storeu_ps(args0.pRdst + i, blendVec<Mode, OpsSSE2>(_mm_loadu_ps(args0.pRsrc + i), _mm_loadu_ps(args1.pRfilter + i)));
+		_mm_storeu_ps(args0.pGdst + i, blendVec<Mode, OpsSSE2>(_mm_loadu_ps(args0.pGsrc + i), _mm_loadu_ps(args1.pGfilter + i)));
+		_mm_storeu_ps(args0.pBdst + i, blendVec<Mode, OpsSSE2>(_mm_loadu_ps(args0.pBsrc + i), _mm_loadu_ps(args1.pBfilter + i)));
+	}
+
+	// SSE2 has no masked loads/stores: the tail goes through the scalar kernel
+	SCALAR_KERNELS(Mode).range[Mode::ID](args0, args1, i, pixelEnd);
+}
+
+template<class Mode> static void blendPlaneSSE2(const data_t *src, const data_t *filter, data_t *dst, uint count){
+	uint i = 0;
+
+	for (; i + ITEMS_PER_PACKET <= count; i += ITEMS_PER_PACKET){
+		_mm_storeu_ps(dst + i, blendVec<Mode, OpsSSE2>(_mm_loadu_ps(src + i), _mm_loadu_ps(filter + i)));
+	}
+
+	SCALAR_KERNELS(Mode).plane[Mode::ID](src + i, filter + i, dst + i, count - i);
+}
+
+#endif
+
+// Bytes of a 8-bit packet: 16 bytes, widened to two vectors of 16-bit lanes
+#define BYTES_PER_PACKET (sizeof(__m128i))
+
+// Mode of 8 pixels held in 16-bit lanes: widened to floats, blended as in
+// the float pipeline and truncated. The result (<= 255) stays in 16-bit lanes
+template<class Mode> static inline __m128i blendHalf(__m128i vX, __m128i vY){
+	const __m128i vZero = _mm_setzero_si128();
+	__m128 vLo = blendVec<Mode, OpsSSE2>(_mm_cvtepi32_ps(_mm_unpacklo_epi16(vX, vZero)), _mm_cvtepi32_ps(_mm_unpacklo_epi16(vY, vZero)));
+	__m128 vHi = blendVec<Mode, OpsSSE2>(_mm_cvtepi32_ps(_mm_unpackhi_epi16(vX, vZero)), _mm_cvtepi32_ps(_mm_unpackhi_epi16(vY, vZero)));
+
+	return _mm_packs_epi32(_mm_cvttps_epi32(vLo), _mm_cvttps_epi32(vHi));
+}
+
+// floor(N / 65025) of four 32-bit numerators (see kernels_avx2.cpp)
+static inline __m128i overlapQuotient(__m128i vA, __m128i vB){
+	__m128i vN = _mm_madd_epi16(vA, vB);
+
+	return _mm_cvttps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(vN), _mm_set1_ps(1.0f / 65025.0f)));
+}
+
+// Overlap has an exact integer form, faster than the floats
+template<> inline __m128i blendHalf<ModeOverlap>(__m128i vX, __m128i vY){
+	__m128i vY15 = _mm_mullo_epi16(vY, _mm_set1_epi16(15));
+	__m128i vY17 = _mm_mullo_epi16(vY, _mm_set1_epi16(17));
+	__m128i vX2 = _mm_add_epi16(vX, vX);
+	__m128i vYY = _mm_mullo_epi16(vY, _mm_sub_epi16(_mm_set1_epi16(255), vY));
+
+	__m128i vLo = overlapQuotient(_mm_unpacklo_epi16(vY15, vX2), _mm_unpacklo_epi16(vY17, vYY));
+	__m128i vHi = overlapQuotient(_mm_unpackhi_epi16(vY15, vX2), _mm_unpackhi_epi16(vY17, vYY));
+
+	// Signed saturation is enough, the values fit in 16 bits
+	return _mm_packs_epi32(vLo, vHi);
+}
+
+// Mode of one packet of 16 pixels
+template<class Mode> static inline __m128i blendBytePacket(__m128i vSource, __m128i vFilter){
+	const __m128i vZero = _mm_setzero_si128();
+	__m128i vLo = blendHalf<Mode>(_mm_unpacklo_epi8(vSource, vZero), _mm_unpacklo_epi8(vFilter, vZero));
+	__m128i vHi = blendHalf<Mode>(_mm_unpackhi_epi8(vSource, vZero), _mm_unpackhi_epi8(vFilter, vZero));
+
+	return _mm_packus_epi16(vLo, vHi);
+}
+
+// Flat run of count 8-bit components (planar, or interleaved without alpha)
+template<class Mode> static void blendBytesSSE2(const uint8_t *src, const uint8_t *filter, uint8_t *dst, uint count){
+	uint i = 0;
+
+	for (; i + BYTES_PER_PACKET <= count; i += BYTES_PER_PACKET){
+		_mm_storeu_si128((__m128i *)(dst + i), blendBytePacket<Mode>(_mm_loadu_si128((const __m128i *)(src + i)), _mm_loadu_si128((const __m128i *)(filter + i))));
+	}
+
+	// The tail goes through the scalar kernel
+	SCALAR_KERNELS(Mode).bytes[Mode::ID](src + i, filter + i, dst + i, count - i);
+}
+
+// Interleaved pixels with alpha, 4 per packet: the whole packet is blended
+// and the alpha bytes of the source are put back with a mask
+template<class Mode> static void blendRgbaSSE2(const uint8_t *src, const uint8_t *filter, uint8_t *dst, uint count){
+	const __m128i vAlpha = _mm_set1_epi32(0xFF000000);
+	uint i = 0;
+
+	for (; i + BYTES_PER_PACKET / 4 <= count; i += BYTES_PER_PACKET / 4){
+		__m128i vSource = _mm_loadu_si128((const __m128i *)(src + 4 * i));
+		__m128i vColor = blendBytePacket<Mode>(vSource, _mm_loadu_si128((const __m128i *)(filter + 4 * i)));
+		_mm_storeu_si128((__m128i *)(dst + 4 * i), _mm_or_si128(_mm_and_si128(vAlpha, vSource), _mm_andnot_si128(vAlpha, vColor)));
+	}
+
+	SCALAR_KERNELS(Mode).rgba[Mode::ID](src + 4 * i, filter + 4 * i, dst + 4 * i, count - i);
+}
+
+#ifdef UINT8_PIPELINE
+
+template<class Mode> static void blendRangeSSE2(filter_args_t args0, filter_image args1, uint pixelInit, uint pixelEnd){
+	uint i = pixelInit;
+
+	for (; i + BYTES_PER_PACKET <= pixelEnd; i += BYTES_PER_PACKET){
+		_mm_storeu_si128((__m128i *)(args0.pRdst + i), blendBytePacket<Mode>(_mm_loadu_si128((__m128i *)(args0.pRsrc + i)), _mm_loadu_si128((__m128i *)(args1.pRfilter + i))));
+		_mm_storeu_si128((__m128i *)(args0.pGdst + i), blendBytePacket<Mode>(_mm_loadu_si128((__m128i *)(args0.pGsrc + i)), _mm_loadu_si128((__m128i *)(args1.pGfilter + i))));
+		_mm_storeu_si128((__m128i *)(args0.pBdst + i), blendBytePacket<Mode>(_mm_loadu_si128((__m128i *)(args0.pBsrc + i)), _mm_loadu_si128((__m128i *)(args1.pBfilter + i))));
+	}
+
+	// The tail goes through the scalar kernel
+	SCALAR_KERNELS(Mode).range[Mode::ID](args0, args1, i, pixelEnd);
+}
+
+// 8-bit planes are flat runs of bytes
+template<class Mode> static void blendPlaneSSE2(const data_t *src, const data_t *filter, data_t *dst, uint count){
+	blendBytesSSE2<Mode>(src, filter, dst, count);
+}
+
+#endif
+
+// Non-temporal version (see kernels.h). Every plane of the range is
+// blended on its own so that the stores can be aligned; the items before
+// the first aligned one and the tail go through the scalar kernel.
+#ifndef UINT8_PIPELINE
+#define STREAM_ITEMS ITEMS_PER_PACKET
+#else
+#define STREAM_ITEMS BYTES_PER_PACKET
+#endif
+
+template<class Mode> static inline void streamPacket(data_t *dst, const data_t *src, const data_t *filter){
+#ifndef UINT8_PIPELINE
+	_mm_stream_ps(dst, blendVec<Mode, OpsSSE2>(_mm_loadu_ps(src), _mm_loadu_ps(filter)));
+#else
+	_mm_stream_si128((__m128i *)dst, blendBytePacket<Mode>(_mm_loadu_si128((const __m128i *)src), _mm_loadu_si128((const __m128i *)filter)));
+#endif
+}
+
+template<class Mode> static void streamPlane(const data_t *src, const data_t *filter, data_t *dst, uint count){
+	const uintptr_t alignment = STREAM_ITEMS * sizeof(data_t);
+	uint i = (alignment - (uintptr_t)dst % alignment) % alignment / sizeof(data_t);
+
+	i = (i < count) ? i : count;
+	SCALAR_KERNELS(Mode).plane[Mode::ID](src, filter, dst, i);
+
+	for (; i + STREAM_ITEMS <= count; i += STREAM_ITEMS){
+		streamPacket<Mode>(dst + i, src + i, filter + i);
+	}
+
+	SCALAR_KERNELS(Mode).plane[Mode::ID](src + i, filter + i, dst + i, count - i);
+}
+
+template<class Mode> static void blendRangeStreamSSE2(filter_args_t args0, filter_image args1, uint pixelInit, uint pixelEnd){
+	uint count = pixelEnd - pixelInit;
+
+	streamPlane<Mode>(args0.pRsrc + pixelInit, args1.pRfilter + pixelInit, args0.pRdst + pixelInit, count);
+	streamPlane<Mode>(args0.pGsrc + pixelInit, args1.pGfilter + pixelInit, args0.pGdst + pixelInit, count);
+	streamPlane<Mode>(args0.pBsrc + pixelInit, args1.pBfilter + pixelInit, args0.pBdst + pixelInit, count);
+
+	// Streaming stores are weakly ordered: they must be complete before
+	// the job is reported as done
+	_mm_sfence();
+}
+
+// Overlap with a prepared filter (see kernels.h)
+#ifndef UINT8_PIPELINE
+
+static void blendPreparedSSE2(const data_t *src, const float *a, const float *b, data_t *dst, uint count){
+	uint i = 0;
+
+	for (; i + ITEMS_PER_PACKET <= count; i += ITEMS_PER_PACKET){
+		__m128 vZ = OpsSSE2::fmadd(_mm_loadu_ps(b + i), _mm_loadu_ps(src + i), _mm_loadu_ps(a + i));
+		#ifdef CHECK_COLOR_SATURATION
+		vZ = _mm_max_ps(_mm_min_ps(vZ, _mm_set1_ps(255.0f)), _mm_setzero_ps());
+		#endif
+		_mm_storeu_ps(dst + i, vZ);
+	}
+
+	KERNELS_SCALAR.prepared(src + i, a + i, b + i, dst + i, count - i);
+}
+
+#else
+
+// floor((a + b * X) / 65025) of four components widened to 32 bits
+static inline __m128i preparedQuarter(__m128i vX, const float *a, const float *b){
+	__m128 vN = OpsSSE2::fmadd(_mm_loadu_ps(b), _mm_cvtepi32_ps(vX), _mm_loadu_ps(a));
+
+	return _mm_cvttps_epi32(_mm_mul_ps(vN, _mm_set1_ps(1.0f / 65025.0f)));
+}
+
+static void blendPreparedSSE2(const data_t *src, const float *a, const float *b, data_t *dst, uint count){
+	const __m128i vZero = _mm_setzero_si128();
+	uint i = 0;
+
+	for (; i + BYTES_PER_PACKET <= count; i += BYTES_PER_PACKET){
+		__m128i vX = _mm_loadu_si128((const __m128i *)(src + i));
+		__m128i vLo = _mm_unpacklo_epi8(vX, vZero);
+		__m128i vHi = _mm_unpackhi_epi8(vX, vZero);
+
+		__m128i v0 = preparedQuarter(_mm_unpacklo_epi16(vLo, vZero), a + i, b + i);
+		__m128i v1 = preparedQuarter(_mm_unpackhi_epi16(vLo, vZero), a + i + 4, b + i + 4);
+		__m128i v2 = preparedQuarter(_mm_unpacklo_epi16(vHi, vZero), a + i + 8, b + i + 8);
+		__m128i v3 = preparedQuarter(_mm_unpackhi_epi16(vHi, vZero), a + i + 12, b + i + 12);
+
+		_mm_storeu_si128((__m128i *)(dst + i), _mm_packus_epi16(_mm_packs_epi32(v0, v1), _mm_packs_epi32(v2, v3)));
+	}
+
+	KERNELS_SCALAR.prepared(src + i, a + i, b + i, dst + i, count - i);
+}
+
+#endif
+
+// Fingerprint stripes (see hash_kernel_t): two lanes per register
+static size_t hashSSE2(const uint8_t *data, size_t bytes, uint64_t *acc){
+	size_t stripes = bytes / (HASH_LANES * sizeof(uint64_t));
+	__m128i vAcc[4], vKey[4];
+	__m128i vStep = _mm_set1_epi64x(HASH_STEP);
+
+	for (uint j = 0; j < 4; j++){
+		vAcc[j] = _mm_loadu_si128((const __m128i *)(acc + 2 * j));
+		vKey[j] = _mm_loadu_si128((const __m128i *)(HASH_KEY + 2 * j));
+	}
+	for (size_t s = 0; s < stripes; s++, data += HASH_LANES * sizeof(uint64_t)){
+		for (uint j = 0; j < 4; j++){
+			__m128i vW = _mm_loadu_si128((const __m128i *)data + j);
+			__m128i vK = _mm_xor_si128(vW, vKey[j]);
+			__m128i vProduct = _mm_mul_epu32(vK, _mm_srli_epi64(vK, 32));
+			// Words of the neighbour lanes: acc[i ^ 1] += w
+			__m128i vSwapped = _mm_shuffle_epi32(vW, _MM_SHUFFLE(1, 0, 3, 2));
+			vAcc[j] = _mm_add_epi64(vAcc[j], _mm_add_epi64(vProduct, vSwapped));
+			vKey[j] = _mm_add_epi64(vKey[j], vStep);
+		}
+	}
+	for (uint j = 0; j < 4; j++){
+		_mm_storeu_si128((__m128i *)(acc + 2 * j), vAcc[j]);
+	}
+	return stripes * HASH_LANES * sizeof(uint64_t);
+}
+
+// Sums of the neighbour lanes: a0 + a1, a2 + a3, b0 + b1, b2 + b3
+static inline __m128 pairSums(__m128 a, __m128 b){
+	return _mm_add_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)), _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+}
+
+// Box averages (see box_kernel_t) of blocks of 32 components, four
+// registers of sums once the neighbours of every lane are added
+template<uint FACTOR> static void boxFactorSSE2(const data_t *row, size_t stride, uint rows, data_t *boxes, uint count){
+	const uint boxesPerBlock = 32 / FACTOR;
+	__m128 vScale = _mm_set1_ps(1.0f / (FACTOR * rows));
+	uint i = 0;
+
+	for (; i + boxesPerBlock <= count; i += boxesPerBlock){
+		const data_t *block = row + i * FACTOR;
+		__m128 vSum[4];
+	#ifndef UINT8_PIPELINE
+		__m128 vRows[8];
+
+		for (uint j = 0; j < 8; j++){
+			vRows[j] = _mm_loadu_ps(block + 4 * j);
+		}
+		for (uint y = 1; y < rows; y++){
+			for (uint j = 0; j < 8; j++){
+				vRows[j] = _mm_add_ps(vRows[j], _mm_loadu_ps(block + y * stride + 4 * j));
+			}
+		}
+		for (uint j = 0; j < 4; j++){
+			vSum[j] = pairSums(vRows[2 * j], vRows[2 * j + 1]);
+		}
+	#else
+		// Column sums in 16 bits (8 rows of 255), pairs in 32
+		const __m128i vZero = _mm_setzero_si128();
+		__m128i vRows[4];
+
+		for (uint j = 0; j < 2; j++){
+			__m128i vX = _mm_loadu_si128((const __m128i *)(block + 16 * j));
+			vRows[2 * j] = _mm_unpacklo_epi8(vX, vZero);
+			vRows[2 * j + 1] = _mm_unpackhi_epi8(vX, vZero);
+		}
+		for (uint y = 1; y < rows; y++){
+			for (uint j = 0; j < 2; j++){
+				__m128i vX = _mm_loadu_si128((const __m128i *)(block + y * stride + 16 * j));
+				vRows[2 * j] = _mm_add_epi16(vRows[2 * j], _mm_unpacklo_epi8(vX, vZero));
+				vRows[2 * j + 1] = _mm_add_epi16(vRows[2 * j + 1], _mm_unpackhi_epi8(vX, vZero));
+			}
+		}
+		for (uint j = 0; j < 4; j++){
+			vSum[j] = _mm_cvtepi32_ps(_mm_madd_epi16(vRows[j], _mm_set1_epi16(1)));
+		}
+	#endif
+		// Pairs of pairs up to the width of a box (exact for 8-bit sums)
+		uint n = 4; // Registers
+		for (uint width = 2; width < FACTOR; width *= 2, n /= 2){
+			for (uint j = 0; j < n / 2; j++){
+				vSum[j] = pairSums(vSum[2 * j], vSum[2 * j + 1]);
+			}
+		}
+	#ifndef UINT8_PIPELINE
+		for (uint j = 0; j < n; j++){
+			_mm_storeu_ps(boxes + i + 4 * j, _mm_mul_ps(vSum[j], vScale));
+		}
+	#else
+		__m128i vBox[4];
+		for (uint j = 0; j < 4; j++){
+			vBox[j] = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(vSum[(j < n) ? j : 0], vScale), _mm_set1_ps(0.5f)));
+		}
+		__m128i vBytes = _mm_packus_epi16(_mm_packs_epi32(vBox[0], vBox[1]), _mm_packs_epi32(vBox[2], vBox[3]));
+		if (n == 4){
+			_mm_storeu_si128((__m128i *)(boxes + i), vBytes);
+		} else if (n == 2){
+			_mm_storel_epi64((__m128i *)(boxes + i), vBytes);
+		} else {
+			uint32_t word = _mm_cvtsi128_si32(vBytes);
+			memcpy(boxes + i, &word, sizeof(word));
+		}
+	#endif
+	}
+
+	KERNELS_SCALAR.box(row + i * FACTOR, stride, rows, FACTOR, boxes + i, count - i);
+}
+
+static void boxSSE2(const data_t *row, size_t stride, uint rows, uint factor, data_t *boxes, uint count){
+
+	switch (factor){
+	case 2:
+		boxFactorSSE2<2>(row, stride, rows, boxes, count);
+		break;
+	case 4:
+		boxFactorSSE2<4>(row, stride, rows, boxes, count);
+		break;
+	default:
+		boxFactorSSE2<8>(row, stride, rows, boxes, count);
+	}
+}
+
+const kernel_set_t KERNELS_SSE2 = {
+	MODE_TABLE(blendRangeSSE2),
+	MODE_TABLE(blendRangeStreamSSE2),
+	MODE_TABLE(blendPlaneSSE2),
+	MODE_TABLE(blendBytesSSE2),
+	MODE_TABLE(blendRgbaSSE2),
+	blendPreparedSSE2,
+	hashSSE2,
+	boxSSE2
+};
+
+const kernel_set_t KERNELS_SSE2_APPROX = {
+	MODE_TABLE_APPROX(blendRangeSSE2),
+	MODE_TABLE_APPROX(blendRangeStreamSSE2),
+	MODE_TABLE_APPROX(blendPlaneSSE2),
+	MODE_TABLE_APPROX(blendBytesSSE2),
+	MODE_TABLE_APPROX(blendRgbaSSE2),
+	blendPreparedSSE2,
+	hashSSE2,
+	boxSSE2
+};
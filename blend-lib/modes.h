@@ -0,0 +1,237 @@
+/*
+ * modes.h
+ *
+ *  Created on: Fall 2022
+ *
+ * Blend modes as policies. Every mode is a struct with an apply function
+ * template, written once over the operations of a vector type V. Each
+ * kernels_*.cpp file defines V for its instruction set and instantiates
+ * every mode, so the hot loops have no per-pixel switch or indirect call:
+ * the mode is chosen once per image, together with the kernel.
+ *
+ * Only included by the kernels_*.cpp files. X is the source component and
+ * Y the filter component, both in [0, 255].
+ */
+
+#ifndef MODES_H_
+#define MODES_H_
+
+#include "kernels.h"
+
+// V must provide:
+//  - V::vec (a packet of floats) and V::mask (a lane mask)
+//  - set1(f), add, sub, mul, div, min, max, fmadd(a, b, c) = a * b + c
+//    (fused on AVX2 and AVX-512, so the exact modes do not use it: they
+//    must store the values of the scalar kernel)
+//  - lt(a, b), gt(a, b) and select(mask, a, b) = mask ? a : b, per lane
+//  - rcp(a) = 1 / a, as an estimate refined by a Newton step where the
+//    instruction set has one (only used by the approximate modes)
+// min and max return the second operand when the first one is a NaN, as
+// the minps and maxps instructions do.
+
+// Overlap mode #10 of the project: (Y / 255) * (Y + ((2 * X) / 255) * (255 - Y))
+struct ModeOverlap {
+	static const blend_mode_t ID = BLEND_OVERLAP;
+
+	template<class V> static inline typename V::vec apply(typename V::vec x, typename V::vec y){
+		typename V::vec v255 = V::set1(255.0f);
+		typename V::vec a = V::div(V::add(x, x), v255);
+
+		return V::mul(V::div(y, v255), V::add(V::mul(a, V::sub(v255, y)), y));
+	}
+};
+
+// X * Y / 255
+struct ModeMultiply {
+	static const blend_mode_t ID = BLEND_MULTIPLY;
+
+	template<class V> static inline typename V::vec apply(typename V::vec x, typename V::vec y){
+		return V::div(V::mul(x, y), V::set1(255.0f));
+	}
+};
+
+// 255 - (255 - X) * (255 - Y) / 255
+struct ModeScreen {
+	static const blend_mode_t ID = BLEND_SCREEN;
+
+	template<class V> static inline typename V::vec apply(typename V::vec x, typename V::vec y){
+		typename V::vec v255 = V::set1(255.0f);
+
+		return V::sub(v255, V::div(V::mul(V::sub(v255, x), V::sub(v255, y)), v255));
+	}
+};
+
+// Multiply (doubled) where the source is dark, screen (doubled) where it is light
+struct ModeOverlay {
+	static const blend_mode_t ID = BLEND_OVERLAY;
+
+	template<class V> static inline typename V::vec apply(typename V::vec x, typename V::vec y){
+		typename V::vec v255 = V::set1(255.0f);
+		typename V::vec dark = V::div(V::mul(V::add(x, x), y), v255);
+		typename V::vec light = V::sub(v255, V::div(V::mul(V::add(V::sub(v255, x), V::sub(v255, x)), V::sub(v255, y)), v255));
+
+		return V::select(V::lt(x, V::set1(128.0f)), dark, light);
+	}
+};
+
+// min(X, Y)
+struct ModeDarken {
+	static const blend_mode_t ID = BLEND_DARKEN;
+
+	template<class V> static inline typename V::vec apply(typename V::vec x, typename V::vec y){
+		return V::min(x, y);
+	}
+};
+
+// max(X, Y)
+struct ModeLighten {
+	static const blend_mode_t ID = BLEND_LIGHTEN;
+
+	template<class V> static inline typename V::vec apply(typename V::vec x, typename V::vec y){
+		return V::max(x, y);
+	}
+};
+
+// Colour dodge: min(255, 255 * X / (255 - Y)), 0 for a black source.
+// Y = 255 divides by zero: the infinity is clamped (the NaN of X = 0 is not selected)
+struct ModeDodge {
+	static const blend_mode_t ID = BLEND_DODGE;
+
+	template<class V> static inline typename V::vec apply(typename V::vec x, typename V::vec y){
+		typename V::vec v255 = V::set1(255.0f);
+		typename V::vec z = V::min(V::div(V::mul(x, v255), V::sub(v255, y)), v255);
+
+		return V::select(V::gt(x, V::set1(0.0f)), z, V::set1(0.0f));
+	}
+};
+
+// Colour burn: 255 - min(255, 255 * (255 - X) / Y), 255 for a white source
+struct ModeBurn {
+	static const blend_mode_t ID = BLEND_BURN;
+
+	template<class V> static inline typename V::vec apply(typename V::vec x, typename V::vec y){
+		typename V::vec v255 = V::set1(255.0f);
+		typename V::vec z = V::sub(v255, V::min(V::div(V::mul(V::sub(v255, x), v255), y), v255));
+
+		return V::select(V::lt(x, v255), z, v255);
+	}
+};
+
+// Soft light (Pegtop's formula, continuous and without branches):
+// ((255 - 2Y) * X * X / 255 + 2 * Y * X) / 255
+struct ModeSoftLight {
+	static const blend_mode_t ID = BLEND_SOFT_LIGHT;
+
+	template<class V> static inline typename V::vec apply(typename V::vec x, typename V::vec y){
+		typename V::vec v255 = V::set1(255.0f);
+		typename V::vec a = V::div(V::mul(V::mul(V::sub(v255, V::add(y, y)), x), x), v255);
+
+		return V::div(V::add(a, V::mul(V::add(y, y), x)), v255);
+	}
+};
+
+// Overlay with the roles of the images swapped (the filter decides)
+struct ModeHardLight {
+	static const blend_mode_t ID = BLEND_HARD_LIGHT;
+
+	template<class V> static inline typename V::vec apply(typename V::vec x, typename V::vec y){
+		typename V::vec v255 = V::set1(255.0f);
+		typename V::vec dark = V::div(V::mul(V::add(y, y), x), v255);
+		typename V::vec light = V::sub(v255, V::div(V::mul(V::add(V::sub(v255, y), V::sub(v255, y)), V::sub(v255, x)), v255));
+
+		return V::select(V::lt(y, V::set1(128.0f)), dark, light);
+	}
+};
+
+// |X - Y|
+struct ModeDifference {
+	static const blend_mode_t ID = BLEND_DIFFERENCE;
+
+	template<class V> static inline typename V::vec apply(typename V::vec x, typename V::vec y){
+		return V::sub(V::max(x, y), V::min(x, y));
+	}
+};
+
+// X + Y - 2 * X * Y / 255
+struct ModeExclusion {
+	static const blend_mode_t ID = BLEND_EXCLUSION;
+
+	template<class V> static inline typename V::vec apply(typename V::vec x, typename V::vec y){
+		typename V::vec xy = V::div(V::mul(V::add(x, x), y), V::set1(255.0f));
+
+		return V::sub(V::add(x, y), xy);
+	}
+};
+
+// Operations of V where every division is a multiply by the reciprocal
+// of the divisor (constant divisors have it hoisted out of the loops)
+template<class V> struct ApproxOps : V {
+	static typename V::vec div(typename V::vec a, typename V::vec b){ return V::mul(a, V::rcp(b)); }
+};
+
+// PRECISION_APPROX variant of a mode: the same formula over ApproxOps.
+// The error against the exact mode is measured by --validate.
+template<class Mode> struct Approx {
+	static const blend_mode_t ID = Mode::ID;
+
+	template<class V> static inline typename V::vec apply(typename V::vec x, typename V::vec y){
+		return Mode::template apply<ApproxOps<V> >(x, y);
+	}
+};
+
+// Scalar kernels of the precision of Mode: the heads and tails of the SIMD
+// kernels are computed as their packets are
+template<class Mode> struct ScalarKernels {
+	static const kernel_set_t &set(){ return KERNELS_SCALAR; }
+};
+
+template<class Mode> struct ScalarKernels<Approx<Mode> > {
+	static const kernel_set_t &set(){ return KERNELS_SCALAR_APPROX; }
+};
+
+#define SCALAR_KERNELS(Mode) (ScalarKernels<Mode>::set())
+
+// Mode applied to one packet, clamped to [0, 255] with CHECK_COLOR_SATURATION
+template<class Mode, class V> static inline typename V::vec blendVec(typename V::vec x, typename V::vec y){
+	typename V::vec z = Mode::template apply<V>(x, y);
+
+	#ifdef CHECK_COLOR_SATURATION
+	z = V::max(V::min(z, V::set1(255.0f)), V::set1(0.0f));
+	#endif
+
+	return z;
+}
+
+// Instances of a kernel template for every mode, in the order of blend_mode_t
+#define MODE_TABLE(kernel) { \
+	kernel<ModeOverlap>, \
+	kernel<ModeMultiply>, \
+	kernel<ModeScreen>, \
+	kernel<ModeOverlay>, \
+	kernel<ModeDarken>, \
+	kernel<ModeLighten>, \
+	kernel<ModeDodge>, \
+	kernel<ModeBurn>, \
+	kernel<ModeSoftLight>, \
+	kernel<ModeHardLight>, \
+	kernel<ModeDifference>, \
+	kernel<ModeExclusion> \
+}
+
+// Same for the approximate variants
+#define MODE_TABLE_APPROX(kernel) { \
+	kernel<Approx<ModeOverlap> >, \
+	kernel<Approx<ModeMultiply> >, \
+	kernel<Approx<ModeScreen> >, \
+	kernel<Approx<ModeOverlay> >, \
+	kernel<Approx<ModeDarken> >, \
+	kernel<Approx<ModeLighten> >, \
+	kernel<Approx<ModeDodge> >, \
+	kernel<Approx<ModeBurn> >, \
+	kernel<Approx<ModeSoftLight> >, \
+	kernel<Approx<ModeHardLight> >, \
+	kernel<Approx<ModeDifference> >, \
+	kernel<Approx<ModeExclusion> > \
+}
+
+#endif /* MODES_H_ */
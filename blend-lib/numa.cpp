@@ -0,0 +1,194 @@
+/*
+ * numa.cpp
+ *
+ *  Created on: Fall 2022
+ */
+
+#include <errno.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include "numa.h"
+
+// Flag of move_pages (numaif.h, which comes with libnuma)
+#ifndef MPOL_MF_MOVE
+#define MPOL_MF_MOVE (1 << 1)
+#endif
+
+// Pages handled by one move_pages call
+#define NUMA_PAGE_BATCH 512
+
+// Adds the CPUs of a sysfs list ("0-3,8,10-11") to node. Returns false if
+// the file does not exist
+static bool readCpuList(const char *path, int node, numa_topology_t *topology){
+	FILE *file = fopen(path, "r");
+	char line[4096];
+
+	if (file == NULL){
+		return false;
+	}
+	if (fgets(line, sizeof(line), file) == NULL){
+		line[0] = '\0';
+	}
+	fclose(file);
+
+	char *p = line;
+	while (*p >= '0' && *p <= '9'){
+		long first = strtol(p, &p, 10);
+		long last = first;
+		if (*p == '-'){
+			last = strtol(p + 1, &p, 10);
+		}
+		for (long cpu = first; cpu <= last && cpu < NUMA_MAX_CPUS; cpu++){
+			if (topology->nodeOfCpu[cpu] < 0){
+				topology->nodeOfCpu[cpu] = node;
+				topology->cpus[topology->nCpus++] = cpu;
+			}
+		}
+		if (*p == ','){
+			p++;
+		}
+	}
+	return true;
+}
+
+void numaTopology(numa_topology_t *topology){
+	char path[64];
+
+	topology->nNodes = 0;
+	topology->nCpus = 0;
+	for (uint cpu = 0; cpu < NUMA_MAX_CPUS; cpu++){
+		topology->nodeOfCpu[cpu] = -1;
+	}
+
+	for (int node = 0; node < NUMA_MAX_NODES; node++){
+		uint nCpus = topology->nCpus;
+		snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+		if (readCpuList(path, node, topology) && topology->nCpus > nCpus){
+			topology->nNodes = node + 1;
+		}
+	}
+
+	// No NUMA information: one node with every online CPU
+	if (topology->nCpus == 0){
+		long nProcessors = sysconf(_SC_NPROCESSORS_ONLN);
+		nProcessors = (nProcessors < 1) ? 1 : ((nProcessors > NUMA_MAX_CPUS) ? NUMA_MAX_CPUS : nProcessors);
+		for (long cpu = 0; cpu < nProcessors; cpu++){
+			topology->nodeOfCpu[cpu] = 0;
+			topology->cpus[topology->nCpus++] = cpu;
+		}
+		topology->nNodes = 1;
+	}
+}
+
+int numaWorkerCpu(const numa_topology_t *topology, uint worker){
+	return topology->cpus[worker % topology->nCpus];
+}
+
+int numaWorkerNode(const numa_topology_t *topology, uint worker){
+	return topology->nodeOfCpu[numaWorkerCpu(topology, worker)];
+}
+
+int numaCurrentNode(const numa_topology_t *topology){
+	int cpu = sched_getcpu();
+
+	return (cpu >= 0 && cpu < NUMA_MAX_CPUS && topology->nodeOfCpu[cpu] >= 0) ? topology->nodeOfCpu[cpu] : 0;
+}
+
+int numaPinPool(worker_pool_t *pool, const numa_topology_t *topology){
+	cpu_set_t set;
+
+	for (uint i = 0; i < pool->nThreads; i++){
+		CPU_ZERO(&set);
+		CPU_SET(numaWorkerCpu(topology, i), &set);
+		int error = pthread_setaffinity_np(pool->threads[i], sizeof(set), &set);
+		if (error != 0){
+			errno = error;
+			return -1;
+		}
+	}
+	return 0;
+}
+
+// First page starting in the range and number of pages
+static uintptr_t firstPage(const void *data, size_t bytes, size_t *count){
+	uintptr_t pageSize = sysconf(_SC_PAGESIZE);
+	uintptr_t begin = ((uintptr_t)data + pageSize - 1) / pageSize * pageSize;
+	uintptr_t end = (uintptr_t)data + bytes;
+
+	*count = (end > begin) ? (end - begin + pageSize - 1) / pageSize : 0;
+	return begin;
+}
+
+void numaTouch(void *data, size_t bytes){
+	uintptr_t pageSize = sysconf(_SC_PAGESIZE);
+	size_t count;
+	uintptr_t page = firstPage(data, bytes, &count);
+
+	for (size_t i = 0; i < count; i++, page += pageSize){
+		volatile uint8_t *p = (volatile uint8_t *)page;
+		*p = *p;
+	}
+}
+
+// move_pages over the pages of the range: moves them to node, or only
+// reads their nodes into status when node < 0
+static int movePages(int node, int *status, size_t *count, uintptr_t *page){
+	uintptr_t pageSize = sysconf(_SC_PAGESIZE);
+	void *pages[NUMA_PAGE_BATCH];
+	int nodes[NUMA_PAGE_BATCH];
+	size_t n = (*count < NUMA_PAGE_BATCH) ? *count : NUMA_PAGE_BATCH;
+
+	for (size_t i = 0; i < n; i++){
+		pages[i] = (void *)(*page + i * pageSize);
+		nodes[i] = node;
+	}
+	*page += n * pageSize;
+	*count -= n;
+
+	return (int)syscall(SYS_move_pages, 0, n, pages, (node < 0) ? NULL : nodes, status, MPOL_MF_MOVE);
+}
+
+int numaMove(void *data, size_t bytes, int node){
+	int status[NUMA_PAGE_BATCH];
+	size_t count;
+	uintptr_t page = firstPage(data, bytes, &count);
+
+	while (count > 0){
+		if (movePages(node, status, &count, &page) < 0){
+			return -1;
+		}
+	}
+	return 0;
+}
+
+void numaCount(const void *data, size_t bytes, int node, numa_report_t *report){
+	int status[NUMA_PAGE_BATCH];
+	size_t count;
+	uintptr_t page = firstPage(data, bytes, &count);
+
+	while (count > 0){
+		size_t n = (count < NUMA_PAGE_BATCH) ? count : NUMA_PAGE_BATCH;
+		if (movePages(-1, status, &count, &page) < 0){
+			report->absentPages += n;
+			continue;
+		}
+		for (size_t i = 0; i < n; i++){
+			if (status[i] < 0){
+				report->absentPages++;
+			} else if (status[i] == node){
+				report->localPages[node]++;
+			} else {
+				report->remotePages[node]++;
+			}
+		}
+	}
+}
+
+void numaReportReset(numa_report_t *report, uint nNodes){
+	memset(report, 0, sizeof(numa_report_t));
+	report->nNodes = nNodes;
+}
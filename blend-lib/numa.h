@@ -0,0 +1,70 @@
+/*
+ * numa.h
+ *
+ *  Created on: Fall 2022
+ *
+ * NUMA topology, thread pinning and page placement, read from sysfs and
+ * done with the raw system calls (no libnuma). On hosts with a single
+ * node, or without NUMA support in the kernel, everything still works:
+ * the topology has one node with every online CPU and the pages are
+ * reported as local.
+ */
+
+#ifndef NUMA_H_
+#define NUMA_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "worker_pool.h"
+
+#define NUMA_MAX_NODES 64
+#define NUMA_MAX_CPUS 1024
+
+// Online CPUs of the host, grouped by node
+typedef struct {
+	uint nNodes; // Highest node with CPUs + 1
+	uint nCpus;
+	int cpus[NUMA_MAX_CPUS]; // Node 0 CPUs first, then node 1, ...
+	int nodeOfCpu[NUMA_MAX_CPUS]; // -1 for offline CPUs
+} numa_topology_t;
+
+// Pages of a placement report, per node of the workers that blend them
+typedef struct {
+	uint nNodes;
+	uint64_t localPages[NUMA_MAX_NODES]; // On the node of their worker
+	uint64_t remotePages[NUMA_MAX_NODES]; // On another node
+	uint64_t absentPages; // Never touched, or the kernel does not report them
+} numa_report_t;
+
+// Reads the topology from /sys/devices/system/node. Always succeeds: a
+// host without that directory is one node.
+void numaTopology(numa_topology_t *topology);
+
+// CPU and node of worker i of a pool: the workers are spread over the
+// CPUs in the order of topology->cpus, so consecutive workers share a node
+int numaWorkerCpu(const numa_topology_t *topology, uint worker);
+int numaWorkerNode(const numa_topology_t *topology, uint worker);
+
+// Node of the CPU running the caller (0 if unknown)
+int numaCurrentNode(const numa_topology_t *topology);
+
+// Pins worker i of the pool to numaWorkerCpu(i). Returns 0 on success and
+// -1 on error (errno set).
+int numaPinPool(worker_pool_t *pool, const numa_topology_t *topology);
+
+// The pages starting in [data, data + bytes) belong to the range, so that
+// neighbour ranges never share one. numaTouch writes every page without
+// changing it: pages never touched get allocated on the node of the caller.
+void numaTouch(void *data, size_t bytes);
+
+// Moves the pages of the range to node. Returns 0 on success and -1 on
+// error (errno set; ENOSYS or EPERM when the kernel does not allow it).
+int numaMove(void *data, size_t bytes, int node);
+
+// Adds the pages of the range to report as local or remote to node
+void numaCount(const void *data, size_t bytes, int node, numa_report_t *report);
+
+// Clears a report
+void numaReportReset(numa_report_t *report, uint nNodes);
+
+#endif /* NUMA_H_ */
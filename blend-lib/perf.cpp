@@ -0,0 +1,151 @@
+/*
+ * perf.cpp
+ *
+ *  Created on: Fall 2022
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include "perf.h"
+
+// Type and configuration of every perf_event_id_t, in its order
+static const struct {
+	uint32_t type;
+	uint64_t config;
+	const char *name;
+} PERF_EVENTS[PERF_EVENT_COUNT] = {
+	{ PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK, "task-clock" },
+	{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, "cycles" },
+	{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, "instructions" },
+	{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES, "llc-misses" },
+	{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_STALLED_CYCLES_FRONTEND, "stalled-frontend" },
+	{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_STALLED_CYCLES_BACKEND, "stalled-backend" }
+};
+
+// Layout of a read with PERF_FORMAT_TOTAL_TIME_ENABLED and _RUNNING
+typedef struct {
+	uint64_t value;
+	uint64_t timeEnabled;
+	uint64_t timeRunning;
+} perf_read_t;
+
+static int openEvent(perf_event_id_t event, pid_t tid){
+	struct perf_event_attr attr;
+
+	memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.type = PERF_EVENTS[event].type;
+	attr.config = PERF_EVENTS[event].config;
+	attr.disabled = 1;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+	attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+	return syscall(SYS_perf_event_open, &attr, tid, -1, -1, 0);
+}
+
+int perfOpen(perf_counters_t *counters, const worker_pool_t *pool){
+	uint nWorkers = (pool != NULL) ? pool->nThreads : 0;
+	bool opened = false;
+	int error = ENOENT;
+
+	counters->nThreads = 1 + nWorkers;
+	counters->fd = (int (*)[PERF_EVENT_COUNT]) malloc(counters->nThreads * sizeof(*counters->fd));
+	if (counters->fd == NULL){
+		return -1;
+	}
+
+	for (uint t = 0; t < counters->nThreads; t++){
+		// 0 is the calling thread
+		pid_t tid = (t == 0) ? 0 : pool->tids[t - 1];
+
+		for (int e = 0; e < PERF_EVENT_COUNT; e++){
+			counters->fd[t][e] = openEvent((perf_event_id_t)e, tid);
+			if (counters->fd[t][e] >= 0){
+				opened = true;
+			} else {
+				error = errno;
+			}
+		}
+	}
+
+	if (!opened){
+		perfClose(counters);
+		errno = error;
+		return -1;
+	}
+	return 0;
+}
+
+static void control(perf_counters_t *counters, unsigned long request){
+
+	for (uint t = 0; t < counters->nThreads; t++){
+		for (int e = 0; e < PERF_EVENT_COUNT; e++){
+			if (counters->fd[t][e] >= 0){
+				ioctl(counters->fd[t][e], request, 0);
+			}
+		}
+	}
+}
+
+void perfStart(perf_counters_t *counters){
+	control(counters, PERF_EVENT_IOC_RESET);
+	control(counters, PERF_EVENT_IOC_ENABLE);
+}
+
+void perfStop(perf_counters_t *counters){
+	control(counters, PERF_EVENT_IOC_DISABLE);
+}
+
+void perfRead(const perf_counters_t *counters, uint thread, perf_sample_t *sample){
+	perf_read_t data;
+
+	for (int e = 0; e < PERF_EVENT_COUNT; e++){
+		int fd = counters->fd[thread][e];
+
+		sample->present[e] = fd >= 0 && read(fd, &data, sizeof(data)) == sizeof(data);
+		sample->value[e] = 0;
+		if (!sample->present[e] || data.timeRunning == 0){
+			continue;
+		}
+		// Scaled when the kernel shared the counter with other events
+		sample->value[e] = (data.timeRunning < data.timeEnabled)
+				? (uint64_t)((double)data.value * data.timeEnabled / data.timeRunning) : data.value;
+	}
+}
+
+void perfReadTotal(const perf_counters_t *counters, perf_sample_t *sample){
+	perf_sample_t thread;
+
+	memset(sample, 0, sizeof(*sample));
+	for (uint t = 0; t < counters->nThreads; t++){
+		perfRead(counters, t, &thread);
+		for (int e = 0; e < PERF_EVENT_COUNT; e++){
+			sample->present[e] = sample->present[e] || thread.present[e];
+			sample->value[e] += thread.value[e];
+		}
+	}
+}
+
+void perfClose(perf_counters_t *counters){
+
+	for (uint t = 0; t < counters->nThreads; t++){
+		for (int e = 0; e < PERF_EVENT_COUNT; e++){
+			if (counters->fd[t][e] >= 0){
+				close(counters->fd[t][e]);
+			}
+		}
+	}
+	free(counters->fd);
+	counters->fd = NULL;
+	counters->nThreads = 0;
+}
+
+const char *perfEventName(perf_event_id_t event){
+	return PERF_EVENTS[event].name;
+}
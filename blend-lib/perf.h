@@ -0,0 +1,66 @@
+/*
+ * perf.h
+ *
+ *  Created on: Fall 2022
+ *
+ * Hardware counters of the blend (Linux perf_event_open), per thread: the
+ * calling thread and every worker of a pool. Each event is opened on its
+ * own, so an event the host does not have (virtual machines often have no
+ * PMU at all) is reported as missing instead of disabling the others.
+ * Only user-space work is counted, which perf_event_paranoid <= 2 allows.
+ */
+
+#ifndef PERF_H_
+#define PERF_H_
+
+#include <stdint.h>
+#include "worker_pool.h"
+
+// Counted events, in the order of the reports
+typedef enum {
+	PERF_TASK_CLOCK, // Nanoseconds on a CPU (software event, always present)
+	PERF_CYCLES,
+	PERF_INSTRUCTIONS,
+	PERF_LLC_MISSES, // Last-level cache misses: lines brought from memory
+	PERF_STALLED_FRONTEND, // Cycles without instructions issued
+	PERF_STALLED_BACKEND, // Cycles waiting on data or execution units
+	PERF_EVENT_COUNT
+} perf_event_id_t;
+
+// Values of one thread, or of all of them. Events multiplexed by the
+// kernel are scaled to the whole measured time.
+typedef struct {
+	bool present[PERF_EVENT_COUNT];
+	uint64_t value[PERF_EVENT_COUNT];
+} perf_sample_t;
+
+// Counters of the calling thread (thread 0) and of the workers of a pool
+// (threads 1 to nThreads - 1)
+typedef struct {
+	uint nThreads;
+	int (*fd)[PERF_EVENT_COUNT]; // -1 for events the host does not have
+} perf_counters_t;
+
+// Opens the counters, stopped. pool may be NULL (calling thread only).
+// Returns 0 if at least one event can be counted and -1 otherwise (errno
+// set, e.g. EACCES when perf_event_paranoid forbids it).
+int perfOpen(perf_counters_t *counters, const worker_pool_t *pool);
+
+// Clears and starts every counter
+void perfStart(perf_counters_t *counters);
+
+// Stops every counter
+void perfStop(perf_counters_t *counters);
+
+// Values of one thread since perfStart
+void perfRead(const perf_counters_t *counters, uint thread, perf_sample_t *sample);
+
+// Sum of every thread
+void perfReadTotal(const perf_counters_t *counters, perf_sample_t *sample);
+
+void perfClose(perf_counters_t *counters);
+
+// Short name of the event, as printed in the reports
+const char *perfEventName(perf_event_id_t event);
+
+#endif /* PERF_H_ */
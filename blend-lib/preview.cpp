@@ -0,0 +1,126 @@
+/*
+ * preview.cpp
+ *
+ *  Created on: Fall 2022
+ */
+
+#include <errno.h>
+#include "preview.h"
+#include "engine.h"
+
+// Input pixels of a row averaged at a time: whole blocks of the box
+// kernels of every instruction set, runs long enough for the prefetchers
+#define PREVIEW_RUN 2048
+
+// Output rows of one worker, in a single block
+typedef struct {
+	const blend_image_t *src;
+	const blend_image_t *filter;
+	const blend_image_t *dst;
+	plane_kernel_t planeKernel;
+	box_kernel_t boxKernel;
+	uint factor;
+	uint firstRow;
+	uint endRow;
+} preview_args_t;
+
+// Average of the box cut by the right edge: rows [y0, y1), pixels [x0, width)
+static data_t edgeAverage(const blend_plane_t *plane, uint width, uint y0, uint y1, uint x0){
+	float sum = 0;
+
+	for (uint y = y0; y < y1; y++){
+		for (uint x = x0; x < width; x++){
+			sum += plane->data[y * plane->stride + x];
+		}
+	}
+#ifndef UINT8_PIPELINE
+	return sum / ((width - x0) * (y1 - y0));
+#else
+	return (uint32_t)(sum / ((width - x0) * (y1 - y0)) + 0.5f);
+#endif
+}
+
+// Averages of the boxes [x, x + count) of output row y0 / factor
+static void averageBoxes(const preview_args_t *params, const blend_plane_t *plane, uint y0, uint y1, uint x,
+		uint count, data_t *boxes){
+	uint width = params->src->width;
+	uint factor = params->factor;
+	uint whole = (x + count <= width / factor) ? count : width / factor - x;
+
+	params->boxKernel(plane->data + y0 * plane->stride + x * factor, plane->stride, y1 - y0, factor, boxes, whole);
+	if (whole < count){
+		boxes[whole] = edgeAverage(plane, width, y0, y1, (x + whole) * factor);
+	}
+}
+
+static void *PreviewThread(void *args){
+	const preview_args_t *params = (preview_args_t *)args;
+	const blend_plane_t *srcPlanes[] = { &params->src->r, &params->src->g, &params->src->b };
+	const blend_plane_t *filterPlanes[] = { &params->filter->r, &params->filter->g, &params->filter->b };
+	const blend_plane_t *dstPlanes[] = { &params->dst->r, &params->dst->g, &params->dst->b };
+	uint factor = params->factor;
+	uint height = params->src->height;
+	uint runBoxes = PREVIEW_RUN / factor;
+	data_t srcBoxes[PREVIEW_RUN / 2];
+	data_t filterBoxes[PREVIEW_RUN / 2];
+
+	for (uint row = params->firstRow; row < params->endRow; row++){
+		uint y0 = row * factor;
+		uint y1 = (height - y0 < factor) ? height : y0 + factor;
+
+		for (uint p = 0; p < 3; p++){
+			data_t *dst = dstPlanes[p]->data + row * dstPlanes[p]->stride;
+
+			for (uint x = 0; x < params->dst->width; x += runBoxes){
+				uint count = (params->dst->width - x < runBoxes) ? params->dst->width - x : runBoxes;
+
+				averageBoxes(params, srcPlanes[p], y0, y1, x, count, srcBoxes);
+				averageBoxes(params, filterPlanes[p], y0, y1, x, count, filterBoxes);
+				params->planeKernel(srcBoxes, filterBoxes, dst + x, count);
+			}
+		}
+	}
+
+	return NULL;
+}
+
+int blendPreviewSize(uint width, uint height, uint factor, uint *previewWidth, uint *previewHeight){
+
+	if (factor != 2 && factor != 4 && factor != 8){
+		errno = EINVAL;
+		return -1;
+	}
+	*previewWidth = (width + factor - 1) / factor;
+	*previewHeight = (height + factor - 1) / factor;
+
+	return 0;
+}
+
+int blendImagePreview(blend_context_t *ctx, const blend_image_t *src, const blend_image_t *filter, const blend_image_t *dst,
+		uint factor){
+	preview_args_t params[MAX_THREADS];
+	uint nThreads = ctx->pool.nThreads;
+	uint width, height;
+
+	if (blendPreviewSize(src->width, src->height, factor, &width, &height) != 0
+			|| filter->width != src->width || filter->height != src->height
+			|| dst->width != width || dst->height != height){
+		errno = EINVAL;
+		return -1;
+	}
+
+	for (uint i = 0; i < nThreads; i++){
+		params[i].src = src;
+		params[i].filter = filter;
+		params[i].dst = dst;
+		params[i].planeKernel = ctx->planeKernel;
+		params[i].boxKernel = ctx->boxKernel;
+		params[i].factor = factor;
+		params[i].firstRow = (uint)((uint64_t)height * i / nThreads);
+		params[i].endRow = (uint)((uint64_t)height * (i + 1) / nThreads);
+		poolSubmit(&ctx->pool, PreviewThread, &params[i]);
+	}
+	poolWait(&ctx->pool);
+
+	return 0;
+}
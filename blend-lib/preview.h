@@ -0,0 +1,30 @@
+/*
+ * preview.h
+ *
+ *  Created on: Fall 2022
+ *
+ * Reduced-resolution blend for display: every pixel of the preview is the
+ * blend of the averages of a box of factor x factor pixels of the source
+ * and of the filter. The boxes are averaged while the inputs are read and
+ * the blend runs on the averages, so the inputs are read once and only
+ * 1 / factor^2 of the pixels go through the kernel.
+ */
+
+#ifndef PREVIEW_H_
+#define PREVIEW_H_
+
+#include "blend.h"
+
+// Size of the preview of a width x height image: the boxes of the right
+// and bottom edges may be partial. Returns 0, or -1 if factor is not 2, 4
+// or 8 (errno is EINVAL).
+int blendPreviewSize(uint width, uint height, uint factor, uint *previewWidth, uint *previewHeight);
+
+// dst = Overlap(box(src), box(filter)) with boxes of factor x factor
+// pixels. src and filter must have the same size and dst the size given by
+// blendPreviewSize. The mode and precision of ctx are used. Returns 0 on
+// success and -1 if the sizes or the factor do not match (errno is EINVAL).
+int blendImagePreview(blend_context_t *ctx, const blend_image_t *src, const blend_image_t *filter, const blend_image_t *dst,
+		uint factor);
+
+#endif /* PREVIEW_H_ */
@@ -0,0 +1,115 @@
+/*
+ * profile.cpp
+ *
+ *  Created on: Fall 2022
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "profile.h"
+
+// Names of tune_engine_t, in its order
+static const char *ENGINE_NAMES[] = { "serial", "static", "stealing" };
+
+const char *profilePath(const char *path){
+
+	if (path != NULL){
+		return path;
+	}
+	const char *env = getenv("BLEND_PROFILE");
+	return (env != NULL && env[0] != '\0') ? env : BLEND_PROFILE_PATH;
+}
+
+const char *tuneEngineName(tune_engine_t engine){
+	return ENGINE_NAMES[engine];
+}
+
+static int engineFromName(const char *name, tune_engine_t *engine){
+
+	for (uint i = 0; i < sizeof(ENGINE_NAMES) / sizeof(ENGINE_NAMES[0]); i++){
+		if (strcmp(name, ENGINE_NAMES[i]) == 0){
+			*engine = (tune_engine_t)i;
+			return 0;
+		}
+	}
+	return -1;
+}
+
+// One line of the file: 0 if it is valid (or a comment), -1 otherwise
+static int parseLine(const char *line, blend_profile_t *profile){
+	char key[16], kernel[16], engine[16];
+	uint threads;
+	tune_bucket_t bucket;
+
+	if (sscanf(line, "%15s", key) != 1 || key[0] == '#'){
+		return 0;
+	}
+	if (strcmp(key, "threads") == 0 && sscanf(line, "%*s %u", &threads) == 1 && threads > 0){
+		profile->threads = threads;
+		return 0;
+	}
+	if (strcmp(key, "bucket") == 0 && profile->nBuckets < PROFILE_MAX_BUCKETS
+			&& sscanf(line, "%*s %u %15s %15s %u", &bucket.maxPixels, kernel, engine, &bucket.tilePixels) == 4
+			&& kernelFromName(kernel, &bucket.isa) == 0 && kernelSupported(bucket.isa)
+			&& engineFromName(engine, &bucket.engine) == 0){
+		profile->buckets[profile->nBuckets++] = bucket;
+		return 0;
+	}
+	return -1;
+}
+
+int profileLoad(blend_profile_t *profile, const char *path){
+	FILE *file = fopen(profilePath(path), "r");
+	char line[256];
+	int status = 0;
+
+	if (file == NULL){
+		return -1;
+	}
+
+	profile->threads = 0;
+	profile->nBuckets = 0;
+	while (status == 0 && fgets(line, sizeof(line), file) != NULL){
+		status = parseLine(line, profile);
+	}
+	fclose(file);
+
+	if (status != 0 || profile->threads == 0 || profile->nBuckets == 0){
+		errno = EINVAL;
+		return -1;
+	}
+	return 0;
+}
+
+int profileSave(const blend_profile_t *profile, const char *path){
+	FILE *file = fopen(profilePath(path), "w");
+
+	if (file == NULL){
+		return -1;
+	}
+
+	fprintf(file, "# Blend tuning profile, written by --autotune\n");
+	fprintf(file, "threads %u\n", profile->threads);
+	for (uint i = 0; i < profile->nBuckets; i++){
+		const tune_bucket_t *bucket = &profile->buckets[i];
+		fprintf(file, "bucket %u %s %s %u\n", bucket->maxPixels, kernelName(bucket->isa),
+				tuneEngineName(bucket->engine), bucket->tilePixels);
+	}
+
+	if (fclose(file) != 0){
+		return -1;
+	}
+	return 0;
+}
+
+const tune_bucket_t *profileLookup(const blend_profile_t *profile, uint pixelCount){
+
+	for (uint i = 0; i < profile->nBuckets; i++){
+		if (pixelCount <= profile->buckets[i].maxPixels){
+			return &profile->buckets[i];
+		}
+	}
+	return &profile->buckets[profile->nBuckets - 1];
+}
@@ -0,0 +1,66 @@
+/*
+ * profile.h
+ *
+ *  Created on: Fall 2022
+ *
+ * Tuning profile of a host: the fastest kernel, engine and tile for every
+ * bucket of image sizes, and the number of workers. It is written by the
+ * autotuner of the program (--autotune) and read by blendCreate, so the
+ * choice is measured once per machine instead of being compiled in.
+ *
+ * File format, one setting per line ('#' starts a comment):
+ *   threads <workers>
+ *   bucket <max pixels> <kernel> <serial|static|stealing> <tile pixels>
+ * Buckets are sorted by their maximum number of pixels; the last one also
+ * takes larger images.
+ */
+
+#ifndef PROFILE_H_
+#define PROFILE_H_
+
+#include "kernels.h"
+
+// Default file, in the working directory (the BLEND_PROFILE environment
+// variable overrides it)
+#define BLEND_PROFILE_PATH "blend.profile"
+
+#define PROFILE_MAX_BUCKETS 16
+
+// How an image of a bucket is run
+typedef enum {
+	TUNE_SERIAL, // Whole image on the calling thread
+	TUNE_STATIC, // One slice per worker (tiled when tilePixels > 0)
+	TUNE_STEALING // Chunks of tilePixels stolen between workers
+} tune_engine_t;
+
+typedef struct {
+	uint maxPixels;
+	kernel_isa_t isa;
+	tune_engine_t engine;
+	uint tilePixels;
+} tune_bucket_t;
+
+typedef struct {
+	uint threads;
+	uint nBuckets;
+	tune_bucket_t buckets[PROFILE_MAX_BUCKETS];
+} blend_profile_t;
+
+// File of the profile: path, or BLEND_PROFILE, or BLEND_PROFILE_PATH
+const char *profilePath(const char *path);
+
+// Reads a profile (path as in profilePath). Returns 0 on success and -1
+// if the file cannot be read or is not valid for this host (errno is
+// EINVAL when a kernel is not supported or a line is malformed).
+int profileLoad(blend_profile_t *profile, const char *path);
+
+// Writes a profile. Returns 0 on success and -1 on error (errno set).
+int profileSave(const blend_profile_t *profile, const char *path);
+
+// Bucket of an image of pixelCount pixels
+const tune_bucket_t *profileLookup(const blend_profile_t *profile, uint pixelCount);
+
+// Name of the engine, as written in the file
+const char *tuneEngineName(tune_engine_t engine);
+
+#endif /* PROFILE_H_ */
@@ -0,0 +1,381 @@
+/*
+ * region.cpp
+ *
+ *  Created on: Fall 2022
+ */
+
+#include <errno.h>
+#include <string.h>
+#include "region.h"
+#include "engine.h"
+
+// Rows a worker takes at a time, in turns with the other workers
+#define REGION_ROW_CHUNK 8
+
+// Pixels of a partially covered run blended at a time into the scratch
+#define SCRATCH_PIXELS 256
+
+// Rows of the region for one worker: chunks worker, worker + nWorkers...
+typedef struct {
+	const blend_image_t *src; // Planar images, or NULL
+	const blend_image_t *filter;
+	const blend_image_t *dst;
+	const blend_frame_t *srcFrame; // Interleaved frames, or NULL
+	const blend_frame_t *filterFrame;
+	const blend_frame_t *dstFrame;
+	plane_kernel_t planeKernel;
+	byte_kernel_t byteKernel;
+	rgba_kernel_t rgbaKernel;
+	const blend_rect_t *rects; // Or mask
+	uint nRects;
+	const blend_mask_t *mask;
+	uint width;
+	uint height;
+	uint worker;
+	uint nWorkers;
+} region_args_t;
+
+static uint8_t *frameRow(const blend_frame_t *frame, uint y){
+	return frame->data + (ptrdiff_t)y * frame->stride;
+}
+
+static data_t mix(data_t src, data_t blended, uint coverage){
+#ifdef UINT8_PIPELINE
+	return (src * (255 - coverage) + blended * coverage + 127) / 255;
+#else
+	return src + (blended - src) * (coverage * (1.0f / 255.0f));
+#endif
+}
+
+static uint8_t mixByte(uint8_t src, uint8_t blended, uint coverage){
+	return (src * (255 - coverage) + blended * coverage + 127) / 255;
+}
+
+// Pixels [x0, x1) of row y, fully covered: straight through the kernels
+static void blendSpan(const region_args_t *params, uint y, uint x0, uint x1){
+
+	if (params->src != NULL){
+		const blend_plane_t *srcPlanes[] = { &params->src->r, &params->src->g, &params->src->b };
+		const blend_plane_t *filterPlanes[] = { &params->filter->r, &params->filter->g, &params->filter->b };
+		const blend_plane_t *dstPlanes[] = { &params->dst->r, &params->dst->g, &params->dst->b };
+
+		for (uint p = 0; p < 3; p++){
+			params->planeKernel(srcPlanes[p]->data + y * srcPlanes[p]->stride + x0,
+					filterPlanes[p]->data + y * filterPlanes[p]->stride + x0,
+					dstPlanes[p]->data + y * dstPlanes[p]->stride + x0, x1 - x0);
+		}
+		return;
+	}
+
+	uint channels = params->dstFrame->channels;
+	const uint8_t *src = frameRow(params->srcFrame, y) + x0 * channels;
+	const uint8_t *filter = frameRow(params->filterFrame, y) + x0 * channels;
+	uint8_t *dst = frameRow(params->dstFrame, y) + x0 * channels;
+
+	if (channels == 4){
+		params->rgbaKernel(src, filter, dst, x1 - x0);
+	} else {
+		params->byteKernel(src, filter, dst, (x1 - x0) * channels);
+	}
+}
+
+// Pixels [x0, x1) of row y, covered by coverage[0, x1 - x0): blended into
+// a scratch run and mixed with the source
+static void blendSpanPartial(const region_args_t *params, uint y, uint x0, uint x1, const uint8_t *coverage){
+
+	for (uint x = x0; x < x1; x += SCRATCH_PIXELS){
+		uint count = (x1 - x < SCRATCH_PIXELS) ? x1 - x : SCRATCH_PIXELS;
+		const uint8_t *runCoverage = coverage + (x - x0);
+
+		if (params->src != NULL){
+			const blend_plane_t *srcPlanes[] = { &params->src->r, &params->src->g, &params->src->b };
+			const blend_plane_t *filterPlanes[] = { &params->filter->r, &params->filter->g, &params->filter->b };
+			const blend_plane_t *dstPlanes[] = { &params->dst->r, &params->dst->g, &params->dst->b };
+			data_t scratch[SCRATCH_PIXELS];
+
+			for (uint p = 0; p < 3; p++){
+				const data_t *src = srcPlanes[p]->data + y * srcPlanes[p]->stride + x;
+				data_t *dst = dstPlanes[p]->data + y * dstPlanes[p]->stride + x;
+
+				params->planeKernel(src, filterPlanes[p]->data + y * filterPlanes[p]->stride + x, scratch, count);
+				for (uint i = 0; i < count; i++){
+					dst[i] = mix(src[i], scratch[i], runCoverage[i]);
+				}
+			}
+			continue;
+		}
+
+		uint channels = params->dstFrame->channels;
+		const uint8_t *src = frameRow(params->srcFrame, y) + x * channels;
+		const uint8_t *filter = frameRow(params->filterFrame, y) + x * channels;
+		uint8_t *dst = frameRow(params->dstFrame, y) + x * channels;
+		uint8_t scratch[SCRATCH_PIXELS * 4];
+
+		if (channels == 4){
+			params->rgbaKernel(src, filter, scratch, count);
+		} else {
+			params->byteKernel(src, filter, scratch, count * channels);
+		}
+		// The alpha of the scratch is that of src, so it is kept
+		for (uint i = 0; i < count * channels; i++){
+			dst[i] = mixByte(src[i], scratch[i], runCoverage[i / channels]);
+		}
+	}
+}
+
+static void blendRectsRow(const region_args_t *params, uint y){
+
+	for (uint r = 0; r < params->nRects; r++){
+		const blend_rect_t *rect = &params->rects[r];
+
+		if (y < rect->y || y - rect->y >= rect->height || rect->x >= params->width){
+			continue;
+		}
+		uint width = (rect->width < params->width - rect->x) ? rect->width : params->width - rect->x;
+		if (width > 0){
+			blendSpan(params, y, rect->x, rect->x + width);
+		}
+	}
+}
+
+static bool maskBit(const uint8_t *row, uint x){
+	return (row[x >> 3] >> (x & 7)) & 1;
+}
+
+// End of the run of pixels from x with the bit of x. Whole 64-bit words
+// of that value are skipped with one test.
+static uint bitRunEnd(const uint8_t *row, uint x, uint width){
+	bool covered = maskBit(row, x);
+	uint64_t uniform = covered ? ~(uint64_t)0 : 0;
+	uint64_t word;
+
+	while (x < width){
+		if ((x & 63) == 0 && width - x >= 64){
+			memcpy(&word, row + (x >> 3), sizeof(word));
+			if (word == uniform){
+				x += 64;
+				continue;
+			}
+		}
+		if (maskBit(row, x) != covered){
+			break;
+		}
+		x++;
+	}
+	return x;
+}
+
+// Uncovered, partially covered or fully covered
+static uint coverageClass(uint8_t coverage){
+	return (coverage == 0) ? 0 : (coverage == 255) ? 2 : 1;
+}
+
+// End of the run of pixels from x with the class of x. Uncovered and
+// fully covered runs are tested 32 pixels at a time.
+static uint byteRunEnd(const uint8_t *row, uint x, uint width){
+	uint runClass = coverageClass(row[x]);
+	uint64_t uniform = (runClass == 0) ? 0 : ~(uint64_t)0;
+	uint64_t words[4];
+
+	while (x < width){
+		if (runClass != 1 && width - x >= 32){
+			memcpy(words, row + x, sizeof(words));
+			if (((words[0] ^ uniform) | (words[1] ^ uniform) | (words[2] ^ uniform) | (words[3] ^ uniform)) == 0){
+				x += 32;
+				continue;
+			}
+		}
+		if (coverageClass(row[x]) != runClass){
+			break;
+		}
+		x++;
+	}
+	return x;
+}
+
+static void blendMaskRow(const region_args_t *params, uint y){
+	const blend_mask_t *mask = params->mask;
+	const uint8_t *row = mask->data + (ptrdiff_t)y * mask->stride;
+	uint x = 0;
+
+	while (x < params->width){
+		if (mask->format == BLEND_MASK_BITS){
+			uint end = bitRunEnd(row, x, params->width);
+			if (maskBit(row, x)){
+				blendSpan(params, y, x, end);
+			}
+			x = end;
+			continue;
+		}
+
+		uint end = byteRunEnd(row, x, params->width);
+		uint runClass = coverageClass(row[x]);
+		if (runClass == 2){
+			blendSpan(params, y, x, end);
+		}
+		else if (runClass == 1){
+			blendSpanPartial(params, y, x, end, row + x);
+		}
+		x = end;
+	}
+}
+
+static void *RegionThread(void *args){
+	const region_args_t *params = (region_args_t *)args;
+	uint step = params->nWorkers * REGION_ROW_CHUNK;
+
+	for (uint row = params->worker * REGION_ROW_CHUNK; row < params->height; row += step){
+		uint rowEnd = (params->height - row < REGION_ROW_CHUNK) ? params->height : row + REGION_ROW_CHUNK;
+
+		for (uint y = row; y < rowEnd; y++){
+			if (params->mask != NULL){
+				blendMaskRow(params, y);
+			} else {
+				blendRectsRow(params, y);
+			}
+		}
+	}
+
+	return NULL;
+}
+
+static void runRegion(blend_context_t *ctx, const region_args_t *proto){
+	region_args_t params[MAX_THREADS];
+	uint nThreads = ctx->pool.nThreads;
+
+	for (uint i = 0; i < nThreads; i++){
+		params[i] = *proto;
+		params[i].worker = i;
+		params[i].nWorkers = nThreads;
+		poolSubmit(&ctx->pool, RegionThread, &params[i]);
+	}
+	poolWait(&ctx->pool);
+}
+
+// Part of the rectangle inside the image, along one axis
+static void clipRange(uint start, uint length, uint size, uint *rangeStart, uint *rangeEnd){
+	*rangeStart = (start < size) ? start : size;
+	*rangeEnd = *rangeStart + ((length < size - *rangeStart) ? length : size - *rangeStart);
+}
+
+bool blendRectsOverlap(const blend_rect_t *rects, uint nRects, uint width, uint height){
+
+	for (uint i = 0; i < nRects; i++){
+		uint ax0, ax1, ay0, ay1;
+		clipRange(rects[i].x, rects[i].width, width, &ax0, &ax1);
+		clipRange(rects[i].y, rects[i].height, height, &ay0, &ay1);
+
+		for (uint j = i + 1; j < nRects; j++){
+			uint bx0, bx1, by0, by1;
+			clipRange(rects[j].x, rects[j].width, width, &bx0, &bx1);
+			clipRange(rects[j].y, rects[j].height, height, &by0, &by1);
+			if (ax0 < bx1 && bx0 < ax1 && ay0 < by1 && by0 < ay1){
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+static bool imagesMatch(const blend_image_t *src, const blend_image_t *filter, const blend_image_t *dst){
+	return src->width == filter->width && src->height == filter->height
+			&& src->width == dst->width && src->height == dst->height;
+}
+
+static bool maskMatches(const blend_mask_t *mask, uint width, uint height){
+	size_t rowBytes = (mask->format == BLEND_MASK_BITS) ? (width + 7) / 8 : width;
+	size_t step = (mask->stride > 0) ? mask->stride : -mask->stride;
+
+	return mask->width == width && mask->height == height && step >= rowBytes;
+}
+
+static void imageArgs(const blend_context_t *ctx, const blend_image_t *src, const blend_image_t *filter, const blend_image_t *dst,
+		region_args_t *params){
+
+	memset(params, 0, sizeof(*params));
+	params->src = src;
+	params->filter = filter;
+	params->dst = dst;
+	params->planeKernel = ctx->planeKernel;
+	params->width = dst->width;
+	params->height = dst->height;
+}
+
+static void frameArgs(const blend_context_t *ctx, const blend_frame_t *src, const blend_frame_t *filter, const blend_frame_t *dst,
+		region_args_t *params){
+
+	memset(params, 0, sizeof(*params));
+	params->srcFrame = src;
+	params->filterFrame = filter;
+	params->dstFrame = dst;
+	params->byteKernel = ctx->byteKernel;
+	params->rgbaKernel = ctx->rgbaKernel;
+	params->width = dst->width;
+	params->height = dst->height;
+}
+
+int blendImageRects(blend_context_t *ctx, const blend_image_t *src, const blend_image_t *filter, const blend_image_t *dst,
+		const blend_rect_t *rects, uint nRects){
+	region_args_t params;
+
+	if (!imagesMatch(src, filter, dst) || blendRectsOverlap(rects, nRects, dst->width, dst->height)){
+		errno = EINVAL;
+		return -1;
+	}
+
+	imageArgs(ctx, src, filter, dst, &params);
+	params.rects = rects;
+	params.nRects = nRects;
+	runRegion(ctx, &params);
+
+	return 0;
+}
+
+int blendImageMasked(blend_context_t *ctx, const blend_image_t *src, const blend_image_t *filter, const blend_image_t *dst,
+		const blend_mask_t *mask){
+	region_args_t params;
+
+	if (!imagesMatch(src, filter, dst) || !maskMatches(mask, dst->width, dst->height)){
+		errno = EINVAL;
+		return -1;
+	}
+
+	imageArgs(ctx, src, filter, dst, &params);
+	params.mask = mask;
+	runRegion(ctx, &params);
+
+	return 0;
+}
+
+int blendFrameRects(blend_context_t *ctx, const blend_frame_t *src, const blend_frame_t *filter, const blend_frame_t *dst,
+		const blend_rect_t *rects, uint nRects){
+	region_args_t params;
+
+	if (!blendFramesMatch(src, filter, dst) || blendRectsOverlap(rects, nRects, dst->width, dst->height)){
+		errno = EINVAL;
+		return -1;
+	}
+
+	frameArgs(ctx, src, filter, dst, &params);
+	params.rects = rects;
+	params.nRects = nRects;
+	runRegion(ctx, &params);
+
+	return 0;
+}
+
+int blendFrameMasked(blend_context_t *ctx, const blend_frame_t *src, const blend_frame_t *filter, const blend_frame_t *dst,
+		const blend_mask_t *mask){
+	region_args_t params;
+
+	if (!blendFramesMatch(src, filter, dst) || !maskMatches(mask, dst->width, dst->height)){
+		errno = EINVAL;
+		return -1;
+	}
+
+	frameArgs(ctx, src, filter, dst, &params);
+	params.mask = mask;
+	runRegion(ctx, &params);
+
+	return 0;
+}
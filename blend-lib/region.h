@@ -0,0 +1,72 @@
+/*
+ * region.h
+ *
+ *  Created on: Fall 2022
+ *
+ * Blends restricted to the part of the image an overlay covers: a list of
+ * rectangles or a coverage mask. Uncovered spans are skipped whole (a
+ * test covers 64 pixels of a bit mask or 32 of a byte mask), so a blend
+ * costs its covered area rather than the size of the image. Pixels that
+ * are not covered are never written: blend in place (dst = src) to keep
+ * the source there.
+ */
+
+#ifndef REGION_H_
+#define REGION_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "blend.h"
+#include "frame.h"
+
+// Rectangle of pixels, from the top-left corner of the image. The part
+// outside the image is ignored.
+typedef struct {
+	uint x;
+	uint y;
+	uint width;
+	uint height;
+} blend_rect_t;
+
+typedef enum {
+	BLEND_MASK_BITS, // 1 bit per pixel, the first pixel in the lowest bit of a byte: covered or not
+	BLEND_MASK_BYTES // 1 byte per pixel: coverage from 0 (none) to 255 (full)
+} blend_mask_format_t;
+
+// Borrowed coverage mask of the size of the image
+typedef struct {
+	const uint8_t *data; // Top row
+	ptrdiff_t stride; // Bytes from a row to the one below it
+	uint width;
+	uint height;
+	blend_mask_format_t format;
+} blend_mask_t;
+
+// True when two of the rectangles share a pixel of a width x height image
+// (UINT_MAX x UINT_MAX before the size is known)
+bool blendRectsOverlap(const blend_rect_t *rects, uint nRects, uint width, uint height);
+
+// dst = Overlap(src, filter) on the pixels of the rectangles, which must
+// not overlap. The three images must have the same size (no filter
+// sampling). Rows are shared between the workers in chunks, so the work
+// is balanced whatever the rows the rectangles cover. Returns 0 on
+// success and -1 if the sizes do not match or two rectangles overlap
+// (errno is EINVAL).
+int blendImageRects(blend_context_t *ctx, const blend_image_t *src, const blend_image_t *filter, const blend_image_t *dst,
+		const blend_rect_t *rects, uint nRects);
+
+// dst = src + (Overlap(src, filter) - src) * coverage / 255 on the
+// covered pixels of mask (fully covered ones go straight through the
+// kernel). Returns 0 on success and -1 if the sizes do not match (errno is EINVAL).
+int blendImageMasked(blend_context_t *ctx, const blend_image_t *src, const blend_image_t *filter, const blend_image_t *dst,
+		const blend_mask_t *mask);
+
+// Same as blendImageRects and blendImageMasked for interleaved frames
+// (see blendFrame). The alpha of 4-channel frames is kept from src.
+int blendFrameRects(blend_context_t *ctx, const blend_frame_t *src, const blend_frame_t *filter, const blend_frame_t *dst,
+		const blend_rect_t *rects, uint nRects);
+
+int blendFrameMasked(blend_context_t *ctx, const blend_frame_t *src, const blend_frame_t *filter, const blend_frame_t *dst,
+		const blend_mask_t *mask);
+
+#endif /* REGION_H_ */
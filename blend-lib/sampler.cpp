@@ -0,0 +1,127 @@
+/*
+ * sampler.cpp
+ *
+ *  Created on: Fall 2022
+ */
+
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+#include "sampler.h"
+
+// Names of blend_filter_mode_t, in its order
+static const char *SAMPLER_NAMES[] = { "exact", "wrap", "nearest", "bilinear" };
+
+// Filter coordinate sampled by destination coordinate i of size (the
+// centers of the pixels are aligned): the first one and the weight of the next
+static uint sampleAt(uint i, uint size, uint filterSize, blend_filter_mode_t mode, float *weight){
+
+	if (mode == BLEND_FILTER_NEAREST){
+		*weight = 0.0f;
+		return (uint)(((uint64_t)2 * i + 1) * filterSize / ((uint64_t)2 * size));
+	}
+
+	double s = (i + 0.5) * filterSize / size - 0.5;
+	s = (s < 0.0) ? 0.0 : s;
+	uint first = (uint)s;
+	if (first >= filterSize - 1){
+		*weight = 0.0f;
+		return filterSize - 1;
+	}
+	*weight = (float)(s - first);
+	return first;
+}
+
+int samplerCreate(filter_sampler_t *sampler, blend_filter_mode_t mode, uint width, uint height,
+		uint filterWidth, uint filterHeight, buffer_pool_t *buffers){
+
+	sampler->mode = mode;
+	sampler->width = width;
+	sampler->height = height;
+	sampler->filterWidth = filterWidth;
+	sampler->filterHeight = filterHeight;
+	sampler->column = NULL;
+	sampler->weight = NULL;
+	sampler->buffers = buffers;
+
+	if (filterWidth == 0 || filterHeight == 0 || mode == BLEND_FILTER_EXACT){
+		errno = EINVAL;
+		return -1;
+	}
+	if (mode == BLEND_FILTER_WRAP){
+		return 0;
+	}
+
+	sampler->column = (uint *) bufferAcquire(buffers, (size_t)width * (sizeof(uint) + sizeof(float)));
+	if (sampler->column == NULL){
+		return -1;
+	}
+	sampler->weight = (float *)(sampler->column + width);
+	for (uint x = 0; x < width; x++){
+		sampler->column[x] = sampleAt(x, width, filterWidth, mode, &sampler->weight[x]);
+	}
+	return 0;
+}
+
+sampler_row_t samplerRow(const filter_sampler_t *sampler, uint y){
+	sampler_row_t rows;
+
+	if (sampler->mode == BLEND_FILTER_WRAP){
+		rows.row0 = rows.row1 = y % sampler->filterHeight;
+		rows.weight = 0.0f;
+		return rows;
+	}
+
+	rows.row0 = sampleAt(y, sampler->height, sampler->filterHeight, sampler->mode, &rows.weight);
+	rows.row1 = (rows.row0 + 1 < sampler->filterHeight) ? rows.row0 + 1 : rows.row0;
+	return rows;
+}
+
+void samplerFill(const filter_sampler_t *sampler, sampler_row_t rows, const data_t *plane, size_t stride, data_t *row){
+	const data_t *row0 = plane + rows.row0 * stride;
+	const data_t *row1 = plane + rows.row1 * stride;
+	uint last = sampler->filterWidth - 1;
+
+	if (sampler->mode == BLEND_FILTER_NEAREST){
+		for (uint x = 0; x < sampler->width; x++){
+			row[x] = row0[sampler->column[x]];
+		}
+		return;
+	}
+
+	for (uint x = 0; x < sampler->width; x++){
+		uint c0 = sampler->column[x];
+		uint c1 = (c0 < last) ? c0 + 1 : c0;
+		float wx = sampler->weight[x];
+		float top = row0[c0] + (row0[c1] - (float)row0[c0]) * wx;
+		float bottom = row1[c0] + (row1[c1] - (float)row1[c0]) * wx;
+		float z = top + (bottom - top) * rows.weight;
+
+		#ifdef UINT8_PIPELINE
+		row[x] = (data_t)(z + 0.5f);
+		#else
+		row[x] = z;
+		#endif
+	}
+}
+
+const char *samplerName(blend_filter_mode_t mode){
+	return SAMPLER_NAMES[mode];
+}
+
+int samplerFromName(const char *name, blend_filter_mode_t *mode){
+
+	for (uint i = 0; i < sizeof(SAMPLER_NAMES) / sizeof(SAMPLER_NAMES[0]); i++){
+		if (strcmp(name, SAMPLER_NAMES[i]) == 0){
+			*mode = (blend_filter_mode_t)i;
+			return 0;
+		}
+	}
+	return -1;
+}
+
+void samplerDestroy(filter_sampler_t *sampler){
+	bufferRelease(sampler->buffers, sampler->column);
+	sampler->column = NULL;
+	sampler->weight = NULL;
+}
@@ -0,0 +1,67 @@
+/*
+ * sampler.h
+ *
+ *  Created on: Fall 2022
+ *
+ * Filters of another size than the source, read through an addressing
+ * mode instead of being resized first. Only one row of the filter, as
+ * seen by the destination, exists at a time: tiled rows are read in
+ * place and scaled rows are built in a scratch row of the worker.
+ */
+
+#ifndef SAMPLER_H_
+#define SAMPLER_H_
+
+#include <stddef.h>
+#include "buffer_pool.h"
+#include "kernels.h"
+
+// How a filter of another size covers the source
+typedef enum {
+	BLEND_FILTER_EXACT, // Same size only
+	BLEND_FILTER_WRAP, // Repeated as a texture, not scaled
+	BLEND_FILTER_NEAREST, // Scaled to the source, nearest pixel
+	BLEND_FILTER_BILINEAR // Scaled to the source, bilinear interpolation
+} blend_filter_mode_t;
+
+// Filter pixels read by every column of the destination
+typedef struct {
+	blend_filter_mode_t mode;
+	uint width; // Destination
+	uint height;
+	uint filterWidth;
+	uint filterHeight;
+	uint *column; // First filter column of every destination column (scaled modes)
+	float *weight; // Weight of the next column (bilinear)
+	buffer_pool_t *buffers; // Of the two tables, one buffer
+} filter_sampler_t;
+
+// Filter row read by destination row y, built (scaled modes) or found
+// (wrap) once for the three planes
+typedef struct {
+	uint row0;
+	uint row1;
+	float weight; // Of row1 (bilinear)
+} sampler_row_t;
+
+// Builds the column tables, in a buffer of buffers. Returns 0 on success
+// and -1 on error (errno set).
+int samplerCreate(filter_sampler_t *sampler, blend_filter_mode_t mode, uint width, uint height,
+		uint filterWidth, uint filterHeight, buffer_pool_t *buffers);
+
+// Filter rows of destination row y
+sampler_row_t samplerRow(const filter_sampler_t *sampler, uint y);
+
+// Scaled modes: the width components of destination row y of a filter
+// plane (stride components between rows), written to row
+void samplerFill(const filter_sampler_t *sampler, sampler_row_t rows, const data_t *plane, size_t stride, data_t *row);
+
+// Name of the mode, as accepted by samplerFromName
+const char *samplerName(blend_filter_mode_t mode);
+
+// Parses a name ("exact", "wrap", "nearest", "bilinear"). Returns 0 on success and -1 otherwise
+int samplerFromName(const char *name, blend_filter_mode_t *mode);
+
+void samplerDestroy(filter_sampler_t *sampler);
+
+#endif /* SAMPLER_H_ */
@@ -0,0 +1,56 @@
+/*
+ * worker_pool.h
+ *
+ *  Created on: Fall 2022
+ */
+
+#ifndef WORKER_POOL_H_
+#define WORKER_POOL_H_
+
+#include <pthread.h>
+#include <sys/types.h>
+
+// Work routine, same signature as the ones given to pthread_create
+typedef void *(*pool_routine_t)(void *);
+
+// Job waiting in the queue of the pool
+typedef struct {
+	pool_routine_t routine;
+	void *arg;
+} pool_job_t;
+
+// Long-lived set of threads. Workers are created once and sleep on
+// a condition variable between passes, so each pass only costs a
+// wake-up (poolSubmit) and a barrier (poolWait).
+typedef struct {
+	pthread_t *threads;
+	pid_t *tids; // Kernel id of every worker, in start order (perf counters)
+	uint nThreads;
+	uint nStarted; // Workers that have written their id
+	pool_job_t *jobs; // Circular queue of pending jobs
+	uint jobCapacity;
+	uint jobHead;
+	uint jobCount;
+	uint unfinished; // Jobs submitted but not finished yet
+	bool stop;
+	pthread_mutex_t lock;
+	pthread_cond_t jobReady; // Signaled when a job is queued (or on shutdown)
+	pthread_cond_t jobTaken; // Signaled when a slot of the queue gets free
+	pthread_cond_t allDone; // Signaled when unfinished reaches 0 (and when a worker starts)
+} worker_pool_t;
+
+// Starts nThreads workers and waits until they are running (their ids are
+// known). jobCapacity is the size of the queue. Returns 0 on success and
+// -1 on error.
+int poolCreate(worker_pool_t *pool, uint nThreads, uint jobCapacity);
+
+// Queues routine(arg). Blocks while the queue is full.
+void poolSubmit(worker_pool_t *pool, pool_routine_t routine, void *arg);
+
+// Waits until every submitted job has finished
+void poolWait(worker_pool_t *pool);
+
+// Waits for the queued jobs, stops the workers and frees the pool
+void poolDestroy(worker_pool_t *pool);
+
+#endif /* WORKER_POOL_H_ */